@@ -9,11 +9,16 @@
 #include <boost/signals2.hpp>
 #include <openFrameworksArduino/StdAfx.h>
 #include <openFrameworksArduino/ofArduino.h>
+#include <atomic>
 #include <vector>
 
+#include "callback_registry.hpp"
+
 /**
  * Manages the Firmata connection to an Arduino running the Stepper Controller program. Responses are conveyed through
- * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signals</a>.
+ * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signals</a>, and through lock-free
+ * @ref CallbackRegistry "CallbackRegistries" with the same parameters (e.g. @ref OnSetSpeed alongside @ref ESetSpeed),
+ * which are cheaper to invoke. Signals can be skipped with @ref setSignalsEnabled once nothing is connected to them.
  */
 class ArduinoStepperController : public ofArduino {
 public:
@@ -102,6 +107,13 @@ public:
      */
     [[nodiscard]] bool isSetup() const;
 
+    /**
+     * Sets whether responses fire the Boost signals in addition to the callback registries. Enabled by default.
+     *
+     * @param enabled `false` to skip the signals
+     */
+    void setSignalsEnabled(const bool enabled);
+
     // ==========================
     //           Events
     // ==========================
@@ -154,6 +166,26 @@ public:
      */
     boost::signals2::signal<void(uint8_t)> ESetGripper;
 
+    /**
+     * @name Callback Registries
+     * Lock-free equivalents of the response signals above, invoked with the same parameters.
+     */
+    //@{
+    CallbackRegistry<void(const std::vector<uint8_t>&)> OnArduinoEcho;
+
+    CallbackRegistry<void(uint8_t, int16_t)> OnSetSpeed;
+
+    CallbackRegistry<void(uint8_t, int16_t)> OnGetSpeed;
+
+    CallbackRegistry<void(uint8_t, uint16_t, int16_t)> OnSendStep;
+
+    CallbackRegistry<void(uint8_t, int32_t, int16_t)> OnSeekPosition;
+
+    CallbackRegistry<void(uint8_t, int32_t)> OnGetPosition;
+
+    CallbackRegistry<void(uint8_t)> OnSetGripper;
+    //@}
+
 protected:
     /**
      * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signal</a> triggered when
@@ -205,6 +237,11 @@ private:
      * Flag which indicates whether @ref setupArduino has completed configuring the Stepper Controller Arduino.
      */
     bool setup_completed;
+
+    /**
+     * Whether responses fire the Boost signals in addition to the callback registries, see @ref setSignalsEnabled.
+     */
+    std::atomic<bool> signals_enabled;
 };
 
 #endif //UMRT_ARM_FIRMWARE_LIB_ARDUINO_STEPPER_CONTROLLER_HPP
@@ -0,0 +1,134 @@
+/**
+ * @file
+ * Helpers for estimating how much of a CAN bus' capacity a set of frames uses.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_BUS_LOAD_HPP
+#define UMRT_ARM_FIRMWARE_LIB_BUS_LOAD_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/** Default bit rate of the MKS drivers' CAN interface, in bits/s. */
+constexpr uint32_t DEFAULT_CAN_BITRATE = 500000;
+
+/**
+ * Returns the worst-case number of bits a classic CAN data frame with a standard (11-bit) identifier occupies on the
+ * bus, including the interframe space.
+ *
+ * SOF, identifier, RTR, IDE, r0, DLC, data and CRC (34 + 8n bits) are subject to bit stuffing, which inserts at most
+ * one bit per four after the first; the CRC delimiter, ACK, EOF and interframe space (13 bits) are not.
+ *
+ * @param length number of data bytes, 0 to 8
+ */
+constexpr uint32_t standardFrameBits(const uint8_t length) {
+    const uint32_t stuffed = 34 + 8 * static_cast<uint32_t>(length);
+    return stuffed + (stuffed - 1) / 4 + 13;
+}
+
+/**
+ * Estimates bus utilisation from the frames passing through a controller, over a sliding window.
+ *
+ * Each frame is charged its worst-case size from @ref standardFrameBits, so the estimate errs on the side of a busier
+ * bus. The window is split into buckets which are recycled as time moves on; recording is a single compare-and-swap,
+ * so any number of threads may record frames concurrently, and readers never block them.
+ *
+ * The estimate covers only the frames recorded, so it is a lower bound whenever other nodes share the bus and their
+ * frames aren't seen, e.g. because they are filtered out by the kernel.
+ */
+class BusLoadEstimator {
+public:
+    /** Length of the sliding window used by default. */
+    static constexpr std::chrono::milliseconds DEFAULT_WINDOW{ 100 };
+
+    /**
+     * Creates an estimator with no frames recorded.
+     *
+     * @param bitrate bit rate of the CAN bus, in bits/s
+     * @param window length of the sliding window
+     */
+    explicit BusLoadEstimator(
+            const uint32_t bitrate = DEFAULT_CAN_BITRATE, const std::chrono::nanoseconds& window = DEFAULT_WINDOW
+    );
+
+    /**
+     * Charges a frame to the bucket covering `time`.
+     *
+     * @param length number of data bytes in the frame
+     * @param time when the frame was sent or received
+     */
+    void record(const uint8_t length, const std::chrono::steady_clock::time_point time) noexcept;
+
+    /**
+     * Returns the bits recorded per second over the window ending at `now`.
+     */
+    [[nodiscard]] double bitsPerSecond(
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()
+    ) const noexcept;
+
+    /**
+     * Returns the fraction of the bus' capacity used over the window ending at `now`, which may exceed 1 if the
+     * bitrate is misconfigured.
+     */
+    [[nodiscard]] double utilisation(
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()
+    ) const noexcept;
+
+    /**
+     * Returns the total number of frames recorded.
+     */
+    [[nodiscard]] uint64_t frames() const noexcept;
+
+    /**
+     * Returns the total number of bits recorded.
+     */
+    [[nodiscard]] uint64_t bits() const noexcept;
+
+    /**
+     * Returns the configured bit rate, in bits/s.
+     */
+    [[nodiscard]] uint32_t bitrate() const noexcept;
+
+    /**
+     * Returns the length of the sliding window.
+     */
+    [[nodiscard]] std::chrono::nanoseconds window() const noexcept;
+
+    /**
+     * Changes the bit rate used by @ref utilisation. Frames already recorded are kept.
+     *
+     * @param bitrate bit rate of the CAN bus, in bits/s
+     */
+    void setBitrate(const uint32_t bitrate) noexcept;
+
+private:
+    static constexpr size_t BUCKETS = 10;
+
+    // Each bucket packs the sequence number of the interval it covers (upper bits) with the bits charged to it (lower
+    // bits), so that recycling a stale bucket and charging it happen in one atomic operation
+    static constexpr unsigned BIT_COUNT_WIDTH = 40;
+    static constexpr uint64_t BIT_COUNT_MASK = (uint64_t{ 1 } << BIT_COUNT_WIDTH) - 1;
+    static constexpr uint64_t SEQUENCE_MASK = ~uint64_t{ 0 } >> BIT_COUNT_WIDTH;
+
+    /**
+     * Returns how many intervals `older` precedes `newer` by, allowing for the sequence numbers wrapping around;
+     * results past half the sequence space mean `older` is actually the newer of the two.
+     */
+    [[nodiscard]] static uint64_t age(const uint64_t newer, const uint64_t older) noexcept;
+
+    /**
+     * Returns the sequence number of the bucket interval covering `time`, truncated to fit alongside the bit count.
+     */
+    [[nodiscard]] uint64_t interval(const std::chrono::steady_clock::time_point time) const noexcept;
+
+    std::atomic<uint32_t> bitrate_;
+    const std::chrono::steady_clock::duration bucket_width;
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets;
+    std::atomic<uint64_t> total_frames;
+    std::atomic<uint64_t> total_bits;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_BUS_LOAD_HPP
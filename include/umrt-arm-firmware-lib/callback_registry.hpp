@@ -0,0 +1,89 @@
+/**
+ * @file
+ * Append-only callback list which can be invoked without locking, used as a low-overhead alternative to
+ * `boost::signals2` on the controllers' receive paths.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_CALLBACK_REGISTRY_HPP
+#define UMRT_ARM_FIRMWARE_LIB_CALLBACK_REGISTRY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+/** Number of callbacks a @ref CallbackRegistry holds by default. */
+constexpr size_t DEFAULT_CALLBACK_CAPACITY = 8;
+
+template <typename Signature, size_t Capacity = DEFAULT_CALLBACK_CAPACITY>
+class CallbackRegistry;
+
+/**
+ * Fixed-capacity list of callbacks, intended to be populated once at startup.
+ *
+ * Unlike `boost::signals2::signal`, callbacks can't be disconnected, which means invoking them needs neither a lock
+ * nor a copy of the slot list: it is a single atomic load followed by a direct call to each callback.
+ * Callbacks may be added while the registry is being invoked from another thread; they take effect from the next
+ * invocation.
+ *
+ * @tparam Args callback parameter types
+ * @tparam Capacity maximum number of callbacks
+ */
+template <typename... Args, size_t Capacity>
+class CallbackRegistry<void(Args...), Capacity> {
+public:
+    using Callback = std::function<void(Args...)>;
+
+    CallbackRegistry() = default;
+    CallbackRegistry(const CallbackRegistry&) = delete;
+    CallbackRegistry& operator=(const CallbackRegistry&) = delete;
+
+    /**
+     * Adds a callback, which stays registered for the lifetime of the registry.
+     *
+     * @param callback function to call on each invocation
+     * @return `false` if the registry is full or `callback` is empty
+     */
+    bool subscribe(Callback callback) {
+        if (!callback) { return false; }
+
+        // Only serialises subscribers against each other, invocation never takes this lock
+        std::lock_guard<std::mutex> lock(subscribe_mutex);
+        const size_t index = count.load(std::memory_order_relaxed);
+        if (index == Capacity) { return false; }
+        callbacks[index] = std::move(callback);
+        count.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Calls every registered callback, in the order they were subscribed.
+     */
+    void operator()(const Args&... args) const {
+        const size_t size = count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < size; ++i) { callbacks[i](args...); }
+    }
+
+    /**
+     * Returns the number of registered callbacks.
+     */
+    [[nodiscard]] size_t size() const noexcept { return count.load(std::memory_order_acquire); }
+
+    /**
+     * Returns whether no callbacks are registered.
+     */
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    /**
+     * Returns the maximum number of callbacks.
+     */
+    [[nodiscard]] static constexpr size_t capacity() noexcept { return Capacity; }
+
+private:
+    std::array<Callback, Capacity> callbacks{};
+    std::atomic<size_t> count{ 0 };
+    std::mutex subscribe_mutex;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_CALLBACK_REGISTRY_HPP
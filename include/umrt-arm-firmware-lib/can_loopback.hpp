@@ -0,0 +1,154 @@
+/**
+ * @file
+ * In-memory CAN bus with the same interface as @ref CanSocket, so that controllers and simulated drivers can talk to
+ * each other within one process without kernel sockets.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_CAN_LOOPBACK_HPP
+#define UMRT_ARM_FIRMWARE_LIB_CAN_LOOPBACK_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "can_socket.hpp"
+
+/**
+ * One endpoint on an in-memory CAN bus, a drop-in for @ref CanSocket as a controller transport.
+ *
+ * Endpoints created with the same bus name share a bus, which exists for as long as any of its endpoints do, much as
+ * sockets bound to the same vcan interface do. Every frame sent is delivered to each other endpoint whose filters
+ * accept it, but not back to the sender, stamped with the time it was sent. Sends never block: an endpoint whose
+ * receive queue is full drops the frame, as the kernel does when a socket's receive buffer overflows.
+ *
+ * Endpoints are local by default: the frames they send are marked @ref CanFrame::local on delivery, as frames from
+ * another socket on the same host are. Remote endpoints stand in for other nodes on the bus, e.g. simulated drivers,
+ * whose frames aren't.
+ *
+ * Every method may be called from any thread.
+ */
+class CanLoopback {
+public:
+    /** Maximum number of frames read or written by a single batch call, matching @ref CanSocket::MAX_BATCH. */
+    static constexpr size_t MAX_BATCH = CanSocket::MAX_BATCH;
+
+    /** Number of received frames an endpoint holds before dropping new ones. */
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+
+    /**
+     * Joins an in-memory bus, creating it if no other endpoint is on it. Accepts every frame until filters are set.
+     *
+     * @param bus name of the bus; unrelated to any network interface of the same name
+     * @param remote `true` if the endpoint stands in for another node on the bus, see @ref CanLoopback
+     */
+    explicit CanLoopback(const std::string& bus, const bool remote = false);
+
+    /**
+     * Leaves the bus. Frames still queued for this endpoint are discarded.
+     */
+    ~CanLoopback() noexcept;
+
+    CanLoopback(const CanLoopback&) = delete;
+    CanLoopback& operator=(const CanLoopback&) = delete;
+
+    /**
+     * Reads a single frame, see @ref CanSocket::receive.
+     */
+    bool receive(CanFrame& frame, const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()) noexcept;
+
+    /**
+     * Reads as many queued frames as fit into `frames`, only waiting for the first, see @ref CanSocket::receiveBatch.
+     */
+    size_t receiveBatch(
+            CanFrame* frames, const size_t max_frames,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    ) noexcept;
+
+    /**
+     * Delivers a frame to the other endpoints on the bus. Never blocks, so `timeout` is unused.
+     *
+     * @return always `true`, as a frame can't be refused; endpoints with full queues drop it, see @ref dropped
+     */
+    bool send(const CanFrame& frame, const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()) noexcept;
+
+    /**
+     * Delivers frames to the other endpoints on the bus, in order, see @ref send.
+     *
+     * @return `count`
+     */
+    size_t sendBatch(
+            const CanFrame* frames, const size_t count,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    ) noexcept;
+
+    /**
+     * Accepted for compatibility with @ref CanSocket; frames are always stamped when sent, which matches both modes.
+     *
+     * @return `true`
+     */
+    bool enableTimestamps(const CanTimestampMode mode) noexcept;
+
+    /**
+     * Only accepts standard data frames with one of the given identifiers, see @ref CanSocket::acceptStandardIds.
+     *
+     * @return `true`
+     */
+    bool acceptStandardIds(const std::vector<uint16_t>& ids) noexcept;
+
+    /**
+     * Removes any filters so that every frame on the bus is received.
+     *
+     * @return `true`
+     */
+    bool acceptAll() noexcept;
+
+    /**
+     * Returns 0, as no operation can fail. Kept for compatibility with @ref CanSocket::lastError.
+     */
+    [[nodiscard]] int lastError() const noexcept;
+
+    /**
+     * Returns the number of frames this endpoint dropped because its receive queue was full.
+     */
+    [[nodiscard]] uint64_t dropped() const noexcept;
+
+private:
+    struct Bus;
+
+    /**
+     * Returns the bus with the given name, creating it if it has no endpoints.
+     */
+    static std::shared_ptr<Bus> findBus(const std::string& name);
+
+    /**
+     * Queues a frame sent by another endpoint, if the filters accept it.
+     */
+    void deliver(const CanFrame& frame) noexcept;
+
+    std::shared_ptr<Bus> bus;
+    const bool remote;
+
+    /** Guards everything below. */
+    std::mutex mutex;
+    std::condition_variable readable;
+
+    /** Ring of received frames. */
+    std::unique_ptr<CanFrame[]> queue;
+    size_t queue_head;
+    size_t queue_size;
+
+    /** Standard identifiers accepted, unless @ref accept_all is set. */
+    std::array<bool, 0x800> accepted;
+    bool accept_all;
+
+    std::atomic<uint64_t> dropped_frames;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_CAN_LOOPBACK_HPP
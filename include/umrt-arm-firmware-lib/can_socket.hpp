@@ -0,0 +1,215 @@
+/**
+ * @file
+ * Thin wrapper around a raw SocketCAN socket which reports errors and empty reads through return values instead of
+ * exceptions, so that it can be polled in tight loops.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_CAN_SOCKET_HPP
+#define UMRT_ARM_FIRMWARE_LIB_CAN_SOCKET_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A classic (non-FD) CAN frame, decoupled from the kernel's `struct can_frame` so consumers don't need Linux headers.
+ */
+struct CanFrame {
+    /** Maximum payload length of a classic CAN frame. */
+    static constexpr uint8_t MAX_LENGTH = 8;
+
+    /** Frame identifier, with the extended/remote/error flag bits stripped. */
+    uint32_t id = 0;
+
+    /** Number of valid bytes in @ref data. */
+    uint8_t length = 0;
+
+    /** `true` if @ref id is a 29-bit extended identifier. */
+    bool extended = false;
+
+    /** `true` if this is a remote transmission request. */
+    bool remote = false;
+
+    /** `true` if this is an error frame generated by the CAN controller. */
+    bool error = false;
+
+    /**
+     * `true` if the frame was sent by a socket on this host and looped back by the kernel, rather than received from
+     * another node on the bus.
+     */
+    bool local = false;
+
+    /** Frame payload; only the first @ref length bytes are meaningful. */
+    std::array<uint8_t, MAX_LENGTH> data{};
+
+    /**
+     * When the frame was received, on the `std::chrono::steady_clock` (`CLOCK_MONOTONIC`) timeline.
+     * Taken by the kernel if enabled with @ref CanSocket::enableTimestamps, otherwise when the frame was read.
+     */
+    std::chrono::steady_clock::time_point timestamp{};
+};
+
+/**
+ * Source of the receive timestamps attached to each @ref CanFrame, see @ref CanSocket::enableTimestamps.
+ */
+enum class CanTimestampMode : uint8_t {
+    /** Timestamp frames when they are read by userspace. */
+    USERSPACE,
+
+    /** Timestamp frames when the kernel receives them from the driver. */
+    SOFTWARE,
+
+    /**
+     * Use the CAN controller's hardware timestamps if the driver provides them, falling back to @ref SOFTWARE
+     * otherwise. Hardware timestamps are assumed to be synchronised to `CLOCK_REALTIME` by the driver.
+     */
+    HARDWARE
+};
+
+/**
+ * Raw SocketCAN socket bound to a single network interface.
+ *
+ * Unlike `drivers::socketcan::SocketCanReceiver`, which throws `SocketCanTimeout` whenever no frame is waiting,
+ * all I/O methods here are `noexcept` and report "nothing to read" through their return value.
+ *
+ * Frames may be sent from several threads at once, and concurrently with a single reader.
+ */
+class CanSocket {
+public:
+    /** Maximum number of frames read or written by a single `recvmmsg` or `sendmmsg` call. */
+    static constexpr size_t MAX_BATCH = 64;
+
+    /**
+     * Opens a raw CAN socket and binds it to an interface.
+     *
+     * @param can_interface SocketCAN network interface corresponding to the CAN bus
+     * @throws std::runtime_error if the socket cannot be opened or bound
+     */
+    explicit CanSocket(const std::string& can_interface);
+
+    /**
+     * Closes the socket.
+     */
+    ~CanSocket() noexcept;
+
+    CanSocket(const CanSocket&) = delete;
+    CanSocket& operator=(const CanSocket&) = delete;
+
+    /**
+     * Reads a single frame from the socket.
+     *
+     * @param frame populated with the received frame if one was read
+     * @param timeout maximum time to wait for a frame to arrive; zero does not block
+     * @return `true` if a frame was read, `false` if the timeout expired or the read failed
+     */
+    bool receive(CanFrame& frame, const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()) noexcept;
+
+    /**
+     * Reads as many waiting frames as fit into `frames` using a single `recvmmsg` call per @ref MAX_BATCH frames.
+     * Only waits for the first frame; once frames are flowing, it stops as soon as the socket's queue is empty.
+     *
+     * @param frames array to populate with received frames, in arrival order
+     * @param max_frames capacity of `frames`
+     * @param timeout maximum time to wait for the first frame to arrive; zero does not block
+     * @return number of frames written to `frames`
+     */
+    size_t receiveBatch(
+            CanFrame* frames, const size_t max_frames,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    ) noexcept;
+
+    /**
+     * Writes a single frame to the socket.
+     *
+     * @param frame the frame to send; @ref CanFrame::local and @ref CanFrame::timestamp are ignored
+     * @param timeout maximum time to wait for room in the interface's transmit queue; zero does not block
+     * @return `true` if the kernel accepted the frame
+     */
+    bool send(const CanFrame& frame, const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()) noexcept;
+
+    /**
+     * Writes frames to the socket in order, using a single `sendmmsg` call per @ref MAX_BATCH frames.
+     * Stops at the first frame the kernel refuses, so that the frames which do go out keep their order.
+     *
+     * @param frames the frames to send
+     * @param count number of frames in `frames`
+     * @param timeout maximum time to wait, over the whole batch, for room in the interface's transmit queue; zero does
+     *                not block
+     * @return number of frames the kernel accepted; `frames[result]` onwards weren't sent
+     */
+    size_t sendBatch(
+            const CanFrame* frames, const size_t count,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    ) noexcept;
+
+    /**
+     * Selects how received frames are timestamped. Kernel timestamps exclude the time a frame spent waiting in the
+     * socket's queue, so they reflect when the frame actually arrived on the bus. May be called while another thread
+     * is receiving; frames read around the switch may be timestamped under either mode.
+     *
+     * @param mode the timestamp source
+     * @return `true` if the kernel accepted the setting; if not, the previous mode remains in effect
+     */
+    bool enableTimestamps(const CanTimestampMode mode) noexcept;
+
+    /**
+     * Installs kernel-level receive filters so that only standard data frames with one of the given identifiers reach
+     * this socket. Everything else is dropped before waking the reader.
+     *
+     * If there are more identifiers than the kernel accepts (`CAN_RAW_FILTER_MAX`), fails with `EINVAL` and leaves
+     * the previous filters in place; callers can fall back to @ref acceptAll.
+     *
+     * @param ids the 11-bit identifiers to accept; an empty list blocks all frames
+     * @return `true` if the filters were installed, `false` if not, see @ref lastError
+     */
+    bool acceptStandardIds(const std::vector<uint16_t>& ids) noexcept;
+
+    /**
+     * Removes any receive filters so that every frame on the bus reaches this socket.
+     *
+     * @return `true` if the filters were removed
+     */
+    bool acceptAll() noexcept;
+
+    /**
+     * Returns the `errno` of the most recent failed operation, or 0 if none has failed.
+     * Timeouts are not considered failures.
+     */
+    [[nodiscard]] int lastError() const noexcept;
+
+    /**
+     * Returns the underlying file descriptor, e.g. for use with `poll`.
+     */
+    [[nodiscard]] int fileDescriptor() const noexcept;
+
+private:
+    /**
+     * Blocks until the socket is readable or the timeout expires.
+     *
+     * @return `true` if the socket is readable
+     */
+    bool waitReadable(const std::chrono::nanoseconds& timeout) noexcept;
+
+    /**
+     * Decides whether a refused send is worth retrying, waiting for the transmit queue to drain if so.
+     *
+     * @param error `errno` of the refused send
+     * @param deadline when to give up
+     * @return `true` to retry, `false` if the error is permanent or the deadline has passed
+     */
+    bool waitWritable(const int error, const std::chrono::steady_clock::time_point deadline) noexcept;
+
+    int fd;
+
+    /** Atomic as it is written by sends from any thread as well as by the reader. */
+    std::atomic<int> last_error;
+
+    /** Atomic as @ref enableTimestamps may be called while another thread is receiving. */
+    std::atomic<CanTimestampMode> timestamp_mode;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_CAN_SOCKET_HPP
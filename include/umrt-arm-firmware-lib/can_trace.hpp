@@ -0,0 +1,149 @@
+/**
+ * @file
+ * Reading recorded CAN traces, and a transport which plays them back to a controller as if they were live traffic.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_CAN_TRACE_HPP
+#define UMRT_ARM_FIRMWARE_LIB_CAN_TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "can_socket.hpp"
+
+/**
+ * Reads every classic CAN frame from a trace, detecting its format from the contents:
+ * - candump logs, as written by `candump -l`, one `(seconds) interface id#data` line per frame.
+ * - pcapng captures with the `LINKTYPE_CAN_SOCKETCAN` link type, as written by Wireshark, `tcpdump` or
+ *   @ref FlightRecorder::dumpPcapng.
+ *
+ * Timestamps are moved onto the `std::chrono::steady_clock` timeline relative to its epoch, so the first frame is at
+ * `time_point{}` and the rest keep their original spacing. Frames sent by the recording host, i.e. outbound pcapng
+ * packets and candump frames marked `T`, are flagged @ref CanFrame::local. CAN FD frames, and lines or blocks which
+ * can't be parsed, are skipped.
+ *
+ * The whole trace is read into memory, so that replaying it doesn't wait on the disk.
+ *
+ * @param path path to the trace
+ * @return the frames, in the order recorded
+ * @throws std::runtime_error if the file can't be read or isn't in a recognised format
+ */
+std::vector<CanFrame> readCanTrace(const std::string& path);
+
+/**
+ * Plays a recorded trace back as a controller transport, a drop-in for @ref CanSocket.
+ *
+ * The trace's frames are received at their original spacing, starting from when the replay is constructed, and are
+ * stamped with the time they become due. Filters apply as they do to a socket. Frames sent are accepted and discarded,
+ * so that a controller can run against the recording unchanged. Once the trace is exhausted the bus reads as idle.
+ *
+ * Every method may be called from any thread.
+ */
+class CanReplay {
+public:
+    /** Maximum number of frames read or written by a single batch call, matching @ref CanSocket::MAX_BATCH. */
+    static constexpr size_t MAX_BATCH = CanSocket::MAX_BATCH;
+
+    /**
+     * Reads a trace with @ref readCanTrace, and starts playing it.
+     *
+     * @param trace_path path to a candump log or pcapng capture
+     * @throws std::runtime_error if the trace can't be read
+     */
+    explicit CanReplay(const std::string& trace_path);
+
+    CanReplay(const CanReplay&) = delete;
+    CanReplay& operator=(const CanReplay&) = delete;
+
+    /**
+     * Reads the next frame accepted by the filters, once it is due, see @ref CanSocket::receive.
+     */
+    bool receive(CanFrame& frame, const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()) noexcept;
+
+    /**
+     * Reads as many due frames as fit into `frames`, only waiting for the first, see @ref CanSocket::receiveBatch.
+     */
+    size_t receiveBatch(
+            CanFrame* frames, const size_t max_frames,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    ) noexcept;
+
+    /**
+     * Discards a frame.
+     *
+     * @return `true`
+     */
+    bool send(const CanFrame& frame, const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()) noexcept;
+
+    /**
+     * Discards frames.
+     *
+     * @return `count`
+     */
+    size_t sendBatch(
+            const CanFrame* frames, const size_t count,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    ) noexcept;
+
+    /**
+     * Accepted for compatibility with @ref CanSocket; frames are stamped with when they become due in either mode.
+     *
+     * @return `true`
+     */
+    bool enableTimestamps(const CanTimestampMode mode) noexcept;
+
+    /**
+     * Only accepts standard data frames with one of the given identifiers, see @ref CanSocket::acceptStandardIds.
+     *
+     * @return `true`
+     */
+    bool acceptStandardIds(const std::vector<uint16_t>& ids) noexcept;
+
+    /**
+     * Removes any filters so that every frame in the trace is received.
+     *
+     * @return `true`
+     */
+    bool acceptAll() noexcept;
+
+    /**
+     * Returns 0, as no operation can fail. Kept for compatibility with @ref CanSocket::lastError.
+     */
+    [[nodiscard]] int lastError() const noexcept;
+
+    /**
+     * Returns whether every frame of the trace has been played.
+     */
+    [[nodiscard]] bool finished() const noexcept;
+
+    /**
+     * Returns the number of frames discarded by @ref send and @ref sendBatch.
+     */
+    [[nodiscard]] uint64_t sent() const noexcept;
+
+private:
+    /**
+     * Returns whether the filters accept `frame`. Must be called with @ref mutex held.
+     */
+    [[nodiscard]] bool accepts(const CanFrame& frame) const noexcept;
+
+    const std::vector<CanFrame> frames;
+    const std::chrono::steady_clock::time_point start;
+
+    /** Guards everything below. */
+    std::mutex mutex;
+    size_t next_frame;
+    std::array<bool, 0x800> accepted;
+    bool accept_all;
+
+    std::atomic<bool> exhausted;
+    std::atomic<uint64_t> sent_frames;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_CAN_TRACE_HPP
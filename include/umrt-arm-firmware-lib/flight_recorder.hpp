@@ -0,0 +1,167 @@
+/**
+ * @file
+ * Fixed-size binary ring of recently sent and received CAN frames, which can be written out as a pcapng capture for
+ * post-mortem analysis in Wireshark.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_FLIGHT_RECORDER_HPP
+#define UMRT_ARM_FIRMWARE_LIB_FLIGHT_RECORDER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lock_free.hpp"
+
+struct CanFrame;
+
+/**
+ * Whether a recorded frame was sent or received by us.
+ */
+enum class FrameDirection : uint8_t { RECEIVED, TRANSMITTED };
+
+/**
+ * A single frame held by a @ref FlightRecorder.
+ */
+struct FlightRecord {
+    /** When the frame was sent or received, on the `std::chrono::steady_clock` timeline. */
+    std::chrono::steady_clock::time_point timestamp{};
+
+    /** Frame identifier, with the extended/remote/error flag bits stripped. */
+    uint32_t id = 0;
+
+    /** Whether the frame was sent or received. */
+    FrameDirection direction = FrameDirection::RECEIVED;
+
+    /** `true` if @ref id is a 29-bit extended identifier. */
+    bool extended = false;
+
+    /** `true` if this is a remote transmission request. */
+    bool remote = false;
+
+    /** `true` if this is an error frame generated by the CAN controller. */
+    bool error = false;
+
+    /** Number of valid bytes in @ref data. */
+    uint8_t length = 0;
+
+    /** Frame payload; only the first @ref length bytes are meaningful. */
+    std::array<uint8_t, 8> data{};
+};
+
+/**
+ * Records the most recent CAN frames sent and received by a controller, overwriting the oldest once full.
+ *
+ * Recording is lock-free and allocation-free, and costs roughly one atomic increment and four stores per frame, so it
+ * can be left on in the field. Any number of threads may record concurrently, and @ref snapshot / @ref dumpPcapng may
+ * be called at any time from any thread; frames being overwritten while a snapshot is taken are skipped rather than
+ * returned torn.
+ *
+ * Recording is disabled by default, see @ref enable.
+ */
+class FlightRecorder {
+public:
+    /** Number of frames kept by default. */
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    /**
+     * Creates a disabled recorder.
+     *
+     * @param capacity number of frames to keep, rounded up to a power of two
+     */
+    explicit FlightRecorder(const size_t capacity = DEFAULT_CAPACITY);
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    /**
+     * Starts recording frames.
+     */
+    void enable() noexcept;
+
+    /**
+     * Stops recording frames. Frames already recorded are kept.
+     */
+    void disable() noexcept;
+
+    /**
+     * Returns whether frames are currently being recorded.
+     */
+    [[nodiscard]] bool isEnabled() const noexcept;
+
+    /**
+     * Records a frame, if recording is enabled.
+     *
+     * @param direction whether the frame was sent or received
+     * @param frame the frame, including its timestamp
+     */
+    void record(const FrameDirection direction, const CanFrame& frame) noexcept;
+
+    /**
+     * Records a standard or extended data frame, if recording is enabled.
+     *
+     * @param direction whether the frame was sent or received
+     * @param id the frame identifier
+     * @param extended `true` if `id` is a 29-bit extended identifier
+     * @param data the frame payload
+     * @param length number of bytes in `data`, truncated to 8
+     * @param timestamp when the frame was sent or received
+     */
+    void record(
+            const FrameDirection direction, const uint32_t id, const bool extended, const uint8_t* data,
+            const size_t length, const std::chrono::steady_clock::time_point timestamp
+    ) noexcept;
+
+    /**
+     * Copies out the recorded frames, oldest first.
+     *
+     * @param records replaced with the recorded frames
+     */
+    void snapshot(std::vector<FlightRecord>& records) const;
+
+    /**
+     * Writes the recorded frames to a pcapng file with the `LINKTYPE_CAN_SOCKETCAN` link type, which Wireshark decodes
+     * natively. Each packet is marked inbound or outbound according to its @ref FrameDirection.
+     *
+     * @param path file to create or overwrite
+     * @return `true` if the file was written
+     */
+    bool dumpPcapng(const std::string& path) const;
+
+    /**
+     * Returns the maximum number of frames kept.
+     */
+    [[nodiscard]] size_t capacity() const noexcept;
+
+    /**
+     * Returns the total number of frames recorded, including those since overwritten.
+     */
+    [[nodiscard]] uint64_t recorded() const noexcept;
+
+private:
+    /**
+     * One recorded frame. The sequence number is odd while being written, and otherwise encodes which write produced
+     * the slot's contents, so that readers can detect both in-progress and overwritten slots.
+     */
+    struct alignas(32) Slot {
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<uint64_t> timestamp{ 0 };
+        std::atomic<uint64_t> header{ 0 };
+        std::atomic<uint64_t> data{ 0 };
+    };
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    std::atomic<bool> enabled;
+
+    /** Number of writes started, the next write's ticket. */
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> next_ticket;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_FLIGHT_RECORDER_HPP
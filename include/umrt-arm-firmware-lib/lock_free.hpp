@@ -0,0 +1,281 @@
+/**
+ * @file
+ * Lock-free primitives used to hand data between the controllers' internal threads and application threads without
+ * taking a mutex on the hot path.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_LOCK_FREE_HPP
+#define UMRT_ARM_FIRMWARE_LIB_LOCK_FREE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Assumed size of a cache line, used to keep data written by different threads from sharing a line.
+ * std::hardware_destructive_interference_size isn't used since GCC warns that its value may change between versions.
+ */
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Bounded single-producer/single-consumer ring buffer.
+ *
+ * Exactly one thread may call @ref push and exactly one (possibly different) thread may call @ref pop. Neither
+ * operation blocks or allocates; @ref push fails when the ring is full rather than overwriting unread items.
+ *
+ * @tparam T trivially copyable item type
+ * @tparam Capacity maximum number of items held, must be a power of two
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRing items must be trivially copyable");
+
+public:
+    /**
+     * Appends an item to the ring. Must only be called from the producer thread.
+     *
+     * @param item the item to append
+     * @return `true` if appended, `false` if the ring was full
+     */
+    bool push(const T& item) noexcept {
+        const size_t head = this->head.load(std::memory_order_relaxed);
+        if (head - cached_tail == Capacity) {
+            // Only touch the consumer's cache line when the ring looks full
+            cached_tail = this->tail.load(std::memory_order_acquire);
+            if (head - cached_tail == Capacity) { return false; }
+        }
+        buffer[head & MASK] = item;
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the oldest item from the ring. Must only be called from the consumer thread.
+     *
+     * @param item populated with the removed item
+     * @return `true` if an item was removed, `false` if the ring was empty
+     */
+    bool pop(T& item) noexcept {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail == cached_head) {
+            // Only touch the producer's cache line when the ring looks empty
+            cached_head = this->head.load(std::memory_order_acquire);
+            if (tail == cached_head) { return false; }
+        }
+        item = buffer[tail & MASK];
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Returns the number of items in the ring. Only a snapshot if called while the other thread is active.
+     */
+    [[nodiscard]] size_t size() const noexcept {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the maximum number of items the ring can hold.
+     */
+    [[nodiscard]] static constexpr size_t capacity() noexcept { return Capacity; }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    // Producer-owned
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{ 0 };
+    size_t cached_tail = 0;
+
+    // Consumer-owned
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{ 0 };
+    size_t cached_head = 0;
+
+    alignas(CACHE_LINE_SIZE) std::array<T, Capacity> buffer{};
+};
+
+/**
+ * Bounded multi-producer/single-consumer ring buffer.
+ *
+ * Any number of threads may call @ref push and @ref pushAll concurrently, and exactly one thread may call @ref pop.
+ * Each slot carries a sequence number which tells producers when it is free and the consumer when it has been
+ * filled, so producers only contend on a single compare-and-swap of the head index. Neither operation blocks or
+ * allocates; pushes fail when the ring is full rather than overwriting unread items.
+ *
+ * @tparam T trivially copyable item type
+ * @tparam Capacity maximum number of items held, must be a power of two
+ */
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "MpscRing capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "MpscRing items must be trivially copyable");
+
+public:
+    MpscRing() noexcept {
+        for (size_t i = 0; i < Capacity; ++i) { cells[i].sequence.store(i, std::memory_order_relaxed); }
+    }
+
+    /**
+     * Appends an item to the ring. Safe to call from any thread.
+     *
+     * @param item the item to append
+     * @return `true` if appended, `false` if the ring was full
+     */
+    bool push(const T& item) noexcept { return pushAll(&item, 1); }
+
+    /**
+     * Appends several items to the ring as one contiguous run, so that no other producer's items are interleaved
+     * with them. Either every item is appended or none are. Safe to call from any thread.
+     *
+     * @param items the items to append, in order
+     * @param count number of items in `items`
+     * @return `true` if appended, `false` if the ring didn't have room for all of them
+     */
+    bool pushAll(const T* items, const size_t count) noexcept {
+        if (count == 0) { return true; }
+        if (count > Capacity) { return false; }
+
+        size_t head = this->head.load(std::memory_order_relaxed);
+        for (;;) {
+            // The consumer frees slots in order, so if the last slot of the run is free, so is every slot before it
+            const size_t sequence = cells[(head + count - 1) & MASK].sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - (head + count - 1));
+            if (lag == 0) {
+                if (this->head.compare_exchange_weak(head, head + count, std::memory_order_relaxed)) { break; }
+            } else if (lag < 0) {
+                return false;
+            } else {
+                head = this->head.load(std::memory_order_relaxed);
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            Cell& cell = cells[(head + i) & MASK];
+            cell.item = items[i];
+            cell.sequence.store(head + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    /**
+     * Removes the oldest item from the ring. Must only be called from the consumer thread.
+     *
+     * If a producer has claimed the oldest slot but not filled it yet, the ring reads as empty until it has.
+     *
+     * @param item populated with the removed item
+     * @return `true` if an item was removed, `false` if the ring was empty
+     */
+    bool pop(T& item) noexcept {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        Cell& cell = cells[tail & MASK];
+        if (cell.sequence.load(std::memory_order_acquire) != tail + 1) { return false; }
+        item = cell.item;
+        cell.sequence.store(tail + Capacity, std::memory_order_release);
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Returns whether the next @ref pop would fail. Must only be called from the consumer thread.
+     */
+    [[nodiscard]] bool empty() const noexcept {
+        const size_t tail = this->tail.load(std::memory_order_relaxed);
+        return cells[tail & MASK].sequence.load(std::memory_order_acquire) != tail + 1;
+    }
+
+    /**
+     * Returns the number of items in the ring, including any still being written. Only a snapshot.
+     */
+    [[nodiscard]] size_t size() const noexcept {
+        // Tail first, since it never passes the head, so the difference can't underflow
+        const size_t tail = this->tail.load(std::memory_order_acquire);
+        return head.load(std::memory_order_acquire) - tail;
+    }
+
+    /**
+     * Returns the maximum number of items the ring can hold.
+     */
+    [[nodiscard]] static constexpr size_t capacity() noexcept { return Capacity; }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    // Shared by producers
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{ 0 };
+
+    // Consumer-owned
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{ 0 };
+
+    alignas(CACHE_LINE_SIZE) std::array<Cell, Capacity> cells;
+};
+
+/**
+ * Single-writer value which any number of threads can read consistently without locking.
+ *
+ * Readers retry if they overlap with a write, so a reader never observes a torn value and never blocks the writer.
+ * The value is held in atomic words, so concurrent reads and writes are well-defined.
+ * Occupies its own cache line(s) so that neighbouring seqlocks written by other threads don't cause false sharing.
+ *
+ * @tparam T trivially copyable value type
+ */
+template <typename T>
+class alignas(CACHE_LINE_SIZE) Seqlock {
+    static_assert(std::is_trivially_copyable_v<T>, "Seqlock values must be trivially copyable");
+
+public:
+    Seqlock() noexcept { store(T{}); }
+
+    /**
+     * Replaces the value. Must only be called from one thread at a time.
+     *
+     * @param value the new value
+     */
+    void store(const T& value) noexcept {
+        uint64_t buffer[WORDS]{};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        const uint32_t seq = sequence.load(std::memory_order_relaxed);
+        // Odd sequence numbers mark a write in progress
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i) { words[i].store(buffer[i], std::memory_order_relaxed); }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * Reads a consistent snapshot of the value. Safe to call from any thread.
+     *
+     * @return the most recently stored value
+     */
+    [[nodiscard]] T load() const noexcept {
+        uint64_t buffer[WORDS];
+        uint32_t before;
+        uint32_t after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; ++i) { buffer[i] = words[i].load(std::memory_order_relaxed); }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> sequence{ 0 };
+    std::atomic<uint64_t> words[WORDS];
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_LOCK_FREE_HPP
@@ -0,0 +1,174 @@
+/**
+ * @file
+ * Allocation-free encoding of the commands sent to MKS SERVO57D/42D/35D/28D stepper motor drivers.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_MKS_ENCODER_HPP
+#define UMRT_ARM_FIRMWARE_LIB_MKS_ENCODER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "MKS_COMMANDS.hpp"
+
+/**
+ * An encoded MKS command, checksum included, in a buffer the size of a classic CAN frame.
+ */
+struct MksPayload {
+    /** Number of bytes of @ref data in use. */
+    uint8_t length = 0;
+
+    /** Command byte, arguments and checksum. */
+    std::array<uint8_t, 8> data{};
+};
+
+/**
+ * Encodes commands addressed to a single CAN ID, either a driver or a group, straight into fixed-size buffers.
+ *
+ * Everything which only depends on the CAN ID is computed once on construction: the checksum seed, and the complete
+ * frames of commands without arguments such as @ref MksCommands::CURRENT_POS. Every method is `constexpr`, so frames
+ * for a known ID can be built at compile time, and none allocate.
+ */
+class MksEncoder {
+public:
+    /**
+     * Creates an encoder for frames addressed to `can_id`.
+     *
+     * @param can_id CAN ID the frames are addressed to; the checksum covers it, so group frames need the group ID
+     */
+    constexpr explicit MksEncoder(const uint16_t can_id = 0) noexcept
+        : can_id{ can_id }, seed{ static_cast<uint8_t>(can_id) }, position_query{ query(MksCommands::CURRENT_POS) },
+          status_query{ query(MksCommands::QUERY_STATUS) }, io_status_query{ query(MksCommands::IO_STATUS) } {}
+
+    /**
+     * Returns the CAN ID the frames are addressed to.
+     */
+    [[nodiscard]] constexpr uint16_t canId() const noexcept { return can_id; }
+
+    /**
+     * Returns the prebuilt @ref MksCommands::CURRENT_POS frame.
+     */
+    [[nodiscard]] constexpr const MksPayload& getPosition() const noexcept { return position_query; }
+
+    /**
+     * Returns the prebuilt @ref MksCommands::QUERY_STATUS frame.
+     */
+    [[nodiscard]] constexpr const MksPayload& getStatus() const noexcept { return status_query; }
+
+    /**
+     * Returns the prebuilt @ref MksCommands::IO_STATUS frame.
+     */
+    [[nodiscard]] constexpr const MksPayload& getIoStatus() const noexcept { return io_status_query; }
+
+    /**
+     * Encodes a @ref MksCommands::SET_SPEED command.
+     *
+     * @param normalised_speed 12-bit speed value to write to the driver
+     * @param dir direction to spin, `true` if speed is positive
+     * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL
+     */
+    [[nodiscard]] constexpr MksPayload setSpeed(
+            const int16_t normalised_speed, const bool dir, const uint8_t acceleration
+    ) const noexcept {
+        MksPayload payload{ 4, { MksCommands::SET_SPEED } };
+        packSpeedProperties(payload, normalised_speed, dir, acceleration);
+        return withChecksum(payload);
+    }
+
+    /**
+     * Encodes a @ref MksCommands::SEND_STEP command.
+     *
+     * @param normalised_steps 24-bit number of steps to write to the driver
+     * @param normalised_speed 12-bit speed value to write to the driver
+     * @param dir direction to spin, `true` if speed is positive
+     * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL
+     */
+    [[nodiscard]] constexpr MksPayload sendStep(
+            const uint32_t normalised_steps, const int16_t normalised_speed, const bool dir, const uint8_t acceleration
+    ) const noexcept {
+        MksPayload payload{ 7, { MksCommands::SEND_STEP } };
+        packSpeedProperties(payload, normalised_speed, dir, acceleration);
+        pack24(payload, 4, normalised_steps);
+        return withChecksum(payload);
+    }
+
+    /**
+     * Encodes a @ref MksCommands::SEEK_POS_BY_STEPS command.
+     *
+     * @param normalised_position 24-bit target position to write to the driver
+     * @param normalised_speed speed value to write to the driver; the sign is ignored
+     * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL
+     */
+    [[nodiscard]] constexpr MksPayload seekPosition(
+            const int32_t normalised_position, const int16_t normalised_speed, const uint8_t acceleration
+    ) const noexcept {
+        MksPayload payload{ 7, { MksCommands::SEEK_POS_BY_STEPS } };
+        payload.data[1] = static_cast<uint8_t>(normalised_speed >> 8 & 0xFF);
+        payload.data[2] = static_cast<uint8_t>(normalised_speed & 0xFF);
+        payload.data[3] = acceleration;
+        pack24(payload, 4, static_cast<uint32_t>(normalised_position));
+        return withChecksum(payload);
+    }
+
+    /**
+     * Encodes a @ref MksCommands::SET_GROUP_ID command.
+     *
+     * @param group group ID to assign to the driver
+     */
+    [[nodiscard]] constexpr MksPayload setGroupId(const uint16_t group) const noexcept {
+        MksPayload payload{ 3, { MksCommands::SET_GROUP_ID } };
+        payload.data[1] = static_cast<uint8_t>(group >> 8 & 0xFF);
+        payload.data[2] = static_cast<uint8_t>(group & 0xFF);
+        return withChecksum(payload);
+    }
+
+    /**
+     * Encodes a command without arguments, such as @ref MksCommands::CURRENT_POS.
+     *
+     * @param command the command byte
+     */
+    [[nodiscard]] constexpr MksPayload query(const MksCommands command) const noexcept {
+        return withChecksum(MksPayload{ 1, { command } });
+    }
+
+private:
+    /**
+     * Writes the speed properties structure shared by @ref MksCommands::SET_SPEED and @ref MksCommands::SEND_STEP
+     * into bytes 1 to 3.
+     */
+    static constexpr void packSpeedProperties(
+            MksPayload& payload, const int16_t normalised_speed, const bool dir, const uint8_t acceleration
+    ) noexcept {
+        payload.data[1] = static_cast<uint8_t>((normalised_speed & 0xF00) >> 8 | (dir ? 1u << 7 : 0u));
+        payload.data[2] = static_cast<uint8_t>(normalised_speed & 0xFF);
+        payload.data[3] = acceleration;
+    }
+
+    /**
+     * Writes the lower 24 bits of `value` big-endian, starting at `offset`.
+     */
+    static constexpr void pack24(MksPayload& payload, const size_t offset, const uint32_t value) noexcept {
+        payload.data[offset] = static_cast<uint8_t>(value >> 16 & 0xFF);
+        payload.data[offset + 1] = static_cast<uint8_t>(value >> 8 & 0xFF);
+        payload.data[offset + 2] = static_cast<uint8_t>(value & 0xFF);
+    }
+
+    /**
+     * Appends the checksum, the 8-bit sum of the CAN ID and every byte, see @ref MksCommands.
+     */
+    [[nodiscard]] constexpr MksPayload withChecksum(MksPayload payload) const noexcept {
+        uint8_t sum = seed;
+        for (size_t i = 0; i < payload.length; ++i) { sum = static_cast<uint8_t>(sum + payload.data[i]); }
+        payload.data[payload.length++] = sum;
+        return payload;
+    }
+
+    uint16_t can_id;
+    uint8_t seed;
+    MksPayload position_query;
+    MksPayload status_query;
+    MksPayload io_status_query;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_MKS_ENCODER_HPP
@@ -11,6 +11,7 @@
 #ifndef UMRT_ARM_FIRMWARE_LIB_MKS_ENUMS_HPP
 #define UMRT_ARM_FIRMWARE_LIB_MKS_ENUMS_HPP
 
+#include <stdexcept>
 #include <string>
 
 #include "MKS_COMMANDS.hpp"
@@ -46,4 +47,47 @@ inline std::string to_string_mks_move_response(const MksMoveResponse status) {
     throw std::logic_error("MksMoveResponse passed with invalid value: " + std::to_string(static_cast<uint8_t>(status)));
 }
 
+/** Status code for the response to @ref QUERY_STATUS.
+ * Scoped, since several of its values would otherwise clash with @ref MksMoveResponse.
+ */
+enum class MksMotorStatus : uint8_t {
+    /** The driver couldn't determine its status. */
+    QUERY_FAILED = 0,
+
+    /** The motor is stopped. */
+    STOPPED = 1,
+
+    /** The motor is accelerating. */
+    ACCELERATING = 2,
+
+    /** The motor is slowing down. */
+    DECELERATING = 3,
+
+    /** The motor is moving at its target speed. */
+    FULL_SPEED = 4,
+
+    /** The motor is homing. */
+    HOMING = 5,
+
+    /** The motor is calibrating. */
+    CALIBRATING = 6
+};
+
+/**
+* Converts an @ref MksMotorStatus to its string representation.
+* @param status response status to lookup
+*/
+inline std::string to_string_mks_motor_status(const MksMotorStatus status) {
+    switch (status) {
+        case MksMotorStatus::QUERY_FAILED: return "QUERY_FAILED";
+        case MksMotorStatus::STOPPED: return "STOPPED";
+        case MksMotorStatus::ACCELERATING: return "ACCELERATING";
+        case MksMotorStatus::DECELERATING: return "DECELERATING";
+        case MksMotorStatus::FULL_SPEED: return "FULL_SPEED";
+        case MksMotorStatus::HOMING: return "HOMING";
+        case MksMotorStatus::CALIBRATING: return "CALIBRATING";
+    }
+    throw std::logic_error("MksMotorStatus passed with invalid value: " + std::to_string(static_cast<uint8_t>(status)));
+}
+
 #endif //UMRT_ARM_FIRMWARE_LIB_MKS_ENUMS_HPP
@@ -0,0 +1,65 @@
+/**
+ * @file
+ * Model of the MKS drivers' speed ramp, used to predict how long a move takes and to choose speeds and accelerations
+ * for moves which should take a given time.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_MKS_RAMP_HPP
+#define UMRT_ARM_FIRMWARE_LIB_MKS_RAMP_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/** Driver steps per second moved per unit of speed, see @ref MksCommands::SET_SPEED. */
+constexpr double MKS_STEPS_PER_SPEED_UNIT = 160.0 / 3.0;
+
+/** Largest speed the drivers accept, the speed field being 12 bits wide. */
+constexpr uint16_t MKS_MAX_SPEED = 0xFFF;
+
+/**
+ * Returns how long the driver takes to change its speed by one unit with a given acceleration byte.
+ * The driver steps its speed once every (256 - acceleration) × 50 µs; an acceleration of 0 changes speed instantly.
+ *
+ * @param acceleration the acceleration byte sent to the driver
+ */
+constexpr std::chrono::microseconds mksTickPeriod(const uint8_t acceleration) {
+    return std::chrono::microseconds(acceleration == 0 ? 0 : (256 - acceleration) * 50);
+}
+
+/**
+ * A speed and acceleration pair, in the units sent to the driver.
+ */
+struct MksRamp {
+    /** Speed, in units of @ref MKS_STEPS_PER_SPEED_UNIT steps/s. */
+    uint16_t speed = 0;
+
+    /** Acceleration byte, see @ref mksTickPeriod. */
+    uint8_t acceleration = 0;
+};
+
+/**
+ * Predicts how long a move takes from standstill to standstill: a linear ramp up to `ramp.speed`, a cruise, and a
+ * symmetric ramp down. Moves too short to reach the speed ramp straight up and back down.
+ *
+ * @param distance length of the move, in driver steps
+ * @param ramp speed and acceleration of the move
+ * @return duration in seconds, or infinity if the speed is 0 and the distance isn't
+ */
+double mksMoveDuration(const uint32_t distance, const MksRamp& ramp);
+
+/**
+ * Chooses the speed and acceleration whose move over `distance` is predicted to take closest to `duration`.
+ * Among equally good candidates, the acceleration closest to `preferred_acceleration` is chosen, so that axes planned
+ * together keep similar ramp profiles.
+ *
+ * @param distance length of the move, in driver steps
+ * @param duration desired move duration, in seconds
+ * @param preferred_acceleration acceleration byte to stay close to; if 0, every candidate changes speed instantly
+ * @param max_speed fastest speed to consider
+ */
+MksRamp mksMatchDuration(
+        const uint32_t distance, const double duration, const uint8_t preferred_acceleration,
+        const uint16_t max_speed = MKS_MAX_SPEED
+);
+
+#endif //UMRT_ARM_FIRMWARE_LIB_MKS_RAMP_HPP
@@ -0,0 +1,333 @@
+/**
+ * @file
+ * Software model of MKS SERVO57D/42D/35D/28D drivers, for exercising and load-testing the controllers without
+ * hardware, either in-process or on a virtual CAN interface.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_MKS_SIMULATOR_HPP
+#define UMRT_ARM_FIRMWARE_LIB_MKS_SIMULATOR_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "can_socket.hpp"
+#include "mks_enums.hpp"
+#include "motor_index.hpp"
+
+/**
+ * Behaviour of the drivers modelled by @ref MksSimulator.
+ */
+struct MksSimulatorOptions {
+    /**
+     * Number of position moves a driver holds behind the one it is executing; further moves are answered with
+     * @ref MksMoveResponse::FAILED. The manual doesn't document the real drivers' limit.
+     */
+    size_t queue_depth = 16;
+
+    /** Time between a command, or the end of a move, and the driver's reply appearing on the bus. */
+    std::chrono::microseconds response_delay{ 0 };
+};
+
+/**
+ * Snapshot of a simulated driver, see @ref MksSimulator::motor.
+ */
+struct MksSimulatedMotor {
+    /** CAN ID of the driver. */
+    uint16_t id = 0;
+
+    /** Group ID set with @ref MksCommands::SET_GROUP_ID, 0 if none. */
+    uint16_t group = 0;
+
+    /** Position, in driver steps, rounded to the nearest step. */
+    int32_t position = 0;
+
+    /** Velocity, in driver steps/s; positive is CW. */
+    double velocity = 0;
+
+    /** What @ref MksCommands::QUERY_STATUS would report. */
+    MksMotorStatus status = MksMotorStatus::STOPPED;
+
+    /** Number of position moves waiting behind the current one. */
+    size_t queued = 0;
+};
+
+/**
+ * Counts of the frames handled by a @ref MksSimulator.
+ */
+struct MksSimulatorStats {
+    /** Frames addressed to a simulated driver, or to one of their groups. */
+    uint64_t received = 0;
+
+    /** Replies produced. */
+    uint64_t replied = 0;
+
+    /** Frames ignored because their checksum didn't match. */
+    uint64_t checksum_errors = 0;
+
+    /** Frames ignored because the command isn't simulated, or its length is wrong for the command. */
+    uint64_t unsupported = 0;
+
+    /** Commands answered with a failure status. */
+    uint64_t rejected = 0;
+};
+
+/**
+ * Simulates a bus of MKS drivers: decodes the commands addressed to them, moves virtual motors, and produces the
+ * replies the drivers would send, framed and checksummed as described in @ref MksCommands.
+ *
+ * Handles @ref MksCommands::SET_SPEED, @ref MksCommands::SEND_STEP, @ref MksCommands::SEEK_POS_BY_STEPS,
+ * @ref MksCommands::CURRENT_POS, @ref MksCommands::QUERY_STATUS, @ref MksCommands::IO_STATUS,
+ * @ref MksCommands::SET_GROUP_ID and @ref MksCommands::EMERGENCY_STOP, in the active response mode. Frames with a bad
+ * checksum, and other commands, are ignored as if lost.
+ *
+ * # Motion
+ * Motion follows the ramp model of @ref mksMoveDuration: the speed changes linearly, by one unit every
+ * @ref mksTickPeriod, so a move finishes exactly when that function predicts.
+ *
+ * Position moves are queued and run one after another, each from standstill, as the drivers do. Accepting a move is
+ * answered with @ref MksMoveResponse::MOVING, and finishing it with @ref MksMoveResponse::COMPLETED. The stop
+ * variants (zero speed and steps) aren't queued: they discard the queue and ramp the motor down with their own
+ * acceleration, and are answered like a move which completes once the motor stands still. Moves arriving while the
+ * motor spins under @ref MksCommands::SET_SPEED wait until it has been stopped, and a @ref MksCommands::SET_SPEED
+ * arriving while position moves are running or queued is refused.
+ *
+ * Commands sent to a group ID, or to the broadcast ID 0, apply to every driver in it and aren't answered.
+ *
+ * # Time
+ * The simulator doesn't keep time itself: every call takes the current time, which must never decrease, and brings
+ * the motors up to it first. Replies are collected and handed out by @ref takeReplies, stamped with the time they
+ * would appear on the bus, and @ref nextEvent says when the next one is due, so the simulator can be driven by a
+ * real clock, e.g. by @ref serve on a vcan interface, or stepped by a virtual one for deterministic tests.
+ *
+ * Not thread-safe: every method must be called from the same thread, or under the same lock.
+ */
+class MksSimulator {
+public:
+    /**
+     * Creates a simulated driver for each CAN ID, each at position 0 and stopped.
+     *
+     * @param motor_ids CAN IDs of the simulated drivers
+     * @param options behaviour of the drivers
+     * @param now time the simulation starts at
+     */
+    explicit MksSimulator(
+            const std::unordered_set<uint16_t>& motor_ids, const MksSimulatorOptions& options = {},
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()
+    );
+
+    /**
+     * Handles a frame sent on the bus. Frames which aren't addressed to a simulated driver or one of their groups
+     * are ignored, as are extended, remote and error frames.
+     *
+     * @param frame the frame
+     * @param now when the frame was sent
+     */
+    void receive(const CanFrame& frame, const std::chrono::steady_clock::time_point now);
+
+    /**
+     * Moves the motors up to `now`, finishing and starting moves, and releases the replies due by then.
+     *
+     * @param now current time
+     */
+    void advance(const std::chrono::steady_clock::time_point now);
+
+    /**
+     * Moves every reply released so far into `replies`, oldest first, replacing its contents.
+     *
+     * @param replies populated with the replies; its capacity is reused, so passing the same vector to every call
+     *        avoids allocating
+     */
+    void takeReplies(std::vector<CanFrame>& replies);
+
+    /**
+     * Returns when @ref advance next has something to do, i.e. when the next move ends or the next reply is due, or
+     * `time_point::max()` if nothing is pending.
+     */
+    [[nodiscard]] std::chrono::steady_clock::time_point nextEvent() const noexcept;
+
+    /**
+     * Returns a snapshot of a simulated driver as of `now`, without advancing the simulation.
+     *
+     * @param motor CAN ID of the driver
+     * @param now time to report the motor's position at; must not precede the last call to @ref advance
+     * @throws std::out_of_range if `motor` isn't simulated
+     */
+    [[nodiscard]] MksSimulatedMotor motor(const uint16_t motor, const std::chrono::steady_clock::time_point now) const;
+
+    /**
+     * Returns the counts of frames handled so far.
+     */
+    [[nodiscard]] MksSimulatorStats getStats() const noexcept;
+
+    /**
+     * Runs the simulation on a CAN bus until `running` is cleared: reads commands from `socket`, and sends the
+     * replies on it when they are due. Replies due together are sent with a single @ref CanSocket::sendBatch.
+     *
+     * Frames for other IDs are ignored, so the socket may accept every ID. The kernel doesn't loop a socket's own
+     * frames back to it, and nor does @ref CanLoopback, so the replies, which share the drivers' IDs, aren't read back
+     * as commands.
+     *
+     * @tparam Transport @ref CanSocket, or @ref CanLoopback to serve controllers in the same process
+     * @param socket socket on the bus, e.g. on vcan0, or a remote @ref CanLoopback endpoint
+     * @param running cleared by another thread, or a signal handler, to return
+     */
+    template <typename Transport>
+    void serve(Transport& socket, const std::atomic<bool>& running);
+
+private:
+    /** Longest @ref serve sleeps without checking `running`. */
+    static constexpr std::chrono::milliseconds SERVE_INTERVAL{ 10 };
+
+    /**
+     * What a motor is doing.
+     */
+    enum class Mode : uint8_t {
+        IDLE,
+        /** Running at, or ramping to, a speed set by @ref MksCommands::SET_SPEED. */
+        SPEED,
+        /** Running a position move. */
+        MOVE,
+        /** Ramping down after a stop variant of a move command. */
+        STOP
+    };
+
+    /**
+     * A stretch of motion with constant acceleration. Times are in seconds since the simulation started.
+     */
+    struct Phase {
+        double start = 0;
+        double duration = 0;
+        double position = 0;
+        double velocity = 0;
+        double acceleration = 0;
+    };
+
+    /**
+     * A position move waiting for the motor to become free.
+     */
+    struct QueuedMove {
+        uint8_t command;
+        /** Relative moves: signed distance, in steps. Absolute moves: target position. */
+        int32_t steps;
+        uint16_t speed;
+        uint8_t acceleration;
+        /** `false` if sent to a group, whose commands aren't answered. */
+        bool answer;
+    };
+
+    struct Motor {
+        uint16_t id = 0;
+        uint16_t group = 0;
+        Mode mode = Mode::IDLE;
+
+        /** Motion profile of the current mode, in order; the last phase lasts forever in @ref Mode::SPEED. */
+        std::array<Phase, 3> phases{};
+        size_t phase_count = 0;
+
+        /** Where the motor rests when idle. */
+        double position = 0;
+
+        /** When the current move or ramp ends, infinity if it doesn't. */
+        double end = 0;
+
+        /** Command byte to answer with once the current move or stop completes. */
+        uint8_t command = 0;
+
+        std::deque<QueuedMove> queue;
+    };
+
+    /**
+     * Returns whether the frame's last byte is the checksum of its CAN ID and preceding bytes.
+     */
+    [[nodiscard]] static bool validChecksum(const CanFrame& frame) noexcept;
+
+    /**
+     * Applies a command to one motor, replying unless `answer` is cleared.
+     */
+    void execute(Motor& motor, const CanFrame& frame, const bool answer);
+
+    /**
+     * Accepts or refuses a move command, starting it if the motor is free.
+     */
+    void enqueueMove(Motor& motor, const QueuedMove& move);
+
+    /**
+     * Handles the stop variant of a move command: discards the queue and ramps the motor down.
+     */
+    void stop(Motor& motor, const uint8_t command, const uint8_t acceleration, const bool answer);
+
+    /**
+     * Starts the next queued move at `start`, if the motor is idle; otherwise leaves the queue alone.
+     */
+    void startNextMove(Motor& motor, const double start);
+
+    /**
+     * Replaces the motor's motion with a ramp from its current velocity to `velocity`.
+     *
+     * @param velocity target velocity, in steps/s
+     * @param acceleration acceleration byte of the command, see @ref mksTickPeriod
+     */
+    void rampTo(Motor& motor, const double velocity, const uint8_t acceleration);
+
+    /**
+     * Finishes the motor's move or ramp at its end time, answers it if needed, and starts the next queued move.
+     */
+    void finish(Motor& motor);
+
+    /**
+     * Returns the phase of the motor's motion in progress at `time`. The motor must be moving.
+     */
+    [[nodiscard]] static const Phase& currentPhase(const Motor& motor, const double time) noexcept;
+
+    /**
+     * Position and velocity of the motor at `time`.
+     */
+    [[nodiscard]] static std::pair<double, double> kinematics(const Motor& motor, const double time) noexcept;
+
+    /**
+     * What @ref MksCommands::QUERY_STATUS reports for the motor at `time`.
+     */
+    [[nodiscard]] static MksMotorStatus status(const Motor& motor, const double time) noexcept;
+
+    /**
+     * Queues a reply from `motor` carrying `arguments` after the command byte, due `response_delay` after `time`.
+     */
+    void reply(
+            const Motor& motor, const uint8_t command, const std::initializer_list<uint8_t> arguments,
+            const double time
+    );
+
+    /**
+     * Moves the replies due by `time` from @ref pending to @ref released.
+     */
+    void release(const std::chrono::steady_clock::time_point time);
+
+    [[nodiscard]] double seconds(const std::chrono::steady_clock::time_point time) const noexcept;
+    [[nodiscard]] std::chrono::steady_clock::time_point timePoint(const double seconds) const noexcept;
+
+    const MksSimulatorOptions options;
+    const std::chrono::steady_clock::time_point epoch;
+    MotorIndex motor_index;
+    std::vector<Motor> motors;
+
+    /** Simulation time of the last call, in seconds since @ref epoch. */
+    double now = 0;
+
+    /** Replies not yet due, in due order. */
+    std::deque<CanFrame> pending;
+
+    /** Replies due, waiting for @ref takeReplies. */
+    std::vector<CanFrame> released;
+
+    MksSimulatorStats stats;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_MKS_SIMULATOR_HPP
@@ -5,20 +5,517 @@
 #ifndef UMRT_ARM_FIRMWARE_LIB_MKS_STEPPER_CONTROLLER_HPP
 #define UMRT_ARM_FIRMWARE_LIB_MKS_STEPPER_CONTROLLER_HPP
 
+#include <atomic>
 #include <boost/signals2.hpp>
+#include <array>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "bus_load.hpp"
+#include "callback_registry.hpp"
+#include "flight_recorder.hpp"
+#include "lock_free.hpp"
+#include "mks_encoder.hpp"
 #include "mks_enums.hpp"
+#include "mks_ramp.hpp"
+#include "motor_index.hpp"
+#include "realtime.hpp"
 
-// Forward declaring these classes so that ros2_socketcan can be a private dependency
-namespace drivers::socketcan {
-    class SocketCanReceiver;
-    class SocketCanSender;
-    class CanId;
-} // namespace drivers::socketcan
+class CanLoopback;
+class CanReplay;
+class CanSocket;
+struct CanFrame;
+enum class CanTimestampMode : uint8_t;
+
+/**
+ * A decoded response from an MKS driver, as queued by @ref MksStepperController's receive thread.
+ */
+struct MksEvent {
+    /** The command being responded to, which determines which fields are meaningful. */
+    enum class Type : uint8_t {
+        /** Response to @ref BasicMksStepperController::setSpeed, see @ref succeeded. */
+        SET_SPEED,
+
+        /** Response to @ref BasicMksStepperController::sendStep, see @ref status. */
+        SEND_STEP,
+
+        /** Response to @ref BasicMksStepperController::seekPosition, see @ref status. */
+        SEEK_POSITION,
+
+        /** Response to @ref BasicMksStepperController::getPosition, see @ref position. */
+        GET_POSITION,
+
+        /** Response to @ref BasicMksStepperController::getStatus, see @ref motor_status. */
+        GET_STATUS,
+
+        /** Response to @ref BasicMksStepperController::getIoStatus, see @ref io_flags. */
+        GET_IO_STATUS,
+
+        /** Response to @ref BasicMksStepperController::setGroupId, see @ref succeeded. */
+        SET_GROUP_ID
+    };
+
+    Type type = Type::SET_SPEED;
+
+    /** CAN ID of the responding motor. */
+    uint16_t motor = 0;
+
+    /** Whether a @ref Type::SET_SPEED or @ref Type::SET_GROUP_ID command was accepted. */
+    bool succeeded = false;
+
+    /** Movement status reported in response to @ref Type::SEND_STEP and @ref Type::SEEK_POSITION. */
+    MksMoveResponse status = MksMoveResponse::FAILED;
+
+    /** Motor position in steps, after removing interpolated normalisation, for @ref Type::GET_POSITION. */
+    int32_t position = 0;
+
+    /** Motor state reported in response to @ref Type::GET_STATUS. */
+    MksMotorStatus motor_status = MksMotorStatus::QUERY_FAILED;
+
+    /** IO port flags reported in response to @ref Type::GET_IO_STATUS, see @ref MksCommands::IO_STATUS. */
+    uint8_t io_flags = 0;
+
+    /** When the response was received, on the `std::chrono::steady_clock` timeline, see @ref timestamps. */
+    std::chrono::steady_clock::time_point timestamp{};
+};
+
+/**
+ * Which response completes a move request, see @ref BasicMksStepperController::requestSendStep.
+ */
+enum class MksCompletion : uint8_t {
+    /** Complete on the driver's first response, i.e. once it has accepted (or rejected) the move. */
+    ACKNOWLEDGED,
+
+    /** Complete once the move has finished, i.e. on the first response other than @ref MksMoveResponse::MOVING. */
+    FINISHED
+};
+
+/**
+ * One member's answer to @ref BasicMksStepperController::confirmGroup.
+ */
+struct MksGroupConfirmation {
+    /** CAN ID of the group member. */
+    uint16_t motor = 0;
+
+    /** The member's @ref MksEvent::Type::GET_STATUS response, or `std::nullopt` if it didn't answer in time. */
+    std::optional<MksEvent> status;
+};
+
+/**
+ * One axis of a coordinated move, see @ref BasicMksStepperController::planCoordinatedSeek.
+ */
+struct MksAxisMove {
+    /** CAN ID of the motor to move. */
+    uint16_t motor = 0;
+
+    /** Target position, in steps as for @ref BasicMksStepperController::seekPosition. */
+    int32_t position = 0;
+
+    /** Last known position of the motor, e.g. from @ref BasicMksStepperController::getMotorState, in the same units. */
+    int32_t current_position = 0;
+};
+
+/**
+ * The speed and acceleration chosen for one axis of a coordinated move, see
+ * @ref BasicMksStepperController::planCoordinatedSeek. Speed and acceleration are in the units sent to the driver, after
+ * interpolated normalisation, so that they are transmitted exactly as planned.
+ */
+struct MksAxisPlan {
+    /** CAN ID of the motor to move. */
+    uint16_t motor = 0;
+
+    /** Target position, in steps as for @ref BasicMksStepperController::seekPosition. */
+    int32_t position = 0;
+
+    /** Speed sent to the driver, see @ref MksRamp::speed. */
+    uint16_t speed = 0;
+
+    /** Acceleration byte sent to the driver, see @ref mksTickPeriod. */
+    uint8_t acceleration = 0;
+
+    /** Predicted duration of this axis' move. */
+    std::chrono::nanoseconds duration{ 0 };
+};
+
+/**
+ * The most recent responses received from a single MKS driver, see @ref BasicMksStepperController::getMotorState.
+ * Timestamps are on the `std::chrono::steady_clock` timeline, and are default-constructed (i.e. the clock's epoch) if
+ * no such response has been received yet.
+ */
+struct MksMotorState {
+    /** Last reported position in steps, after removing interpolated normalisation. */
+    int32_t position = 0;
+
+    /** Last movement status reported in response to a SEND_STEP or SEEK_POS_BY_STEPS command. */
+    MksMoveResponse move_status = MksMoveResponse::FAILED;
+
+    /** Whether the last SET_SPEED command was accepted. */
+    bool speed_ack = false;
+
+    /** Last motor state reported in response to a QUERY_STATUS command. */
+    MksMotorStatus motor_status = MksMotorStatus::QUERY_FAILED;
+
+    /** Last IO port flags reported in response to an IO_STATUS command. */
+    uint8_t io_flags = 0;
+
+    /** When @ref position was received. */
+    std::chrono::steady_clock::time_point position_time{};
+
+    /** When @ref move_status was received. */
+    std::chrono::steady_clock::time_point move_status_time{};
+
+    /** When @ref speed_ack was received. */
+    std::chrono::steady_clock::time_point speed_ack_time{};
+
+    /** When @ref motor_status was received. */
+    std::chrono::steady_clock::time_point motor_status_time{};
+
+    /** When @ref io_flags was received. */
+    std::chrono::steady_clock::time_point io_flags_time{};
+};
+
+/**
+ * A query issued periodically by @ref BasicMksStepperController::startPolling.
+ */
+enum class MksPollQuery : uint8_t {
+    /** @ref MksCommands::CURRENT_POS, see @ref BasicMksStepperController::getPosition. */
+    POSITION,
+
+    /** @ref MksCommands::QUERY_STATUS, see @ref BasicMksStepperController::getStatus. */
+    STATUS,
+
+    /** @ref MksCommands::IO_STATUS, see @ref BasicMksStepperController::getIoStatus. */
+    IO_STATUS
+};
+
+/**
+ * Configuration for @ref BasicMksStepperController::startPolling. Rates are per motor, in Hz; 0 disables that query.
+ */
+struct MksPollSchedule {
+    /** Rate of @ref MksPollQuery::POSITION queries. */
+    double position_rate = 0;
+
+    /** Rate of @ref MksPollQuery::STATUS queries. */
+    double status_rate = 0;
+
+    /** Rate of @ref MksPollQuery::IO_STATUS queries. */
+    double io_rate = 0;
+
+    /** Fraction of the bus' capacity which the queries and their responses may use, in (0, 1]. */
+    double max_bus_load = 0.25;
+
+    /** Bit rate of the CAN bus, in bits/s. */
+    uint32_t bitrate = DEFAULT_CAN_BITRATE;
+};
+
+/**
+ * Rates achieved by @ref BasicMksStepperController::startPolling for one query, see
+ * @ref BasicMksStepperController::getPollStats. Rates are per motor, in Hz, averaged since polling started.
+ */
+struct MksPollStats {
+    /** Rate given in the @ref MksPollSchedule. */
+    double requested_rate = 0;
+
+    /** Rate actually scheduled, after scaling down to fit within @ref MksPollSchedule::max_bus_load. */
+    double scheduled_rate = 0;
+
+    /** Rate at which queries were transmitted. */
+    double achieved_rate = 0;
+
+    /** Rate at which responses of this type were received. */
+    double response_rate = 0;
+
+    /** Number of queries transmitted. */
+    uint64_t issued = 0;
+
+    /** Number of queries skipped because the scheduler fell more than a period behind. */
+    uint64_t skipped = 0;
+
+    /** Number of queries which couldn't be transmitted. */
+    uint64_t failed = 0;
+};
+
+/**
+ * Configuration for @ref BasicMksStepperController::startStreaming.
+ */
+struct MksStreamConfig {
+    /** Rate at which setpoints are sent, in Hz. */
+    double rate = 500;
+
+    /**
+     * How long a setpoint given without an explicit deadline stays valid, see @ref BasicMksStepperController::streamSpeed.
+     */
+    std::chrono::nanoseconds max_age{ std::chrono::milliseconds(20) };
+};
+
+/**
+ * Statistics for the streaming thread, see @ref BasicMksStepperController::getStreamStats. Counts are since streaming last
+ * started.
+ */
+struct MksStreamStats {
+    /** Ticks processed. */
+    uint64_t ticks = 0;
+
+    /** Ticks which were never processed because the thread woke up more than a period late. */
+    uint64_t missed_ticks = 0;
+
+    /**
+     * Setpoints transmitted, or queued behind a full in-flight window; those later dropped from the queue are also
+     * counted in @ref replaced or @ref expired.
+     */
+    uint64_t sent = 0;
+
+    /**
+     * New setpoints which weren't transmitted because they matched the last one sent to the motor, with no stop or
+     * dropped frame in between.
+     */
+    uint64_t unchanged = 0;
+
+    /** Setpoints which weren't transmitted because their deadline had already passed when they were picked up. */
+    uint64_t stale = 0;
+
+    /** Setpoints dropped from the queue behind a full in-flight window because a newer one was sent to the motor. */
+    uint64_t replaced = 0;
+
+    /** Setpoints dropped from the queue behind a full in-flight window because their deadline passed there. */
+    uint64_t expired = 0;
+
+    /** Setpoints which couldn't be transmitted. */
+    uint64_t failed = 0;
+
+    /** Mean delay between when a tick was due and when the thread woke up for it. */
+    std::chrono::nanoseconds mean_jitter{ 0 };
+
+    /** Longest delay between when a tick was due and when the thread woke up for it. */
+    std::chrono::nanoseconds max_jitter{ 0 };
+};
+
+/**
+ * Statistics for a single motor's in-flight window, see @ref BasicMksStepperController::getPipelineStats.
+ */
+struct MksPipelineStats {
+    /** Commands sent which haven't been answered yet. */
+    size_t in_flight = 0;
+
+    /** Commands currently waiting for room in the window. */
+    size_t queued = 0;
+
+    /** Largest value @ref queued has reached. */
+    size_t max_queued = 0;
+
+    /** Commands transmitted through the window. */
+    uint64_t sent = 0;
+
+    /** Commands which had to wait for room in the window before being transmitted. */
+    uint64_t deferred = 0;
+
+    /** Commands which were never answered, and were dropped from the window after the response timeout. */
+    uint64_t timeouts = 0;
+
+    /** Total time @ref deferred commands spent waiting; divide by @ref deferred for the mean. */
+    std::chrono::nanoseconds total_wait{ 0 };
+
+    /** Longest time a deferred command spent waiting. */
+    std::chrono::nanoseconds max_wait{ 0 };
+};
+
+/**
+ * What @ref MksStepperController does with low-priority commands while the bus is busy, see
+ * @ref BasicMksStepperController::setAdmissionControl.
+ */
+enum class MksAdmissionPolicy : uint8_t {
+    /** Transmit every command regardless of bus load. */
+    DISABLED,
+
+    /** Fail low-priority commands immediately, so the caller sees the backpressure. */
+    REFUSE,
+
+    /** Hold low-priority commands until the bus load falls back below the threshold. */
+    DEFER
+};
+
+/**
+ * Bus load and admission control counters, see @ref BasicMksStepperController::getAdmissionStats.
+ */
+struct MksAdmissionStats {
+    /** Estimated fraction of the bus' capacity currently in use. */
+    double bus_load = 0;
+
+    /** Low-priority commands failed because the bus was busy. */
+    uint64_t refused = 0;
+
+    /** Low-priority commands held back because the bus was busy. */
+    uint64_t deferred = 0;
+
+    /** Deferred commands which are still waiting to be transmitted. */
+    size_t waiting = 0;
+};
+
+/**
+ * A single command in a @ref MksBatch, in the same units as the equivalent @ref MksStepperController method.
+ */
+struct MksBatchCommand {
+    /** The ID of the motor to control. */
+    uint16_t motor = 0;
+
+    /**
+     * The command, named after the response it produces: @ref MksEvent::Type::SET_SPEED,
+     * @ref MksEvent::Type::SEND_STEP, @ref MksEvent::Type::SEEK_POSITION, @ref MksEvent::Type::GET_POSITION,
+     * @ref MksEvent::Type::GET_STATUS or @ref MksEvent::Type::GET_IO_STATUS.
+     */
+    MksEvent::Type type = MksEvent::Type::SET_SPEED;
+
+    /** Signed speed, in RPM; unused by queries. */
+    int16_t speed = 0;
+
+    /** Acceleration byte; unused by queries. */
+    uint8_t acceleration = 0;
+
+    /** Number of steps for @ref MksEvent::Type::SEND_STEP, or target position for @ref MksEvent::Type::SEEK_POSITION. */
+    int32_t value = 0;
+};
+
+/**
+ * Commands for any number of motors, collected to be sent together by @ref BasicMksStepperController::sendBatch.
+ */
+class MksBatch {
+public:
+    /**
+     * Adds a command equivalent to @ref BasicMksStepperController::setSpeed.
+     */
+    void setSpeed(const uint16_t motor, const int16_t speed, const uint8_t acceleration = 0);
+
+    /**
+     * Adds a command equivalent to @ref BasicMksStepperController::sendStep.
+     */
+    void sendStep(const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration = 0);
+
+    /**
+     * Adds a command equivalent to @ref BasicMksStepperController::seekPosition.
+     */
+    void seekPosition(const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration = 0);
+
+    /**
+     * Adds a command equivalent to @ref BasicMksStepperController::getPosition.
+     */
+    void getPosition(const uint16_t motor);
+
+    /**
+     * Adds a command equivalent to @ref BasicMksStepperController::getStatus.
+     */
+    void getStatus(const uint16_t motor);
+
+    /**
+     * Adds a command equivalent to @ref BasicMksStepperController::getIoStatus.
+     */
+    void getIoStatus(const uint16_t motor);
+
+    /**
+     * Returns the commands added so far, in the order they will be sent.
+     */
+    [[nodiscard]] const std::vector<MksBatchCommand>& commands() const;
+
+    /**
+     * Removes every command, keeping the allocated room so the batch can be refilled without allocating.
+     */
+    void clear();
+
+private:
+    std::vector<MksBatchCommand> entries;
+};
+
+/**
+ * Outcome of @ref BasicMksStepperController::sendBatch.
+ */
+struct MksBatchResult {
+    /** Commands handed to the transmit thread. */
+    size_t sent = 0;
+
+    /** Commands held back by the in-flight window or admission control, which will be sent later. */
+    size_t queued = 0;
+
+    /** Indices into @ref MksBatch::commands of the commands which were refused or couldn't be sent, in order. */
+    std::vector<size_t> failed;
+};
+
+/**
+ * Threads which @ref MksStepperController may create, see @ref BasicMksStepperController::getRealtimeStatus.
+ */
+enum class MksThread : uint8_t {
+    /** Started by @ref BasicMksStepperController::startReceiveThread. */
+    RECEIVE,
+
+    /** Started by @ref BasicMksStepperController::startPolling. */
+    POLL,
+
+    /** Started by @ref BasicMksStepperController::startStreaming. */
+    STREAM,
+
+    /** Started on construction, and writes every frame to the bus. */
+    TRANSMIT
+};
+
+/** Number of values of @ref MksThread. */
+constexpr size_t MKS_THREAD_COUNT = 4;
+
+/**
+ * Transmit queue counters, see @ref BasicMksStepperController::getTransmitStats. Counts are since construction.
+ */
+struct MksTransmitStats {
+    /** Frames waiting for the transmit thread, in either lane. */
+    size_t queued = 0;
+
+    /** Frames handed to the kernel. */
+    uint64_t sent = 0;
+
+    /** Of @ref sent, stop frames sent through the priority lane. */
+    uint64_t priority_sent = 0;
+
+    /** Frames refused on submission because their lane was full. */
+    uint64_t rejected = 0;
+
+    /** Frames dropped because the kernel didn't accept them within @ref BasicMksStepperController::TRANSMIT_TIMEOUT. */
+    uint64_t failed = 0;
+
+    /** Motion commands dropped because a stop for the same motor was issued after them. */
+    uint64_t superseded = 0;
+
+    /**
+     * Stops resent because @ref BasicMksStepperController::emergencyStopAll was issued while motion commands from
+     * before it were being handed to the kernel, see @ref estop.
+     */
+    uint64_t restopped = 0;
+
+    /** Longest time an ordinary frame spent queued before the kernel accepted it. */
+    std::chrono::nanoseconds max_latency{ 0 };
+
+    /** Longest time a stop frame spent queued before the kernel accepted it. */
+    std::chrono::nanoseconds max_priority_latency{ 0 };
+};
+
+/**
+ * Outcome of @ref BasicMksStepperController::emergencyStopAll.
+ */
+struct MksEmergencyStopResult {
+    /** Number of motors a stop was sent to. */
+    size_t motors = 0;
+
+    /** Number of stop frames the kernel accepted; if less than @ref motors, the rest weren't sent. */
+    size_t sent = 0;
+
+    /** Time from the call until the kernel had accepted every frame, or until the timeout gave out. */
+    std::chrono::nanoseconds elapsed{ 0 };
+};
 
 /**
  * Abstracts CAN bus communication to MKS SERVO57D/42D/35D/28D stepper motor driver modules. Responses are conveyed through
@@ -33,26 +530,211 @@ namespace drivers::socketcan {
  * factor of 16 is used, and the motor is requested to move at 2 RPM, the motor will actually move at 6400 steps/min.
  *
  * An interpolation factor of 1 can be used to disable interpolation.
+ *
+ * # Receive Thread {#rxthread}
+ * By default the application polls the bus with @ref update or @ref drain, and signals fire on the polling thread, so a
+ * slow slot delays reading the bus. Alternatively, @ref startReceiveThread spawns a thread owned by the controller which
+ * reads and decodes responses, queueing them as @ref MksEvent "MksEvents" in a bounded lock-free ring. The application
+ * then consumes them on its own thread with @ref popEvent, or with @ref pollEvents to fire the usual signals.
+ *
+ * # Cached Motor State {#motorstate}
+ * Independently of how responses are consumed, the receive path records the latest position, movement status and
+ * set-speed acknowledgement for every motor, see @ref getMotorState. Each motor's record is guarded by a seqlock, so
+ * any number of threads can read snapshots at high rates without blocking the receive path or each other.
+ *
+ * # Receive Timestamps {#timestamps}
+ * Every decoded response carries the time it was received on the monotonic `std::chrono::steady_clock` timeline, so
+ * consumers can tell how stale a reading is. By default this is when the frame was read from the socket, which
+ * includes any time it spent queued; @ref enableReceiveTimestamps switches to kernel or hardware timestamps taken when
+ * the frame arrived. Timestamps are available through @ref MksEvent::timestamp, @ref MksMotorState, and from within
+ * signal handlers through @ref eventTimestamp.
+ *
+ * # Callbacks {#callbacks}
+ * Each response type can be consumed through a `boost::signals2` signal (e.g. @ref ESetSpeed) or through a
+ * @ref CallbackRegistry (e.g. @ref OnSetSpeed) with the same parameters. Signals lock a mutex and walk a
+ * disconnectable slot list on every response, whereas registries are fixed once subscribed and are invoked without
+ * locking, so they are preferred on control loops running at high rates. Both fire for every response; signals can be
+ * skipped entirely with @ref setSignalsEnabled once nothing is connected to them.
+ *
+ * # Requests {#requests}
+ * The command methods (@ref setSpeed, @ref sendStep, etc.) only send, leaving the caller to match up responses.
+ * The `request` variants (@ref requestSetSpeed, @ref requestSendStep, @ref requestSeekPosition, @ref requestPosition)
+ * instead return a future which completes with the matching response from that motor to that command, or with
+ * `std::nullopt` if none arrives before the timeout. The `AndWait` variants block until then.
+ *
+ * The drivers answer commands in the order they are received, so responses are matched to the oldest outstanding
+ * request of the same type for the same motor. Responses must be processed concurrently for requests to complete,
+ * either by the receive thread or by another thread calling @ref update or @ref drain; expired requests are completed
+ * whenever responses are processed.
+ *
+ * # In-Flight Window {#pipelining}
+ * The drivers process commands in the order they arrive, but only buffer a few at a time. @ref setInFlightWindow
+ * limits how many commands may be outstanding (sent but not yet answered) per motor; further commands are queued by
+ * the controller and transmitted as responses free up room, so callers can issue commands back to back without
+ * overrunning the drivers or serialising by hand. Commands which are never answered are dropped from the window after
+ * a timeout so that a lost response can't stall a motor. Queue depths and wait times are available through
+ * @ref getPipelineStats. The window is disabled by default, and every command is transmitted immediately.
+ *
+ * # Status Polling {#polling}
+ * @ref startPolling spawns a thread which queries every motor's position, status and/or IO ports at fixed rates, on
+ * absolute deadlines of the monotonic clock so the rates don't drift. Queries are staggered evenly across each period
+ * rather than sent in bursts. The bus time used by the queries and their responses is budgeted with worst-case frame
+ * sizes; if the requested rates don't fit within @ref MksPollSchedule::max_bus_load, every rate is scaled down by the
+ * same factor. If the thread falls behind, late queries are skipped rather than sent back to back. Responses are
+ * delivered like any other, e.g. through @ref getMotorState, and achieved rates are reported by @ref getPollStats.
+ *
+ * # Velocity Streaming {#streaming}
+ * For jogging and teleoperation, @ref startStreaming spawns a thread which sends speed setpoints at a fixed rate,
+ * driven by a `timerfd` on absolute deadlines of the monotonic clock. Any thread may post setpoints with
+ * @ref streamSpeed; each motor has a single-entry lock-free mailbox, so posting never blocks, and only the latest
+ * setpoint is picked up on each tick. Setpoints equal to the last one sent to a motor are not sent again, unless a stop
+ * has been sent to the motor or the transmit thread has dropped frames since, and setpoints whose deadline passed
+ * before the tick picked them up are dropped rather than sent late. With the in-flight window enabled (see
+ * @ref pipelining), a motor has at most one setpoint waiting behind its window, as a newer one replaces it, and a
+ * setpoint whose deadline passes while it waits is dropped rather than sent late. How late the
+ * thread wakes for each tick (jitter), and how many ticks it missed entirely, are reported by @ref getStreamStats.
+ *
+ * # Group Commands {#groups}
+ * Each driver can be given a group ID with @ref setGroupId, which it accepts frames on in addition to its own ID.
+ * @ref groupSetSpeed, @ref groupSendStep and @ref groupSeekPosition address every member of a group with a single
+ * frame, so that the members start moving at the same instant rather than one frame time apart, and a coordinated
+ * motion costs one frame instead of one per motor. The drivers never respond to frames sent to a group ID, so group
+ * commands bypass the in-flight window and produce no events; @ref confirmGroup queries each member afterwards to
+ * check that it received the command. Group membership is tracked by the controller as assigned with
+ * @ref setGroupId, and is not read back from the drivers.
+ *
+ * # Coordinated Moves {#coordinated}
+ * @ref planCoordinatedSeek chooses a speed and acceleration for each of several axes so that they all arrive at the
+ * same moment. The axis with the longest move runs at the requested speed and acceleration; every other axis is
+ * given the speed and acceleration whose predicted duration, under the driver's ramp model (see @ref mksMoveDuration),
+ * comes closest to the longest move's. Planning is done in the driver's own units, so the 12-bit speed quantisation
+ * and interpolated normalisation are accounted for rather than rounded away when the plan is sent. @ref seekCoordinated
+ * then sends the plan as a single batch, see @ref batching. Arrival is only as simultaneous as the moves' start: the
+ * frames take one frame time each to transmit, and any queueing in the in-flight window delays the axes behind it.
+ *
+ * # Batched Transmission {#batching}
+ * Commanding several motors one method call at a time hands the transmit thread one frame at a time, so other
+ * threads' frames can land between them. @ref sendBatch instead takes a @ref MksBatch of commands for any number of
+ * motors and queues every frame as one contiguous run, which the transmit thread hands to the kernel with a single
+ * `sendmmsg` call (per 64 frames), see @ref txqueue. The in-flight window and admission control apply to each command
+ * as usual, and commands they hold back are sent later, in order. If the transmit queue doesn't have room for the
+ * whole run, every frame in it is reported as failed rather than only some being sent. A stop in the batch splits it,
+ * as it goes out through the priority lane. Batched commands produce the same events as individual ones.
+ *
+ * # Transmit Queue {#txqueue}
+ * Every frame is sent by a single transmit thread, started on construction, so any number of threads can issue
+ * commands concurrently without contending on the socket or blocking on a full interface queue. Command methods
+ * return as soon as the frame is queued; a `false` return means the queue was full. Frames travel through two
+ * lock-free multi-producer lanes. Stops, i.e. @ref MksCommands::EMERGENCY_STOP (see @ref emergencyStop) and the stop
+ * variants of @ref MksCommands::SEND_STEP and @ref MksCommands::SEEK_POS_BY_STEPS (zero speed and steps), go through
+ * the priority lane, which the thread always empties before taking anything from the ordinary lane, so they jump
+ * ahead of any backlog. They also skip the queue of the in-flight window. Everything else goes through the ordinary
+ * lane in the order it was issued, so each motor sees its commands in order. Motion commands for a motor which were
+ * issued before a stop but are still queued are dropped rather than sent after it, where they would restart the motor.
+ * If the kernel refuses frames, the thread retries them until they are @ref TRANSMIT_TIMEOUT old, then drops them.
+ * Counts and queueing latencies for both lanes are reported by @ref getTransmitStats.
+ *
+ * # Emergency Stop {#estop}
+ * @ref emergencyStopAll stops every motor at once, from any context, including a signal handler or a watchdog thread
+ * which can't rely on the rest of the program being responsive. Its @ref MksCommands::EMERGENCY_STOP frames are
+ * built whenever the motor IDs are set, and are handed to the kernel on the calling thread, through a socket of their
+ * own, with a single `sendmmsg` call rather than through the transmit thread. It doesn't lock, allocate or log, and
+ * preserves `errno`. Like @ref emergencyStop, it keeps motion commands issued before it from being sent afterwards,
+ * whether they are waiting for the transmit thread or in an in-flight window, and it discards pending streaming
+ * setpoints. Group addressing isn't used, as groups only cover the motors assigned to them and the drivers don't
+ * acknowledge group frames; each motor gets a frame of its own, all in the one call, and answers it individually.
+ * As it doesn't wait for the transmit thread, a motion command the thread had already checked may still reach the bus
+ * just after the stops; the thread checks again once the kernel has accepted its frames, and follows any such command
+ * with another @ref MksCommands::EMERGENCY_STOP for the same motor, counted in @ref MksTransmitStats::restopped.
+ *
+ * # Bus Load {#busload}
+ * Every frame sent, and every frame received from another node, is charged its worst-case size to a sliding-window
+ * estimate of the bus load, see @ref busLoad. Frames looped back from other sockets on this host aren't counted, as
+ * they would otherwise double count our own commands. @ref setAdmissionControl uses the estimate to hold back
+ * low-priority commands (position, status and IO queries, including those issued by @ref startPolling) while the
+ * load is above a threshold, either refusing them outright or deferring them until the load drops, so that an
+ * overloaded bus shows up as visible backpressure rather than as send timeouts. Motion commands are never held back.
+ * Deferred commands are released whenever responses are processed, by @ref update, @ref drain or the receive thread.
+ *
+ * # Real-Time Threads {#realtime}
+ * The @ref RealtimeOptions given on construction apply to every thread the controller creates: the receive,
+ * polling, streaming and transmit threads are moved to `SCHED_FIFO` at the requested priority and pinned to the
+ * requested CPUs as soon as they are spawned, and each prefaults its stack before entering its loop. Memory locking
+ * and heap prefaulting, see @ref RealtimeMemoryOptions, affect the whole process and outlive the controller, so they
+ * are applied once, on construction. Every setting is read back after it is
+ * applied, and whether it took effect, e.g. because the process lacks `CAP_SYS_NICE`, is reported for each thread by
+ * @ref getRealtimeStatus rather than treated as an error, so the controller still works unprivileged.
+ *
+ * # Flight Recorder {#flightrecorder}
+ * Every frame sent and received can be kept in a fixed-size binary ring, see @ref flightRecorder. The ring can be
+ * written out as a pcapng capture on request with @ref FlightRecorder::dumpPcapng, or automatically whenever a driver
+ * reports a failure with @ref setFaultDumpPath, giving a full-fidelity trace of the lead-up to a fault without the cost
+ * of logging each frame. Frames are recorded as transmitted when they are sent; the copies the kernel loops back to
+ * this host's sockets aren't recorded again as received, as with @ref busload.
+ *
+ * # Transports {#transport}
+ * The controller reaches the bus through three `Transport` objects, one each for receiving, the transmit thread and
+ * @ref emergencyStopAll, each constructed from the `can_interface` name. The transport is a template parameter rather
+ * than an interface, so that calls on the hot paths are resolved at compile time and can be inlined. It must provide
+ * the same members as @ref CanSocket: a constructor taking the interface name, `MAX_BATCH`, `receive`,
+ * `receiveBatch`, `send`, `sendBatch`, `enableTimestamps`, `acceptStandardIds`, `acceptAll` and `lastError`.
+ * Controllers are instantiated for:
+ * - @ref CanSocket, as @ref MksStepperController, for SocketCAN interfaces, including vcan.
+ * - @ref CanLoopback, as @ref MksLoopbackController, for an in-memory bus, so that controllers and simulated drivers
+ *   (see @ref MksSimulator) can share a process without kernel sockets, e.g. for deterministic benchmarks.
+ * - @ref CanReplay, as @ref MksReplayController, which plays a recorded trace back as the bus' traffic.
+ *
+ * @ref emergencyStopAll is only async-signal-safe if the transport's `sendBatch` is, which holds for @ref CanSocket
+ * but not for the others, as they lock.
+ *
+ * @tparam Transport CAN transport, see @ref transport
  */
-class MksStepperController {
+template <typename Transport>
+class BasicMksStepperController {
 public:
+    /** Default limit on the number of messages read by a single call to @ref drain. */
+    static constexpr size_t DEFAULT_DRAIN_LIMIT = 256;
+
+    /** Number of events the receive thread can queue before the consumer must catch up, see @ref rxthread. */
+    static constexpr size_t EVENT_QUEUE_CAPACITY = 1024;
+
+    /** How long requests wait for a response by default, see @ref requests. */
+    static constexpr std::chrono::milliseconds DEFAULT_REQUEST_TIMEOUT{ 100 };
+
+    /** Number of ordinary frames which can wait for the transmit thread, see @ref txqueue. */
+    static constexpr size_t TRANSMIT_QUEUE_CAPACITY = 1024;
+
+    /** Number of stop frames which can wait for the transmit thread, see @ref txqueue. */
+    static constexpr size_t PRIORITY_QUEUE_CAPACITY = 256;
+
+    /** How long the transmit thread keeps retrying a frame the kernel refuses, measured from when it was queued. */
+    static constexpr std::chrono::milliseconds TRANSMIT_TIMEOUT{ 10 };
+
+    /** Result of a request: the matching response, or `std::nullopt` if it timed out or couldn't be sent. */
+    using Response = std::optional<MksEvent>;
+
     /**
      * Initializes an MksStepperController.
      *
-     * @param can_interface SocketCAN network interface corresponding to the CAN bus
+     * @param can_interface CAN bus to open each transport on, e.g. a SocketCAN network interface, see @ref transport
      * @param motor_ids CAN IDs for the motor controllers, used to filter CAN messages so other devices' messages aren't
-     *                  attempted to be decoded
+     *                  attempted to be decoded; installed as kernel-level filters so other devices' messages are
+     *                  dropped before they reach this process
      * @param norm_factor interpolated normalisation factor to use, see @ref internorm; defaults to off
+     * @param realtime scheduling, affinity and memory settings for the controller's threads, see @ref realtime;
+     *                 defaults to none. The memory settings apply to the whole process, not just the controller:
+     *                 with @ref RealtimeMemoryOptions::lock_memory, every page of the process is locked and the
+     *                 allocator stops returning memory to the kernel, and neither is undone on destruction
      */
-    MksStepperController(
+    BasicMksStepperController(
             const std::string& can_interface, std::shared_ptr<const std::unordered_set<uint16_t>> motor_ids,
-            const uint8_t norm_factor = 1
+            const uint8_t norm_factor = 1, const RealtimeOptions& realtime = {}
     );
 
     /**
      * Destroys an MksStepperController.
      */
-    ~MksStepperController() noexcept;
+    ~BasicMksStepperController() noexcept;
 
     /**
      * Sends a @ref MksCommands::SET_SPEED command to set the speed of a motor.
@@ -62,7 +744,7 @@ public:
      * @param motor the ID of the motor to control
      * @param speed the signed target speed to set the motor to, in RPM
      * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL; defaults to instantaneous
-     * @return `true` if transmitted over the CAN bus
+     * @return `true` if queued for transmission, see @ref txqueue
      */
     bool setSpeed(const uint16_t motor, const int16_t speed, const uint8_t acceleration = 0);
 
@@ -75,7 +757,7 @@ public:
      * @param num_steps the number of steps to move, maximum of 2^24 - 1
      * @param speed the signed target speed to set the motor to, in RPM
      * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL; defaults to instantaneous
-     * @return `true` if transmitted over the CAN bus
+     * @return `true` if queued for transmission, see @ref txqueue
      */
     bool sendStep(const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration = 0);
 
@@ -87,35 +769,462 @@ public:
      * @param position the target position in number of steps from the motor's zero point, maximum of 2^23 - 1
      * @param speed the signed target speed to set the motor to, in RPM; note that the absolute value is taken
      * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL; defaults to instantaneous
-     * @return `true` if transmitted over the CAN bus
+     * @return `true` if queued for transmission, see @ref txqueue
      */
     bool seekPosition(const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration = 0);
 
+    /**
+     * Sends a @ref MksCommands::EMERGENCY_STOP command to stop a motor without decelerating, through the priority lane
+     * of the transmit queue, see @ref txqueue. Motion commands for the motor which are still queued, whether in the
+     * transmit queue or the in-flight window, are dropped.
+     * The response isn't decoded.
+     *
+     * @param motor the ID of the motor to stop
+     * @return `true` if queued for transmission
+     */
+    bool emergencyStop(const uint16_t motor);
+
+    /**
+     * Sends prebuilt @ref MksCommands::EMERGENCY_STOP frames to every motor in one system call, see @ref estop.
+     * Async-signal-safe, except concurrently with @ref setMotorIds.
+     *
+     * @param timeout how long to keep retrying if the interface's queue is full; zero makes a single attempt
+     * @return how many frames the kernel accepted, and how long it took
+     */
+    MksEmergencyStopResult emergencyStopAll(const std::chrono::nanoseconds& timeout = TRANSMIT_TIMEOUT) noexcept;
+
     /**
       * Sends a @ref MksCommands::CURRENT_POS command to query the current position of a motor in steps.
       *
       * @param motor the ID of the motor to query
-      * @return `true` if transmitted over the CAN bus
+      * @return `true` if queued for transmission, see @ref txqueue
       */
     bool getPosition(const uint16_t motor);
 
     /**
-     * Returns whether the CAN bus connection has been fully established.
-     * @return `true` if so
-     */
-    [[nodiscard]] bool isSetup() const;
+      * Sends a @ref MksCommands::QUERY_STATUS command to query whether a motor is stopped, accelerating, etc.
+      * Response callbacks are available through @ref EGetStatus.
+      *
+      * @param motor the ID of the motor to query
+      * @return `true` if queued for transmission, see @ref txqueue
+      */
+    bool getStatus(const uint16_t motor);
 
     /**
-     * Polls for CAN messages.
-     * If an applicable message is received, the appropriate event is signalled.
+      * Sends a @ref MksCommands::IO_STATUS command to query the state of a motor's IO ports.
+      * Response callbacks are available through @ref EGetIoStatus.
+      *
+      * @param motor the ID of the motor to query
+      * @return `true` if queued for transmission, see @ref txqueue
+      */
+    bool getIoStatus(const uint16_t motor);
+
+    /**
+     * Sends a @ref MksCommands::SET_GROUP_ID command to add a motor to a group, see @ref groups.
+     * The motor is removed from any group previously assigned through this controller.
+     * Response callbacks are available through @ref ESetGroupId.
      *
-     * @param timeout maximum time to wait for a message to appear on the bus
+     * @param motor the ID of the motor to configure
+     * @param group the group ID, 0x001 to 0x7FF; must not be the ID of one of this controller's motors
+     * @return `true` if queued for transmission, see @ref txqueue
      */
-    void update(const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero());
-
-    // ==========================
-    //           Events
-    // ==========================
+    bool setGroupId(const uint16_t motor, const uint16_t group);
+
+    /**
+     * Sends a @ref MksCommands::SET_SPEED command to every member of a group in a single frame, see @ref groups.
+     * Parameters are as for @ref setSpeed.
+     *
+     * @param group the group ID to address
+     * @return `true` if queued for transmission, see @ref txqueue
+     */
+    bool groupSetSpeed(const uint16_t group, const int16_t speed, const uint8_t acceleration = 0);
+
+    /**
+     * Sends a @ref MksCommands::SEND_STEP command to every member of a group in a single frame, see @ref groups.
+     * Parameters are as for @ref sendStep.
+     *
+     * @param group the group ID to address
+     * @return `true` if queued for transmission, see @ref txqueue
+     */
+    bool groupSendStep(const uint16_t group, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration = 0);
+
+    /**
+     * Sends a @ref MksCommands::SEEK_POS_BY_STEPS command to every member of a group in a single frame, see
+     * @ref groups. Parameters are as for @ref seekPosition.
+     *
+     * @param group the group ID to address
+     * @return `true` if queued for transmission, see @ref txqueue
+     */
+    bool groupSeekPosition(
+            const uint16_t group, const int32_t position, const int16_t speed, const uint8_t acceleration = 0
+    );
+
+    /**
+     * Plans a coordinated move so that every axis arrives at the same time, see @ref coordinated.
+     * Does not send anything.
+     *
+     * @param moves each axis' target and last known position
+     * @param speed the speed of the longest move, in RPM as for @ref seekPosition; the sign is ignored
+     * @param acceleration the acceleration of the longest move, see @ref MksTest.Constants.MAX_ACCEL; 0 makes every
+     *                     axis change speed instantly
+     * @return the plan for each axis, in the order of `moves`
+     */
+    [[nodiscard]] std::vector<MksAxisPlan> planCoordinatedSeek(
+            const std::vector<MksAxisMove>& moves, const int16_t speed, const uint8_t acceleration
+    ) const;
+
+    /**
+     * Sends a @ref MksCommands::SEEK_POS_BY_STEPS command for every axis of a plan in one batch, see @ref coordinated.
+     * Response callbacks are available through @ref ESeekPosition.
+     *
+     * @param plan a plan from @ref planCoordinatedSeek
+     * @return `true` if every command was queued for transmission
+     */
+    bool seekCoordinated(const std::vector<MksAxisPlan>& plan);
+
+    /**
+     * Sends every command in a batch with as few system calls as possible, see @ref batching.
+     * Responses are signalled as for the equivalent individual commands.
+     *
+     * @param batch the commands to send, in order
+     * @return how many commands were sent or queued, and which failed
+     */
+    MksBatchResult sendBatch(const MksBatch& batch);
+
+    /**
+     * Returns the motors assigned to a group with @ref setGroupId, in the order they were assigned.
+     *
+     * @param group the group ID to look up
+     */
+    [[nodiscard]] std::vector<uint16_t> getGroupMembers(const uint16_t group) const;
+
+    /**
+     * Queries the status of every member of a group, e.g. after a group command, and waits for their answers.
+     * Queries are sent back to back, so the wait is bounded by `timeout` rather than growing with the group size.
+     * Responses must be processed concurrently, see @ref requests.
+     *
+     * @param group the group ID to confirm
+     * @param timeout how long to wait for each member's answer
+     * @return each member's answer, in the order returned by @ref getGroupMembers
+     */
+    std::vector<MksGroupConfirmation> confirmGroup(
+            const uint16_t group, const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    /**
+     * @name Requests
+     * Variants of the command methods which complete with the matching response, see @ref requests.
+     * The `request` methods return a future, and the `AndWait` methods block until it completes.
+     * Parameters are as for the corresponding command methods, plus:
+     *
+     * @param completion for move commands, whether to complete when the move is acknowledged or when it finishes
+     * @param timeout how long to wait for the response
+     * @return the matching response, or `std::nullopt` if it wasn't sent or no response arrived within `timeout`
+     */
+    //@{
+    std::future<Response> requestSetSpeed(
+            const uint16_t motor, const int16_t speed, const uint8_t acceleration = 0,
+            const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    std::future<Response> requestSendStep(
+            const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration = 0,
+            const MksCompletion completion = MksCompletion::ACKNOWLEDGED,
+            const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    std::future<Response> requestSeekPosition(
+            const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration = 0,
+            const MksCompletion completion = MksCompletion::ACKNOWLEDGED,
+            const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    std::future<Response> requestPosition(
+            const uint16_t motor, const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    Response setSpeedAndWait(
+            const uint16_t motor, const int16_t speed, const uint8_t acceleration = 0,
+            const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    Response sendStepAndWait(
+            const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration = 0,
+            const MksCompletion completion = MksCompletion::ACKNOWLEDGED,
+            const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    Response seekPositionAndWait(
+            const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration = 0,
+            const MksCompletion completion = MksCompletion::ACKNOWLEDGED,
+            const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT
+    );
+
+    Response getPositionAndWait(const uint16_t motor, const std::chrono::nanoseconds& timeout = DEFAULT_REQUEST_TIMEOUT);
+    //@}
+
+    /**
+     * Selects how received responses are timestamped, see @ref timestamps. May be called while the receive thread is
+     * running.
+     *
+     * @param mode the timestamp source
+     * @return `true` if the mode is supported by the CAN interface
+     */
+    bool enableReceiveTimestamps(const CanTimestampMode mode);
+
+    /**
+     * Returns the receive timestamp of the response currently being signalled.
+     * Only meaningful when called from within a signal handler, on the thread firing the signal.
+     */
+    [[nodiscard]] std::chrono::steady_clock::time_point eventTimestamp() const;
+
+    /**
+     * Starts a thread which continuously reads and decodes responses from the bus, see @ref rxthread.
+     * While it is running, responses are queued instead of signalled, and @ref update and @ref drain must not be
+     * called.
+     *
+     * @return `true` if the thread was started, `false` if it was already running
+     */
+    bool startReceiveThread();
+
+    /**
+     * Stops the thread started by @ref startReceiveThread, waiting for it to exit.
+     * Events which are still queued can be consumed afterwards.
+     */
+    void stopReceiveThread();
+
+    /**
+     * Returns whether the receive thread is running.
+     */
+    [[nodiscard]] bool isReceiveThreadRunning() const;
+
+    /**
+     * Removes the oldest event queued by the receive thread. Must only be called from one thread at a time.
+     *
+     * @param event populated with the removed event
+     * @return `true` if an event was removed, `false` if the queue was empty
+     */
+    bool popEvent(MksEvent& event);
+
+    /**
+     * Removes up to `max_events` events queued by the receive thread, firing the associated signal for each on the
+     * calling thread. Must only be called from one thread at a time.
+     *
+     * @param max_events maximum number of events to process
+     * @return number of events processed
+     */
+    size_t pollEvents(const size_t max_events = EVENT_QUEUE_CAPACITY);
+
+    /**
+     * Returns the number of events the receive thread has discarded because the queue was full.
+     */
+    [[nodiscard]] uint64_t droppedEvents() const;
+
+    /**
+     * Reads a consistent snapshot of the latest responses received from a motor, see @ref motorstate.
+     * Safe to call from any thread, except concurrently with @ref setMotorIds.
+     *
+     * @param motor the ID of the motor to look up
+     * @param state populated with the motor's cached state
+     * @return `true` if `motor` is one of this controller's motors
+     */
+    bool getMotorState(const uint16_t motor, MksMotorState& state) const;
+
+    /**
+     * Sets whether responses fire the `boost::signals2` signals in addition to the callback registries, see
+     * @ref callbacks. Signals are enabled by default.
+     *
+     * @param enabled `false` to skip the signals
+     */
+    void setSignalsEnabled(const bool enabled);
+
+    /**
+     * Returns the recorder holding recently sent and received frames, see @ref flightrecorder.
+     * Recording is disabled until @ref FlightRecorder::enable is called.
+     */
+    [[nodiscard]] FlightRecorder& flightRecorder();
+
+    /**
+     * Returns the estimate of how busy the CAN bus is, see @ref busload.
+     */
+    [[nodiscard]] BusLoadEstimator& busLoad();
+
+    /**
+     * Holds back low-priority commands while the bus is busy, see @ref busload.
+     * Commands deferred under a previous policy are released once the load falls below the new threshold, or
+     * immediately if admission control is disabled.
+     *
+     * @param threshold bus load, as a fraction of its capacity, above which low-priority commands are held back
+     * @param policy whether to refuse or defer held back commands
+     */
+    void setAdmissionControl(const double threshold, const MksAdmissionPolicy policy);
+
+    /**
+     * Returns the current bus load and the admission control counters, see @ref busload.
+     */
+    [[nodiscard]] MksAdmissionStats getAdmissionStats() const;
+
+    /**
+     * Sets a file to which the flight recorder is dumped whenever a driver reports a failure, i.e. a
+     * @ref MksCommands::SET_SPEED rejection or a @ref MksMoveResponse::FAILED move status.
+     * Each fault overwrites the previous dump. The dump is written on the thread processing responses.
+     *
+     * @param path pcapng file to write, or an empty string to disable dumping on faults
+     */
+    void setFaultDumpPath(const std::string& path);
+
+    /**
+     * Limits the number of unanswered commands per motor, see @ref pipelining.
+     * Commands queued when the window is disabled or widened are transmitted immediately.
+     *
+     * @param depth maximum number of unanswered commands per motor, or 0 to disable the window
+     * @param response_timeout how long a command may remain unanswered before it is dropped from the window
+     */
+    void setInFlightWindow(const size_t depth, const std::chrono::nanoseconds& response_timeout = DEFAULT_REQUEST_TIMEOUT);
+
+    /**
+     * Reads the in-flight window statistics for a motor, see @ref pipelining.
+     *
+     * @param motor the ID of the motor to look up
+     * @param stats populated with the motor's statistics
+     * @return `true` if `motor` is one of this controller's motors
+     */
+    bool getPipelineStats(const uint16_t motor, MksPipelineStats& stats) const;
+
+    /**
+     * Replaces the set of motors this controller listens to, and refreshes the kernel-level CAN filters to match.
+     * Should not be called concurrently with @ref update or @ref drain.
+     * Refused while the receive, polling or streaming thread is running, since they index the per-motor state this
+     * replaces; stop them first and restart them afterwards.
+     * Resets the in-flight window, transmitting any queued commands.
+     *
+     * @param motor_ids CAN IDs for the motor controllers
+     * @return `false` if a receive, polling or streaming thread is running, in which case nothing is changed
+     */
+    bool setMotorIds(std::shared_ptr<const std::unordered_set<uint16_t>> motor_ids);
+
+    /**
+     * Returns whether the CAN bus connection has been fully established.
+     * @return `true` if so
+     */
+    [[nodiscard]] bool isSetup() const;
+
+    /**
+     * Starts a thread which periodically queries every motor, see @ref polling.
+     *
+     * @param schedule the query rates and bus budget
+     * @return `true` if polling was started, `false` if it was already running or nothing was scheduled
+     */
+    bool startPolling(const MksPollSchedule& schedule);
+
+    /**
+     * Stops the thread started by @ref startPolling, waiting for it to exit. Statistics remain available.
+     */
+    void stopPolling();
+
+    /**
+     * Returns whether the thread started by @ref startPolling is running.
+     */
+    [[nodiscard]] bool isPolling() const;
+
+    /**
+     * Returns the rates achieved by the most recent @ref startPolling for a query, see @ref polling.
+     *
+     * @param query the query to report on
+     */
+    [[nodiscard]] MksPollStats getPollStats(const MksPollQuery query) const;
+
+    /**
+     * Starts a thread which sends the latest speed setpoint for each motor at a fixed rate, see @ref streaming.
+     *
+     * @param config the streaming rate and default setpoint lifetime
+     * @return `true` if streaming was started, `false` if it was already running, the rate isn't positive, or the timer
+     *         couldn't be created
+     */
+    bool startStreaming(const MksStreamConfig& config);
+
+    /**
+     * Stops the thread started by @ref startStreaming, waiting for it to exit. Statistics remain available.
+     */
+    void stopStreaming();
+
+    /**
+     * Returns whether the thread started by @ref startStreaming is running.
+     */
+    [[nodiscard]] bool isStreaming() const;
+
+    /**
+     * Posts a speed setpoint for the streaming thread to send, replacing any setpoint it hasn't picked up yet, see
+     * @ref streaming. Lock-free, so it can be called from any thread at any rate.
+     *
+     * @param motor the ID of the motor to control
+     * @param speed the signed target speed, in RPM as for @ref setSpeed
+     * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL; defaults to instantaneous
+     * @param deadline when the setpoint becomes too old to send; by default, @ref MksStreamConfig::max_age from now
+     * @return `true` if `motor` is one of this controller's motors
+     */
+    bool streamSpeed(
+            const uint16_t motor, const int16_t speed, const uint8_t acceleration = 0,
+            const std::chrono::steady_clock::time_point deadline = {}
+    );
+
+    /**
+     * Returns the statistics of the most recent @ref startStreaming, see @ref streaming.
+     */
+    [[nodiscard]] MksStreamStats getStreamStats() const;
+
+    /**
+     * Returns which of the @ref RealtimeOptions given on construction took effect for a thread, as of when it was last
+     * started, see @ref realtime. The memory settings are the same for every thread; the scheduling and affinity
+     * settings are @ref RealtimeResult::NOT_REQUESTED for a thread which has never been started.
+     *
+     * @param thread the thread to report on
+     */
+    [[nodiscard]] RealtimeStatus getRealtimeStatus(const MksThread thread) const;
+
+    /**
+     * Returns the transmit queue counters, see @ref txqueue.
+     */
+    [[nodiscard]] MksTransmitStats getTransmitStats() const;
+
+    /**
+     * Polls for CAN messages.
+     * If an applicable message is received, the appropriate event is signalled.
+     * Does not throw if no message arrives within the timeout, so it is safe to call in a tight loop.
+     *
+     * @param timeout maximum time to wait for a message to appear on the bus
+     */
+    void update(const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero());
+
+    /**
+     * Reads every CAN message waiting on the bus, up to `max_messages`, using batched reads.
+     * Messages are processed in arrival order and the appropriate events are signalled as with @ref update.
+     * Useful when responses from several motors arrive in bursts, since a single call empties the receive queue.
+     *
+     * @param max_messages maximum number of messages to read before returning
+     * @param timeout maximum time to wait for the first message to appear on the bus
+     * @return number of messages read from the bus
+     */
+    size_t drain(
+            const size_t max_messages = DEFAULT_DRAIN_LIMIT,
+            const std::chrono::nanoseconds& timeout = std::chrono::nanoseconds::zero()
+    );
+
+    /**
+     * Processes a frame as if it had just been read from the bus, on the calling thread: it is recorded, charged to the
+     * bus load, decoded, and the appropriate events are signalled as with @ref update. Unlike @ref update, expired
+     * requests and deferred commands are left for the next poll. Intended for replaying recorded traces through the
+     * decode path, e.g. from @ref readCanTrace.
+     *
+     * Must not be called concurrently with @ref update, @ref drain or the receive thread.
+     *
+     * @param frame the frame, stamped with when it was received
+     */
+    void injectFrame(const CanFrame& frame);
+
+    // ==========================
+    //           Events
+    // ==========================
 
     /**
      * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signal</a> triggered when
@@ -153,42 +1262,674 @@ public:
      */
     boost::signals2::signal<void(uint16_t, int32_t)> EGetPosition;
 
+    /**
+     * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signal</a> triggered when
+     * @ref getStatus responses are received.
+     *
+     * @param 1st [uint8_t] motor ID
+     * @param 2nd [MksMotorStatus] current motor state
+     */
+    boost::signals2::signal<void(uint16_t, MksMotorStatus)> EGetStatus;
+
+    /**
+     * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signal</a> triggered when
+     * @ref getIoStatus responses are received.
+     *
+     * @param 1st [uint8_t] motor ID
+     * @param 2nd [uint8_t] IO port flags, see @ref MksCommands::IO_STATUS
+     */
+    boost::signals2::signal<void(uint16_t, uint8_t)> EGetIoStatus;
+
+    /**
+     * <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>Boost signal</a> triggered when
+     * @ref setGroupId responses are received.
+     *
+     * @param 1st [uint8_t] motor ID
+     * @param 2nd [bool] `true` if the group ID was set
+     */
+    boost::signals2::signal<void(uint16_t, bool)> ESetGroupId;
+
+    /**
+     * @name Callback Registries
+     * Lock-free equivalents of @ref ESetSpeed, @ref ESendStep, @ref ESeekPosition, @ref EGetPosition,
+     * @ref EGetStatus, @ref EGetIoStatus and @ref ESetGroupId, invoked with the same parameters, see @ref callbacks.
+     */
+    //@{
+    CallbackRegistry<void(uint16_t, bool)> OnSetSpeed;
+
+    CallbackRegistry<void(uint16_t, MksMoveResponse)> OnSendStep;
+
+    CallbackRegistry<void(uint16_t, MksMoveResponse)> OnSeekPosition;
+
+    CallbackRegistry<void(uint16_t, int32_t)> OnGetPosition;
+
+    CallbackRegistry<void(uint16_t, MksMotorStatus)> OnGetStatus;
+
+    CallbackRegistry<void(uint16_t, uint8_t)> OnGetIoStatus;
+
+    CallbackRegistry<void(uint16_t, bool)> OnSetGroupId;
+    //@}
+
 protected:
+    /**
+     * Filters out frames which can't be MKS responses before passing them to @ref handleCanMessage.
+     *
+     * @param frame the frame read from the bus
+     */
+    void processFrame(const CanFrame& frame);
+
     /**
      * Handles received CAN messages and sends out signals as appropriate.
+     * Decodes directly from the frame's fixed-size buffer, so does not allocate.
      *
-     * @param message the message payload
-     * @param info auxiliary information associated with the message, e.g. driver ID, bus time
+     * @param frame the received frame, including its identifier and payload
      */
-    void handleCanMessage(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info);
+    void handleCanMessage(const CanFrame& frame);
 
     /**
      * @name Signal Processing Helper Functions
-     * Helper functions for decoding the parameters of Sysex commands processed by @ref handleSysex before forwarding
-     * to their associated <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>signal</a>.
+     * Helper functions for decoding the parameters of MKS responses processed by @ref handleCanMessage before
+     * forwarding to their associated <a href=https://www.boost.org/doc/libs/1_63_0/doc/html/signals.html>signal</a>.
      *
-     * @param message the de-firmatified Sysex payload
+     * @param frame the received frame, whose identifier is the responding motor's ID
      */
     //@{
-    void handleESetSpeed(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info);
+    void handleESetSpeed(const CanFrame& frame);
+
+    void handleESendStep(const CanFrame& frame);
+
+    void handleESeekPosition(const CanFrame& frame);
 
-    void handleESendStep(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info);
+    void handleEGetPosition(const CanFrame& frame);
 
-    void handleESeekPosition(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info);
+    void handleEGetStatus(const CanFrame& frame);
 
-    void handleEGetPosition(const std::vector<unsigned char>& message, drivers::socketcan::CanId& info);
+    void handleEGetIoStatus(const CanFrame& frame);
+
+    void handleESetGroupId(const CanFrame& frame);
     //@}
 
-    std::unique_ptr<drivers::socketcan::SocketCanReceiver> can_receiver;
-    std::unique_ptr<drivers::socketcan::SocketCanSender> can_sender;
+    /**
+     * Handles a response to @ref MksCommands::EMERGENCY_STOP, which has no signal: the moves it abandoned will never
+     * complete, so they no longer count towards @ref MotorPipeline::moves_in_progress.
+     */
+    void handleEmergencyStopResponse(const CanFrame& frame);
+
+    /**
+     * Records a decoded response in the responding motor's cached state, see @ref motorstate.
+     *
+     * @param event the decoded response
+     */
+    void recordMotorState(const MksEvent& event);
+
+    /**
+     * Forwards a decoded response, queueing it if the receive thread is running and signalling it otherwise.
+     *
+     * @param event the decoded response
+     */
+    void emitEvent(const MksEvent& event);
+
+    /**
+     * Fires the signal associated with a decoded response.
+     *
+     * @param event the decoded response
+     */
+    void dispatchEvent(const MksEvent& event);
+
+    /**
+     * Dumps the flight recorder if a decoded response reports a failure and a dump path is set.
+     *
+     * @param event the decoded response
+     */
+    void checkFault(const MksEvent& event);
+
+    /**
+     * Queues a command frame for the transmit thread, in the priority lane if it is a stop, see @ref txqueue.
+     *
+     * @param motor the motor to send to
+     * @param payload the command payload, including its checksum
+     * @param length number of bytes in `payload`
+     * @return `true` if queued, `false` if the lane was full
+     */
+    bool transmit(const uint16_t motor, const uint8_t* payload, const size_t length);
+
+    /**
+     * A frame waiting in one of the transmit queue's lanes.
+     */
+    struct TransmitEntry {
+        uint16_t id;
+        uint8_t length;
+        std::array<uint8_t, 8> payload;
+
+        /**
+         * Position of an ordinary frame in issue order, or, for a stop, the position of the next ordinary frame; used
+         * to tell which motion commands a stop supersedes.
+         */
+        uint64_t sequence;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    /**
+     * Queues ordinary frames for the transmit thread as one contiguous run, see @ref txqueue.
+     *
+     * @param entries the frames to queue, in order; their sequence numbers are assigned here
+     * @param count number of frames in `entries`
+     * @return `true` if every frame was queued, `false` if the lane didn't have room for all of them
+     */
+    bool transmitAll(TransmitEntry* entries, const size_t count);
+
+    /**
+     * Wakes the transmit thread if it is waiting for frames.
+     */
+    void wakeTransmitter();
+
+    /**
+     * Applies admission control to a command, then passes it on to the in-flight window, see @ref busload.
+     *
+     * @param motor the motor to send to
+     * @param type the type of response the command produces
+     * @param payload the command payload, including its checksum
+     * @param deadline for streamed setpoints, see @ref enqueue
+     * @return `true` if transmitted or queued, `false` if it couldn't be sent or was refused
+     */
+    bool submit(
+            const uint16_t motor, const MksEvent::Type type, const MksPayload& payload,
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()
+    );
+
+    /**
+     * An encoded command on its way to @ref submitBatch.
+     */
+    struct EncodedCommand {
+        uint16_t motor;
+        MksEvent::Type type;
+        MksPayload payload;
+    };
+
+    /**
+     * Outcome of admission control for a single command, see @ref admit.
+     */
+    enum class Admission : uint8_t { ADMITTED, DEFERRED, REFUSED };
+
+    /**
+     * Applies admission control to a command, deferring it if the policy says so, see @ref busload.
+     *
+     * @param motor the motor to send to
+     * @param type the type of response the command produces
+     * @param payload the command payload, including its checksum
+     * @return whether the command may be sent now, was deferred, or was refused
+     */
+    Admission admit(const uint16_t motor, const MksEvent::Type type, const MksPayload& payload);
+
+    /**
+     * Applies admission control and the in-flight window to each command, then queues every command which may go out
+     * now for the transmit thread as one run, see @ref batching.
+     *
+     * @param commands the commands to send, in order
+     * @return how many commands were sent or queued, and the indices of those which failed
+     */
+    MksBatchResult submitBatch(const std::vector<EncodedCommand>& commands);
+
+    /**
+     * Charges a transmitted frame to the bus load estimate and records it in the flight recorder.
+     */
+    void recordTransmitted(
+            const uint16_t motor, const uint8_t* payload, const size_t length,
+            const std::chrono::steady_clock::time_point time
+    );
+
+    /**
+     * Encodes a batched command, applying interpolated normalisation.
+     *
+     * @param command the command to encode
+     * @param payload set to the encoded command
+     * @return `false` if the command type can't be batched
+     */
+    bool encodeBatchCommand(const MksBatchCommand& command, MksPayload& payload) const;
+
+    /**
+     * Returns the encoder for frames addressed to `can_id`: the prebuilt one if it is one of our motors, otherwise
+     * (e.g. for a group ID) a fresh one.
+     */
+    [[nodiscard]] MksEncoder encoder(const uint16_t can_id) const;
+
+    /**
+     * Transmits a command, or queues it if the motor's in-flight window is full, see @ref pipelining.
+     *
+     * @param motor the motor to send to
+     * @param type the type of response the command produces
+     * @param payload the command payload, including its checksum
+     * @param length number of bytes in `payload`
+     * @param deadline for streamed setpoints, when the command may no longer be sent; a queued streamed setpoint is
+     *                 replaced by the next one rather than sent ahead of it. Other commands are never dropped
+     * @return `true` if transmitted or queued
+     */
+    bool enqueue(
+            const uint16_t motor, const MksEvent::Type type, const uint8_t* payload, const size_t length,
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()
+    );
+
+    /**
+     * Passes deferred commands on to the in-flight window while the bus load is below the admission threshold.
+     */
+    void releaseDeferred();
+
+    /**
+     * Frees a slot in the responding motor's in-flight window, and transmits queued commands which now fit.
+     *
+     * @param event the decoded response
+     */
+    void releaseInFlight(const MksEvent& event);
+
+    /**
+     * Drops commands which have been unanswered for longer than the response timeout from every in-flight window.
+     */
+    void expireInFlight();
+
+    /**
+     * An outstanding request started by @ref beginRequest.
+     */
+    struct Request {
+        uint64_t id;
+        std::chrono::steady_clock::time_point deadline;
+        std::future<Response> response;
+    };
+
+    /**
+     * Registers a request for a response, before its command is sent so that the response can't be missed.
+     *
+     * @param motor the motor the command is sent to
+     * @param type the type of response expected
+     * @param completion which response completes the request
+     * @param timeout how long to wait for the response
+     */
+    Request beginRequest(
+            const uint16_t motor, const MksEvent::Type type, const MksCompletion completion,
+            const std::chrono::nanoseconds& timeout
+    );
+
+    /**
+     * Completes a request with `std::nullopt` if it is still outstanding, e.g. because its command couldn't be sent.
+     *
+     * @param id the request's ID
+     */
+    void cancelRequest(const uint64_t id);
+
+    /**
+     * Blocks until a request completes or its deadline passes, then returns its result.
+     *
+     * @param request the request to wait for
+     */
+    Response awaitRequest(Request& request);
+
+    /**
+     * Completes the oldest outstanding request matching a decoded response, see @ref requests.
+     *
+     * @param event the decoded response
+     */
+    void resolveRequests(const MksEvent& event);
+
+    /**
+     * Completes every outstanding request whose deadline has passed with `std::nullopt`.
+     */
+    void expireRequests();
+
+    /**
+     * Applies the real-time options to a thread which has just been spawned and records the outcome, see @ref realtime.
+     *
+     * @param thread which of the controller's threads `handle` is
+     * @param handle the thread to configure
+     */
+    void applyRealtime(const MksThread thread, std::thread& handle);
+
+    /**
+     * Body of the polling thread, see @ref startPolling.
+     */
+    void pollLoop();
+
+    /**
+     * Body of the streaming thread, see @ref startStreaming.
+     */
+    void streamLoop();
+
+    /**
+     * Body of the receive thread, see @ref startReceiveThread.
+     */
+    void receiveLoop();
+
+    /**
+     * Body of the transmit thread, see @ref txqueue.
+     */
+    void transmitLoop();
+
+    /**
+     * Hands frames taken from a lane to the kernel, dropping those which have expired or been superseded, and
+     * following any motion command overtaken by @ref emergencyStopAll while it was being sent with another stop.
+     * Only called from the transmit thread.
+     *
+     * @param staged the frames, oldest first; the ones still waiting are moved to the front
+     * @param count number of frames in `staged`
+     * @param priority whether the frames came from the priority lane
+     * @return number of frames still waiting
+     */
+    size_t sendStaged(TransmitEntry* staged, const size_t count, const bool priority);
+
+    /**
+     * Blocks the transmit thread until a frame is queued or it is told to stop.
+     */
+    void waitForFrames();
+
+    /**
+     * Rebuilds @ref motor_index from @ref motor_ids, and installs kernel-level CAN filters on @ref can_receiver to
+     * match.
+     */
+    void applyMotorIds();
+
+    std::unique_ptr<Transport> can_receiver;
+    std::unique_ptr<Transport> can_sender;
+
+    /** Transport used only by @ref emergencyStopAll, so that its frames don't queue behind the transmit thread's. */
+    std::unique_ptr<Transport> can_emergency;
     std::shared_ptr<const std::unordered_set<uint16_t>> motor_ids;
+
+    /**
+     * Lookup table built from @ref motor_ids, used to check incoming identifiers without hashing.
+     */
+    MotorIndex motor_index;
+
+    /**
+     * Cached state for each motor, indexed by @ref motor_index slot.
+     */
+    std::unique_ptr<Seqlock<MksMotorState>[]> motor_states;
+
+    /**
+     * Command encoder for each motor, indexed by @ref motor_index slot, so the fixed parts of each frame are only
+     * computed once.
+     */
+    std::unique_ptr<MksEncoder[]> encoders;
+
+    /** @ref MksCommands::EMERGENCY_STOP frame for each motor, indexed by @ref motor_index slot, see @ref estop. */
+    std::unique_ptr<CanFrame[]> emergency_frames;
     const uint8_t norm_factor;
 
+    FlightRecorder flight_recorder;
+    BusLoadEstimator bus_load;
+
 private:
     /**
      * Flag which indicates whether the CAN bus connection has been initialised.
      */
     bool setup_completed;
+
+    const RealtimeOptions realtime_options;
+
+    /** Outcome of the process-wide settings, applied on construction. */
+    RealtimeStatus process_realtime;
+
+    /** Outcome of the per-thread settings, indexed by @ref MksThread. */
+    std::array<RealtimeStatus, MKS_THREAD_COUNT> thread_realtime;
+    mutable std::mutex realtime_mutex;
+
+    std::thread receive_thread;
+    std::atomic<bool> receive_thread_running;
+
+    /**
+     * Lanes of the transmit queue, see @ref txqueue. Any thread pushes, only the transmit thread pops.
+     */
+    std::unique_ptr<MpscRing<TransmitEntry, PRIORITY_QUEUE_CAPACITY>> priority_lane;
+    std::unique_ptr<MpscRing<TransmitEntry, TRANSMIT_QUEUE_CAPACITY>> normal_lane;
+
+    std::thread transmit_thread;
+    std::atomic<bool> transmitting;
+
+    /** `eventfd` which wakes the transmit thread while @ref transmitter_idle is set. */
+    int transmit_event;
+    std::atomic<bool> transmitter_idle;
+
+    /** Source of @ref TransmitEntry::sequence for ordinary frames. */
+    std::atomic<uint64_t> transmit_sequence;
+
+    /** Sequence of the latest stop sent to each standard CAN ID, see @ref TransmitEntry::sequence. */
+    std::unique_ptr<std::atomic<uint64_t>[]> stop_sequences;
+
+    /** Sequence of the latest @ref emergencyStopAll, whose stops bypass the transmit thread, see @ref sendStaged. */
+    std::atomic<uint64_t> emergency_sequence;
+
+    /** Counters for @ref getTransmitStats. */
+    std::atomic<uint64_t> transmit_sent;
+    std::atomic<uint64_t> transmit_priority_sent;
+    std::atomic<uint64_t> transmit_rejected;
+    std::atomic<uint64_t> transmit_failed;
+    std::atomic<uint64_t> transmit_superseded;
+    std::atomic<uint64_t> transmit_restopped;
+    std::atomic<int64_t> transmit_max_latency;
+    std::atomic<int64_t> transmit_max_priority_latency;
+
+    /**
+     * Whether decoded responses are queued rather than signalled; stays set until the receive thread has exited.
+     */
+    std::atomic<bool> queue_events;
+    std::unique_ptr<SpscRing<MksEvent, EVENT_QUEUE_CAPACITY>> event_queue;
+    std::atomic<uint64_t> dropped_events;
+
+    /**
+     * Timestamp of the event being dispatched, see @ref eventTimestamp.
+     */
+    std::chrono::steady_clock::time_point dispatching_timestamp;
+
+    /**
+     * Whether @ref dispatchEvent fires signals in addition to the callback registries, see @ref setSignalsEnabled.
+     */
+    std::atomic<bool> signals_enabled;
+
+    /**
+     * Where to dump the flight recorder on a fault, see @ref setFaultDumpPath; guarded by @ref fault_dump_mutex.
+     */
+    std::string fault_dump_path;
+    std::mutex fault_dump_mutex;
+    std::atomic<bool> dump_on_fault;
+
+    /**
+     * A request awaiting its response, see @ref requests.
+     */
+    struct PendingRequest {
+        uint64_t id;
+        uint16_t motor;
+        MksEvent::Type type;
+        MksCompletion completion;
+
+        /** Whether a @ref MksCompletion::FINISHED move has already been acknowledged with a MOVING response. */
+        bool acknowledged;
+        std::chrono::steady_clock::time_point deadline;
+        std::promise<Response> promise;
+    };
+
+    /**
+     * Outstanding requests in the order they were sent, guarded by @ref request_mutex.
+     */
+    std::vector<PendingRequest> pending_requests;
+    std::mutex request_mutex;
+    uint64_t next_request_id;
+
+    /**
+     * Size of @ref pending_requests, so the receive path can skip locking when there are no outstanding requests.
+     */
+    std::atomic<size_t> pending_request_count;
+
+    /**
+     * A command which has been sent but not answered.
+     */
+    struct InFlightCommand {
+        MksEvent::Type type;
+        std::chrono::steady_clock::time_point sent;
+
+        /** Whether it is the stop variant of a move, whose acknowledgement means every earlier move was abandoned. */
+        bool stop = false;
+    };
+
+    /**
+     * A command waiting for room in the in-flight window.
+     */
+    struct QueuedCommand {
+        MksEvent::Type type;
+        uint8_t length;
+        std::array<uint8_t, 8> payload;
+        std::chrono::steady_clock::time_point queued;
+
+        /** Position in issue order, as for @ref TransmitEntry::sequence, so that a later stop can supersede it. */
+        uint64_t sequence;
+
+        /** When a streamed setpoint may no longer be sent; the maximum for every other command. */
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /**
+     * In-flight window state for a single motor, see @ref pipelining.
+     */
+    struct MotorPipeline {
+        std::deque<InFlightCommand> in_flight;
+        std::deque<QueuedCommand> queue;
+
+        /**
+         * Moves acknowledged with a MOVING response whose final response hasn't arrived yet. Used to tell a finished
+         * move's COMPLETED response apart from the acknowledgement of a newer one. Moves cut short by a stop never
+         * send a final response, so it is reset when a stop is issued, and again when the driver acknowledges it.
+         */
+        uint32_t moves_in_progress = 0;
+        MksPipelineStats stats;
+    };
+
+    /**
+     * Transmits queued commands while there is room in the window.
+     *
+     * @param motor the motor the pipeline belongs to
+     * @param pipeline the motor's pipeline, with @ref pipeline_mutex held
+     */
+    void transmitQueued(const uint16_t motor, MotorPipeline& pipeline);
+
+    /**
+     * Drops the motion commands from a motor's queue behind its in-flight window, as a stop has been issued after them;
+     * @ref pipeline_mutex must be held.
+     */
+    void discardQueuedMotion(MotorPipeline& pipeline);
+
+    /**
+     * Appends a command to a motor's queue behind its in-flight window; @ref pipeline_mutex must be held.
+     */
+    void queueCommand(
+            MotorPipeline& pipeline, const MksEvent::Type type, const uint8_t* payload, const size_t length,
+            const std::chrono::steady_clock::time_point time,
+            const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()
+    );
+
+    /**
+     * In-flight window for each motor, indexed by @ref motor_index slot and guarded by @ref pipeline_mutex.
+     */
+    std::unique_ptr<MotorPipeline[]> pipelines;
+    mutable std::mutex pipeline_mutex;
+    size_t window_depth;
+    std::chrono::nanoseconds window_timeout;
+
+    /**
+     * Whether the in-flight window is enabled, so the receive path can skip locking when it isn't.
+     */
+    std::atomic<bool> window_enabled;
+
+    /**
+     * Members of each group assigned with @ref setGroupId, keyed by group ID and guarded by @ref group_mutex.
+     */
+    std::unordered_map<uint16_t, std::vector<uint16_t>> group_members;
+    mutable std::mutex group_mutex;
+
+    /** Number of commands which may be deferred by admission control before further ones are refused. */
+    static constexpr size_t MAX_DEFERRED_COMMANDS = 256;
+
+    /**
+     * A low-priority command held back by admission control.
+     */
+    struct DeferredCommand {
+        uint16_t motor;
+        MksEvent::Type type;
+        uint8_t length;
+        std::array<uint8_t, 8> payload;
+    };
+
+    /**
+     * Admission control settings and deferred commands, guarded by @ref admission_mutex.
+     */
+    std::deque<DeferredCommand> deferred_commands;
+    mutable std::mutex admission_mutex;
+    std::atomic<double> admission_threshold;
+    std::atomic<MksAdmissionPolicy> admission_policy;
+    std::atomic<uint64_t> admission_refused;
+    std::atomic<uint64_t> admission_deferred;
+
+    /**
+     * Whether any commands are deferred, so that the receive path can skip locking when none are.
+     */
+    std::atomic<bool> has_deferred;
+
+    /** Number of @ref MksPollQuery values. */
+    static constexpr size_t POLL_QUERY_COUNT = 3;
+
+    std::thread poll_thread;
+    std::atomic<bool> polling;
+
+    /**
+     * Guards @ref poll_schedule, @ref poll_scale and the polling period, and wakes the polling thread to stop.
+     */
+    mutable std::mutex poll_mutex;
+    std::condition_variable poll_wakeup;
+    MksPollSchedule poll_schedule;
+
+    /** Factor the requested rates were scaled by to fit within the bus budget. */
+    double poll_scale;
+    std::chrono::steady_clock::time_point poll_start;
+    std::chrono::steady_clock::time_point poll_stop;
+
+    /** Counters for each @ref MksPollQuery. */
+    std::array<std::atomic<uint64_t>, POLL_QUERY_COUNT> poll_issued;
+    std::array<std::atomic<uint64_t>, POLL_QUERY_COUNT> poll_skipped;
+    std::array<std::atomic<uint64_t>, POLL_QUERY_COUNT> poll_failed;
+    std::array<std::atomic<uint64_t>, POLL_QUERY_COUNT> poll_responses;
+
+    std::thread stream_thread;
+    std::atomic<bool> streaming;
+
+    /** `timerfd` which paces the streaming thread, open while it runs. */
+    int stream_timer;
+    double stream_rate;
+    std::atomic<int64_t> stream_max_age;
+
+    /** Reference point for the deadlines packed into @ref stream_mailboxes. */
+    const std::chrono::steady_clock::time_point stream_epoch;
+
+    /**
+     * Latest setpoint for each motor, indexed by @ref motor_index slot. Each packs the speed, acceleration and deadline
+     * into one word so that it can be replaced atomically by any number of writers.
+     */
+    std::unique_ptr<std::atomic<uint64_t>[]> stream_mailboxes;
+
+    /** Counters for @ref getStreamStats. */
+    std::atomic<uint64_t> stream_ticks;
+    std::atomic<uint64_t> stream_missed;
+    std::atomic<uint64_t> stream_sent;
+    std::atomic<uint64_t> stream_unchanged;
+    std::atomic<uint64_t> stream_stale;
+    std::atomic<uint64_t> stream_replaced;
+    std::atomic<uint64_t> stream_expired;
+    std::atomic<uint64_t> stream_failed;
+    std::atomic<int64_t> stream_total_jitter;
+    std::atomic<int64_t> stream_max_jitter;
 };
 
+/** Controller for a SocketCAN interface, see @ref BasicMksStepperController. */
+using MksStepperController = BasicMksStepperController<CanSocket>;
+
+/** Controller for an in-memory @ref CanLoopback bus, see @ref BasicMksStepperController. */
+using MksLoopbackController = BasicMksStepperController<CanLoopback>;
+
+/** Controller which plays a recorded trace back as the bus' traffic, see @ref CanReplay. */
+using MksReplayController = BasicMksStepperController<CanReplay>;
+
 #endif //UMRT_ARM_FIRMWARE_LIB_MKS_STEPPER_CONTROLLER_HPP
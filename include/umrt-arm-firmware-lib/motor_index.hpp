@@ -0,0 +1,86 @@
+/**
+ * @file
+ * Constant-time mapping from standard CAN identifiers to dense per-motor slots.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_MOTOR_INDEX_HPP
+#define UMRT_ARM_FIRMWARE_LIB_MOTOR_INDEX_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Maps each 11-bit CAN identifier to a dense slot index in [0, @ref size), so that checking whether a frame comes from
+ * one of our motors is a single table load, and per-motor state can be kept in flat arrays indexed by slot.
+ *
+ * Slots are assigned in ascending order of motor ID.
+ */
+class MotorIndex {
+public:
+    /** Slot value for identifiers which don't belong to a motor. */
+    static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+    /** Number of standard (11-bit) CAN identifiers. */
+    static constexpr size_t TABLE_SIZE = 0x800;
+
+    /**
+     * Creates an index containing no motors.
+     */
+    MotorIndex() { slots.fill(NO_SLOT); }
+
+    /**
+     * Creates an index for a set of motors.
+     * IDs which don't fit in a standard CAN identifier can never match a response and are skipped.
+     *
+     * @param motor_ids CAN IDs of the motors to index
+     */
+    explicit MotorIndex(const std::unordered_set<uint16_t>& motor_ids) : MotorIndex() {
+        for (const uint16_t id : motor_ids) {
+            if (id < TABLE_SIZE) { slot_motors.push_back(id); }
+        }
+        std::sort(slot_motors.begin(), slot_motors.end());
+        for (size_t slot = 0; slot < slot_motors.size(); ++slot) {
+            slots[slot_motors[slot]] = static_cast<uint16_t>(slot);
+        }
+    }
+
+    /**
+     * Looks up the slot for a CAN identifier.
+     *
+     * @param id the CAN identifier, with any flag bits removed
+     * @return the motor's slot, or @ref NO_SLOT if `id` isn't one of the indexed motors
+     */
+    [[nodiscard]] uint16_t slot(const uint32_t id) const noexcept { return id < TABLE_SIZE ? slots[id] : NO_SLOT; }
+
+    /**
+     * Returns whether a CAN identifier belongs to one of the indexed motors.
+     */
+    [[nodiscard]] bool contains(const uint32_t id) const noexcept { return slot(id) != NO_SLOT; }
+
+    /**
+     * Returns the motor ID assigned to a slot.
+     *
+     * @param slot a slot in [0, @ref size)
+     */
+    [[nodiscard]] uint16_t motor(const uint16_t slot) const noexcept { return slot_motors[slot]; }
+
+    /**
+     * Returns the indexed motor IDs, ordered by slot.
+     */
+    [[nodiscard]] const std::vector<uint16_t>& motors() const noexcept { return slot_motors; }
+
+    /**
+     * Returns the number of indexed motors.
+     */
+    [[nodiscard]] size_t size() const noexcept { return slot_motors.size(); }
+
+private:
+    std::array<uint16_t, TABLE_SIZE> slots{};
+    std::vector<uint16_t> slot_motors;
+};
+
+#endif //UMRT_ARM_FIRMWARE_LIB_MOTOR_INDEX_HPP
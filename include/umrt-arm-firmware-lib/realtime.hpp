@@ -0,0 +1,108 @@
+/**
+ * @file
+ * Real-time scheduling, CPU pinning and memory locking for the threads the controllers create, so that CAN latency
+ * stays bounded when the rest of the system is busy.
+ */
+
+#ifndef UMRT_ARM_FIRMWARE_LIB_REALTIME_HPP
+#define UMRT_ARM_FIRMWARE_LIB_REALTIME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * Memory settings for a controller. Unlike the thread settings in @ref RealtimeOptions, these affect the whole process
+ * rather than just the controller, and stay in effect after the controller is destroyed. The defaults change nothing.
+ */
+struct RealtimeMemoryOptions {
+    /**
+     * Locks all current and future pages of the process into memory (`mlockall`), so that a page fault can never stall
+     * a thread. Once locked, the allocator is also told never to return freed memory to the kernel
+     * (`M_TRIM_THRESHOLD`) and never to serve large allocations with their own `mmap` (`M_MMAP_MAX`), so that the
+     * process keeps, and reuses, every page its heap has ever grown to.
+     */
+    bool lock_memory = false;
+
+    /**
+     * Bytes of heap touched and released when the controller is constructed. With @ref lock_memory, the released memory
+     * is kept by the allocator, so later allocations are served from pages which are already resident.
+     */
+    size_t prefault_heap = 0;
+};
+
+/**
+ * Real-time settings for a controller and the threads it creates. The defaults change nothing.
+ */
+struct RealtimeOptions : RealtimeMemoryOptions {
+    /** `SCHED_FIFO` priority for the controller's threads, 1 to 99; 0 leaves them under the default scheduler. */
+    int priority = 0;
+
+    /** CPUs the controller's threads may run on; empty leaves their affinity unchanged. */
+    std::vector<int> cpus;
+
+    /** Bytes of stack each of the controller's threads touches when it starts, so the stack is resident up front. */
+    size_t prefault_stack = 0;
+};
+
+/**
+ * Outcome of applying a single setting from @ref RealtimeOptions.
+ */
+enum class RealtimeResult : uint8_t {
+    /** The setting wasn't requested. */
+    NOT_REQUESTED,
+
+    /** The setting was applied, and reading it back confirmed it took effect. */
+    APPLIED,
+
+    /** The setting was requested but didn't take effect, see @ref RealtimeStatus::error. */
+    FAILED
+};
+
+/**
+ * Which of the requested @ref RealtimeOptions took effect.
+ */
+struct RealtimeStatus {
+    /** Outcome of @ref RealtimeOptions::priority. */
+    RealtimeResult scheduling = RealtimeResult::NOT_REQUESTED;
+
+    /** Outcome of @ref RealtimeOptions::cpus. */
+    RealtimeResult affinity = RealtimeResult::NOT_REQUESTED;
+
+    /** Outcome of @ref RealtimeMemoryOptions::lock_memory. */
+    RealtimeResult memory_lock = RealtimeResult::NOT_REQUESTED;
+
+    /** Outcome of @ref RealtimeOptions::prefault_stack and @ref RealtimeMemoryOptions::prefault_heap. */
+    RealtimeResult prefault = RealtimeResult::NOT_REQUESTED;
+
+    /** `errno` of the most recent failure, e.g. `EPERM` without `CAP_SYS_NICE`, or 0 if nothing failed. */
+    int error = 0;
+};
+
+/**
+ * Applies the process-wide settings, see @ref RealtimeMemoryOptions.
+ *
+ * @param options the settings to apply
+ * @return the outcome of the memory settings; the thread settings are left as @ref RealtimeResult::NOT_REQUESTED
+ */
+RealtimeStatus applyProcessRealtime(const RealtimeMemoryOptions& options);
+
+/**
+ * Applies the per-thread settings, @ref RealtimeOptions::priority and @ref RealtimeOptions::cpus, to a running thread.
+ * The stack isn't prefaulted, as that has to be done from the thread itself, see @ref prefaultStack.
+ *
+ * @param thread the thread to configure
+ * @param options the settings to apply
+ * @return the outcome of the thread settings; the memory settings are left as @ref RealtimeResult::NOT_REQUESTED
+ */
+RealtimeStatus applyThreadRealtime(std::thread& thread, const RealtimeOptions& options);
+
+/**
+ * Touches `bytes` of the calling thread's stack, so that the pages are resident before they are needed.
+ *
+ * @param bytes how much stack to touch; should be comfortably below the thread's stack size
+ */
+void prefaultStack(const size_t bytes);
+
+#endif //UMRT_ARM_FIRMWARE_LIB_REALTIME_HPP
@@ -5,38 +5,56 @@
 #ifndef UMRT_ARM_FIRMWARE_LIB_SERVO_CONTROLLER_HPP
 #define UMRT_ARM_FIRMWARE_LIB_SERVO_CONTROLLER_HPP
 
+#include <chrono>
 #include <string>
 #include <memory>
 
-// Forward declaring these classes so that ros2_socketcan can be a private dependency
-namespace drivers::socketcan {
-    class SocketCanReceiver;
-    class SocketCanSender;
-    class CanId;
-} // namespace drivers::socketcan
+#include "flight_recorder.hpp"
+#include "realtime.hpp"
+
+class CanLoopback;
+class CanSocket;
 
 /**
  * Abstracts CAN bus communication to a CAN-PWM gateway.
  * It is intended that this will one day support multiple servos, likely using DroneCAN's
  * uavcan.equipment.actuator.ArrayCommand messages to communicate with a Mateksys CAN-L4-PWM gateway.
+ *
+ * The controller sends from the caller's thread and creates no threads of its own, so it only takes the process-wide
+ * @ref RealtimeMemoryOptions.
+ *
+ * Like @ref BasicMksStepperController, the CAN transport is a template parameter, see @ref transport; of its members
+ * only the constructor and `send` are used.
+ *
+ * @tparam Transport CAN transport, e.g. @ref CanSocket
  */
-class ServoController {
+template <typename Transport>
+class BasicServoController {
 public:
+    /** How long @ref send waits for room in the interface's transmit queue. */
+    static constexpr std::chrono::milliseconds SEND_TIMEOUT{ 10 };
+
     /**
      * Initializes an ServoController.
      *
-     * @param can_interface SocketCAN network interface corresponding to the CAN bus
+     * Any memory settings requested are applied to the whole process, not just the controller: with
+     * @ref RealtimeMemoryOptions::lock_memory, every page of the process is locked and the allocator stops returning
+     * memory to the kernel, and neither is undone when the controller is destroyed.
+     *
+     * @param can_interface CAN bus to open the transport on, e.g. a SocketCAN network interface
      * @param servo_id CAN ID corresponding to the gateway's command interface
+     * @param memory process-wide memory locking and prefaulting; defaults to none
      */
-    ServoController(
+    BasicServoController(
             const std::string& can_interface,
-            const uint16_t servo_id
+            const uint16_t servo_id,
+            const RealtimeMemoryOptions& memory = {}
     );
 
     /**
      * Destroys an ServoController.
      */
-    ~ServoController() noexcept;
+    ~BasicServoController() noexcept;
 
     /**
      * Command a servo position.
@@ -51,9 +69,24 @@ public:
      */
     [[nodiscard]] bool isSetup() const;
 
+    /**
+     * Returns the recorder holding recently sent frames, which can be dumped as a pcapng capture with
+     * @ref FlightRecorder::dumpPcapng. Recording is disabled until @ref FlightRecorder::enable is called.
+     */
+    [[nodiscard]] FlightRecorder& flightRecorder();
+
+    /**
+     * Returns which of the @ref RealtimeMemoryOptions given on construction took effect. As the controller has no
+     * threads, the scheduling and affinity settings are always @ref RealtimeResult::NOT_REQUESTED.
+     */
+    [[nodiscard]] RealtimeStatus getRealtimeStatus() const;
+
 protected:
     const uint16_t servo_id_;
-    std::unique_ptr<drivers::socketcan::SocketCanSender> can_sender_;
+    std::unique_ptr<Transport> can_sender_;
+    FlightRecorder flight_recorder_;
+    const RealtimeMemoryOptions memory_options_;
+    RealtimeStatus realtime_status_;
 
 private:
     /**
@@ -62,4 +95,10 @@ private:
     bool setup_completed_;
 };
 
+/** Controller for a SocketCAN interface, see @ref BasicServoController. */
+using ServoController = BasicServoController<CanSocket>;
+
+/** Controller for an in-memory @ref CanLoopback bus, see @ref BasicServoController. */
+using ServoLoopbackController = BasicServoController<CanLoopback>;
+
 #endif //UMRT_ARM_FIRMWARE_LIB_SERVO_CONTROLLER_HPP
@@ -200,15 +200,25 @@ inline std::vector<uint8_t> firmatify_8(const uint8_t val) {
     return { static_cast<uint8_t>(val & 0x7F), static_cast<uint8_t>((val & 0x80) >> 7) };
 }
 
+/**
+ * Reconstructs a little-endian byte buffer into a 32-bit integer.
+ * Does not allocate, so it is suitable for decoding fixed-size buffers such as CAN frames.
+ *
+ * @param data pointer to at least 4 bytes
+ * @return a 32-bit integer
+ */
+inline uint32_t decode_32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16
+           | static_cast<uint32_t>(data[3]) << 24;
+}
+
 /**
  * Reconstructs a little-endian byte vector into a 32-bit integer.
  *
  * @param data iterator to the byte vector subset to convert
  * @return a 32-bit integer
  */
-inline uint32_t decode_32(const std::vector<uint8_t>::const_iterator& data) {
-    return data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24;
-}
+inline uint32_t decode_32(const std::vector<uint8_t>::const_iterator& data) { return decode_32(&*data); }
 
 /**
  * Calls decode_32(const std::vector<uint8_t>::const_iterator&) with `data.cbegin()`
@@ -218,15 +228,25 @@ inline uint32_t decode_32(const std::vector<uint8_t>::const_iterator& data) {
  */
 inline uint32_t decode_32(const std::vector<uint8_t>& data) { return decode_32(data.cbegin()); }
 
+/**
+ * Reconstructs a big-endian byte buffer into a 32-bit integer.
+ * Does not allocate, so it is suitable for decoding fixed-size buffers such as CAN frames.
+ *
+ * @param data pointer to at least 4 bytes
+ * @return a 32-bit integer
+ */
+inline uint32_t decode_32_big(const uint8_t* data) {
+    return static_cast<uint32_t>(data[3]) | static_cast<uint32_t>(data[2]) << 8 | static_cast<uint32_t>(data[1]) << 16
+           | static_cast<uint32_t>(data[0]) << 24;
+}
+
 /**
  * Reconstructs a big-endian byte vector into a 32-bit integer.
  *
  * @param data iterator to the byte vector subset to convert
  * @return a 32-bit integer
  */
-inline uint32_t decode_32_big(const std::vector<uint8_t>::const_iterator& data) {
-    return data[3] | data[2] << 8 | data[1] << 16 | data[0] << 24;
-}
+inline uint32_t decode_32_big(const std::vector<uint8_t>::const_iterator& data) { return decode_32_big(&*data); }
 
 /**
  * Calls decode_32_big(const std::vector<uint8_t>::const_iterator&) with `data.cbegin()`
@@ -237,15 +257,24 @@ inline uint32_t decode_32_big(const std::vector<uint8_t>::const_iterator& data)
 inline uint32_t decode_32_big(const std::vector<uint8_t>& data) { return decode_32_big(data.cbegin()); }
 
 /**
- * Reconstructs a little-endian byte vector into a 16-bit integer.
+ * Reconstructs a little-endian byte buffer into a 16-bit integer.
+ * Does not allocate, so it is suitable for decoding fixed-size buffers such as CAN frames.
  *
- * @param data iterator to the byte vector subset to convert
+ * @param data pointer to at least 2 bytes
  * @return a 16-bit integer
  */
-inline uint16_t decode_16(const std::vector<uint8_t>::const_iterator& data) {
+inline uint16_t decode_16(const uint8_t* data) {
     return static_cast<uint16_t>(data[0]) | static_cast<uint16_t>(data[1] << 8);
 }
 
+/**
+ * Reconstructs a little-endian byte vector into a 16-bit integer.
+ *
+ * @param data iterator to the byte vector subset to convert
+ * @return a 16-bit integer
+ */
+inline uint16_t decode_16(const std::vector<uint8_t>::const_iterator& data) { return decode_16(&*data); }
+
 /**
  * Calls decode_16(const std::vector<uint8_t>::const_iterator&) with `data.cbegin()`
  *
@@ -255,15 +284,24 @@ inline uint16_t decode_16(const std::vector<uint8_t>::const_iterator& data) {
 inline uint16_t decode_16(const std::vector<uint8_t>& data) { return decode_16(data.cbegin()); }
 
 /**
- * Reconstructs a big-endian byte vector into a 16-bit integer.
+ * Reconstructs a big-endian byte buffer into a 16-bit integer.
+ * Does not allocate, so it is suitable for decoding fixed-size buffers such as CAN frames.
  *
- * @param data iterator to the byte vector subset to convert
+ * @param data pointer to at least 2 bytes
  * @return a 16-bit integer
  */
-inline uint16_t decode_16_big(const std::vector<uint8_t>::const_iterator& data) {
+inline uint16_t decode_16_big(const uint8_t* data) {
     return static_cast<uint16_t>(data[1]) | static_cast<uint16_t>(data[0] << 8);
 }
 
+/**
+ * Reconstructs a big-endian byte vector into a 16-bit integer.
+ *
+ * @param data iterator to the byte vector subset to convert
+ * @return a 16-bit integer
+ */
+inline uint16_t decode_16_big(const std::vector<uint8_t>::const_iterator& data) { return decode_16_big(&*data); }
+
 /**
  * Calls decode_16(const std::vector<uint8_t>::const_iterator&) with `data.cbegin()`
  *
@@ -11,7 +11,7 @@
 #include "arduino_stepper_controller.hpp"
 #include "utils.hpp"
 
-ArduinoStepperController::ArduinoStepperController() : setup_completed(false) {
+ArduinoStepperController::ArduinoStepperController() : setup_completed(false), signals_enabled(true) {
     BOOST_LOG_TRIVIAL(trace) << "ArduinoStepperController construction begun";
 
     // Bind to the initialization connection of the ofArduino, and call this->setupArduino(majorFirmwareVersion)
@@ -111,9 +111,13 @@ bool ArduinoStepperController::setGripper(const uint8_t position) {
 
 bool ArduinoStepperController::isSetup() const { return this->setup_completed; };
 
+void ArduinoStepperController::setSignalsEnabled(const bool enabled) { this->signals_enabled = enabled; }
+
 void ArduinoStepperController::handleEArduinoEcho(const std::vector<unsigned char>& message) {
     BOOST_LOG_TRIVIAL(debug) << "ArduinoEcho received";
-    this->EArduinoEcho(std::vector<uint8_t>(message.cbegin(), message.cend()));
+    const std::vector<uint8_t> payload(message.cbegin(), message.cend());
+    this->OnArduinoEcho(payload);
+    if (this->signals_enabled) { this->EArduinoEcho(payload); }
 }
 
 void ArduinoStepperController::handleESetSpeed(const std::vector<unsigned char>& message) {
@@ -122,7 +126,8 @@ void ArduinoStepperController::handleESetSpeed(const std::vector<unsigned char>&
     it += 1;
     auto speed = static_cast<int16_t>(decode_16(it));
     BOOST_LOG_TRIVIAL(debug) << "SetSpeed received for motor " << motor << " with speed=" << speed;
-    this->ESetSpeed(motor, speed);
+    this->OnSetSpeed(motor, speed);
+    if (this->signals_enabled) { this->ESetSpeed(motor, speed); }
 }
 
 void ArduinoStepperController::handleEGetSpeed(const std::vector<unsigned char>& message) {
@@ -131,7 +136,8 @@ void ArduinoStepperController::handleEGetSpeed(const std::vector<unsigned char>&
     it += 1;
     auto speed = static_cast<int16_t>(decode_16(it));
     BOOST_LOG_TRIVIAL(debug) << "GetSpeed received for motor " << motor << " with speed=" << speed;
-    this->EGetSpeed(motor, speed);
+    this->OnGetSpeed(motor, speed);
+    if (this->signals_enabled) { this->EGetSpeed(motor, speed); }
 }
 
 void ArduinoStepperController::handleESendStep(const std::vector<unsigned char>& message) {
@@ -143,7 +149,8 @@ void ArduinoStepperController::handleESendStep(const std::vector<unsigned char>&
     auto speed = static_cast<int16_t>(decode_16(it));
     BOOST_LOG_TRIVIAL(debug) << "SendStep received for motor " << motor << " with steps=" << steps << ", speed="
                              << speed;
-    this->ESendStep(motor, steps, speed);
+    this->OnSendStep(motor, steps, speed);
+    if (this->signals_enabled) { this->ESendStep(motor, steps, speed); }
 }
 
 void ArduinoStepperController::handleESeekPosition(const std::vector<unsigned char>& message) {
@@ -155,7 +162,8 @@ void ArduinoStepperController::handleESeekPosition(const std::vector<unsigned ch
     auto speed = static_cast<int16_t>(decode_16(it));
     BOOST_LOG_TRIVIAL(debug) << "SeekPosition received for motor " << motor << " with position=" << position << ", speed="
                              << speed;
-    this->ESeekPosition(motor, position, speed);
+    this->OnSeekPosition(motor, position, speed);
+    if (this->signals_enabled) { this->ESeekPosition(motor, position, speed); }
 }
 
 void ArduinoStepperController::handleEGetPosition(const std::vector<unsigned char>& message) {
@@ -164,12 +172,14 @@ void ArduinoStepperController::handleEGetPosition(const std::vector<unsigned cha
     it += 1;
     auto position = static_cast<int32_t>(decode_32(it));
     BOOST_LOG_TRIVIAL(debug) << "GetPosition received for motor " << motor << " with position=" << position;
-    this->EGetPosition(motor, position);
+    this->OnGetPosition(motor, position);
+    if (this->signals_enabled) { this->EGetPosition(motor, position); }
 }
 
 void ArduinoStepperController::handleESetGripper(const std::vector<unsigned char>& message) {
     BOOST_LOG_TRIVIAL(debug) << "SetGripper received";
-    this->ESetGripper(message[0]);
+    this->OnSetGripper(message[0]);
+    if (this->signals_enabled) { this->ESetGripper(message[0]); }
 }
 
 void ArduinoStepperController::handleSysex(const std::vector<unsigned char>& message) {
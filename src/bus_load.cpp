@@ -0,0 +1,79 @@
+#include "bus_load.hpp"
+
+#include <algorithm>
+
+BusLoadEstimator::BusLoadEstimator(const uint32_t bitrate, const std::chrono::nanoseconds& window)
+    : bitrate_{ bitrate },
+      bucket_width{ std::max<std::chrono::steady_clock::duration>(
+              std::chrono::duration_cast<std::chrono::steady_clock::duration>(window) / BUCKETS,
+              std::chrono::steady_clock::duration(1)
+      ) },
+      total_frames{ 0 }, total_bits{ 0 } {
+    for (auto& bucket : buckets) { bucket.store(0, std::memory_order_relaxed); }
+}
+
+void BusLoadEstimator::record(const uint8_t length, const std::chrono::steady_clock::time_point time) noexcept {
+    const uint32_t frame_bits = standardFrameBits(std::min<uint8_t>(length, 8));
+    const uint64_t current = interval(time);
+    std::atomic<uint64_t>& bucket = buckets[current % BUCKETS];
+
+    uint64_t expected = bucket.load(std::memory_order_relaxed);
+    uint64_t desired;
+    do {
+        // A bucket still holding an older interval is recycled; one holding a newer interval means this frame was
+        // recorded late by a slow thread, and it is charged to the newer interval rather than lost
+        const uint64_t held = expected >> BIT_COUNT_WIDTH;
+        const uint64_t behind = age(current, held);
+        const bool stale = (expected & BIT_COUNT_MASK) == 0 || (behind != 0 && behind <= SEQUENCE_MASK / 2);
+        const uint64_t count = stale ? 0 : expected & BIT_COUNT_MASK;
+        const uint64_t sequence = stale ? current : held;
+        desired = sequence << BIT_COUNT_WIDTH | std::min(count + frame_bits, BIT_COUNT_MASK);
+    } while (!bucket.compare_exchange_weak(expected, desired, std::memory_order_relaxed));
+
+    total_frames.fetch_add(1, std::memory_order_relaxed);
+    total_bits.fetch_add(frame_bits, std::memory_order_relaxed);
+}
+
+double BusLoadEstimator::bitsPerSecond(const std::chrono::steady_clock::time_point now) const noexcept {
+    const uint64_t current = interval(now);
+    uint64_t window_bits = 0;
+    for (const auto& bucket : buckets) {
+        const uint64_t value = bucket.load(std::memory_order_relaxed);
+        const uint64_t held = value >> BIT_COUNT_WIDTH;
+        // Only the current interval and the BUCKETS - 1 before it are inside the window
+        if (age(current, held) < BUCKETS) { window_bits += value & BIT_COUNT_MASK; }
+    }
+
+    // The current interval is only partly over, so the window spans the full intervals plus however much of it has
+    // elapsed; dividing by the nominal window length would under-report a burst at the start of an interval
+    const auto since_epoch = now.time_since_epoch();
+    const auto elapsed = since_epoch - (since_epoch / bucket_width) * bucket_width;
+    const auto span = std::chrono::duration<double>(bucket_width * static_cast<int64_t>(BUCKETS - 1) + elapsed);
+    return span.count() > 0 ? static_cast<double>(window_bits) / span.count() : 0;
+}
+
+double BusLoadEstimator::utilisation(const std::chrono::steady_clock::time_point now) const noexcept {
+    const uint32_t rate = bitrate();
+    return rate > 0 ? bitsPerSecond(now) / rate : 0;
+}
+
+uint64_t BusLoadEstimator::frames() const noexcept { return total_frames.load(std::memory_order_relaxed); }
+
+uint64_t BusLoadEstimator::bits() const noexcept { return total_bits.load(std::memory_order_relaxed); }
+
+uint32_t BusLoadEstimator::bitrate() const noexcept { return bitrate_.load(std::memory_order_relaxed); }
+
+std::chrono::nanoseconds BusLoadEstimator::window() const noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bucket_width * static_cast<int64_t>(BUCKETS));
+}
+
+void BusLoadEstimator::setBitrate(const uint32_t bitrate) noexcept { bitrate_.store(bitrate, std::memory_order_relaxed); }
+
+uint64_t BusLoadEstimator::age(const uint64_t newer, const uint64_t older) noexcept {
+    return (newer - older) & SEQUENCE_MASK;
+}
+
+uint64_t BusLoadEstimator::interval(const std::chrono::steady_clock::time_point time) const noexcept {
+    const auto count = time.time_since_epoch() / bucket_width;
+    return static_cast<uint64_t>(std::max<decltype(count)>(count, 0)) & SEQUENCE_MASK;
+}
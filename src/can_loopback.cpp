@@ -0,0 +1,115 @@
+#include "can_loopback.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+/**
+ * Endpoints sharing a bus name.
+ */
+struct CanLoopback::Bus {
+    /** Guards @ref endpoints; taken before any endpoint's own mutex. */
+    std::mutex mutex;
+    std::vector<CanLoopback*> endpoints;
+};
+
+CanLoopback::CanLoopback(const std::string& bus, const bool remote)
+    : remote{ remote }, queue{ std::make_unique<CanFrame[]>(QUEUE_CAPACITY) }, queue_head{ 0 }, queue_size{ 0 },
+      accepted{}, accept_all{ true }, dropped_frames{ 0 } {
+    this->bus = findBus(bus);
+    std::lock_guard<std::mutex> lock(this->bus->mutex);
+    this->bus->endpoints.push_back(this);
+}
+
+CanLoopback::~CanLoopback() noexcept {
+    std::lock_guard<std::mutex> lock(bus->mutex);
+    bus->endpoints.erase(std::find(bus->endpoints.begin(), bus->endpoints.end(), this));
+}
+
+bool CanLoopback::receive(CanFrame& frame, const std::chrono::nanoseconds& timeout) noexcept {
+    return receiveBatch(&frame, 1, timeout) == 1;
+}
+
+size_t CanLoopback::receiveBatch(
+        CanFrame* frames, const size_t max_frames, const std::chrono::nanoseconds& timeout
+) noexcept {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (queue_size == 0 && timeout > std::chrono::nanoseconds::zero()) {
+        readable.wait_for(lock, timeout, [this]() { return queue_size > 0; });
+    }
+
+    const size_t count = std::min(max_frames, queue_size);
+    for (size_t i = 0; i < count; ++i) {
+        frames[i] = queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_CAPACITY;
+    }
+    queue_size -= count;
+    return count;
+}
+
+bool CanLoopback::send(const CanFrame& frame, const std::chrono::nanoseconds& timeout) noexcept {
+    return sendBatch(&frame, 1, timeout) == 1;
+}
+
+size_t CanLoopback::sendBatch(const CanFrame* frames, const size_t count, const std::chrono::nanoseconds&) noexcept {
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(bus->mutex);
+    for (size_t i = 0; i < count; ++i) {
+        CanFrame frame = frames[i];
+        frame.local = !remote;
+        frame.timestamp = now;
+        for (CanLoopback* endpoint : bus->endpoints) {
+            if (endpoint != this) { endpoint->deliver(frame); }
+        }
+    }
+    return count;
+}
+
+bool CanLoopback::enableTimestamps(const CanTimestampMode) noexcept { return true; }
+
+bool CanLoopback::acceptStandardIds(const std::vector<uint16_t>& ids) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    accepted.fill(false);
+    for (const uint16_t id : ids) { accepted[id & 0x7FF] = true; }
+    accept_all = false;
+    return true;
+}
+
+bool CanLoopback::acceptAll() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    accept_all = true;
+    return true;
+}
+
+int CanLoopback::lastError() const noexcept { return 0; }
+
+uint64_t CanLoopback::dropped() const noexcept { return dropped_frames.load(std::memory_order_relaxed); }
+
+std::shared_ptr<CanLoopback::Bus> CanLoopback::findBus(const std::string& name) {
+    // Only weak references, so that a bus is destroyed along with its last endpoint
+    static std::mutex registry_mutex;
+    static std::unordered_map<std::string, std::weak_ptr<Bus>> registry;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::weak_ptr<Bus>& entry = registry[name];
+    std::shared_ptr<Bus> bus = entry.lock();
+    if (!bus) {
+        bus = std::make_shared<Bus>();
+        entry = bus;
+    }
+    return bus;
+}
+
+void CanLoopback::deliver(const CanFrame& frame) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Same match as CanSocket's filters: standard data frames with a listed identifier
+        if (!accept_all && (frame.extended || frame.remote || frame.error || !accepted[frame.id & 0x7FF])) { return; }
+        if (queue_size == QUEUE_CAPACITY) {
+            dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        queue[(queue_head + queue_size) % QUEUE_CAPACITY] = frame;
+        ++queue_size;
+    }
+    readable.notify_one();
+}
@@ -0,0 +1,329 @@
+#include "can_socket.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+    /** Room for the SCM_TIMESTAMPING control message, plus any others the kernel decides to attach. */
+    constexpr size_t CONTROL_BUFFER_SIZE = CMSG_SPACE(sizeof(scm_timestamping)) + 64;
+
+    /**
+     * Converts a `CLOCK_REALTIME` kernel timestamp onto the `CLOCK_MONOTONIC` timeline.
+     * Both clocks are sampled back to back, so the conversion is accurate to within a few hundred nanoseconds, and
+     * follows any wall-clock adjustments made since the frame arrived.
+     */
+    std::chrono::steady_clock::time_point realtimeToSteady(const timespec& realtime) noexcept {
+        timespec now_real{};
+        timespec now_mono{};
+        clock_gettime(CLOCK_REALTIME, &now_real);
+        clock_gettime(CLOCK_MONOTONIC, &now_mono);
+        const auto to_ns = [](const timespec& ts) {
+            return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+        };
+        const auto age = to_ns(now_real) - to_ns(realtime);
+        return std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(to_ns(now_mono) - age)
+        );
+    }
+
+    /**
+     * Extracts the receive timestamp from a message's control data.
+     *
+     * @param header the message header filled in by `recvmsg`/`recvmmsg`
+     * @param fallback timestamp to use if the kernel didn't attach one
+     */
+    std::chrono::steady_clock::time_point extractTimestamp(
+            msghdr& header, const std::chrono::steady_clock::time_point fallback
+    ) noexcept {
+        if (header.msg_control == nullptr) { return fallback; }
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) { continue; }
+            scm_timestamping timestamps{};
+            std::memcpy(&timestamps, CMSG_DATA(cmsg), sizeof(timestamps));
+            // ts[2] holds the raw hardware timestamp and ts[0] the software one; unset entries are zero
+            for (const timespec& ts : { timestamps.ts[2], timestamps.ts[0] }) {
+                if (ts.tv_sec != 0 || ts.tv_nsec != 0) { return realtimeToSteady(ts); }
+            }
+        }
+        return fallback;
+    }
+
+    /**
+     * Converts a @ref CanFrame into a kernel frame.
+     */
+    can_frame toRawFrame(const CanFrame& frame) noexcept {
+        can_frame raw{};
+        raw.can_id = frame.extended ? (frame.id & CAN_EFF_MASK) | CAN_EFF_FLAG : frame.id & CAN_SFF_MASK;
+        if (frame.remote) { raw.can_id |= CAN_RTR_FLAG; }
+        raw.can_dlc = frame.length > CanFrame::MAX_LENGTH ? CanFrame::MAX_LENGTH : frame.length;
+        std::memcpy(raw.data, frame.data.data(), raw.can_dlc);
+        return raw;
+    }
+
+    /**
+     * Converts a kernel frame into a @ref CanFrame.
+     */
+    void fromRawFrame(const can_frame& raw, CanFrame& frame) noexcept {
+        frame.extended = (raw.can_id & CAN_EFF_FLAG) != 0;
+        frame.remote = (raw.can_id & CAN_RTR_FLAG) != 0;
+        frame.error = (raw.can_id & CAN_ERR_FLAG) != 0;
+        frame.id = raw.can_id & (frame.extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+        frame.length = raw.can_dlc > CanFrame::MAX_LENGTH ? CanFrame::MAX_LENGTH : raw.can_dlc;
+        std::memcpy(frame.data.data(), raw.data, frame.length);
+    }
+} // namespace
+
+CanSocket::CanSocket(const std::string& can_interface)
+    : fd{ -1 }, last_error{ 0 }, timestamp_mode{ CanTimestampMode::USERSPACE } {
+    fd = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+    if (fd < 0) { throw std::runtime_error("CanSocket: failed to open socket: " + std::string(std::strerror(errno))); }
+
+    const unsigned int if_index = if_nametoindex(can_interface.c_str());
+    if (if_index == 0) {
+        close(fd);
+        throw std::runtime_error("CanSocket: unknown interface " + can_interface);
+    }
+
+    sockaddr_can address{};
+    address.can_family = AF_CAN;
+    address.can_ifindex = static_cast<int>(if_index);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        const int bind_error = errno;
+        close(fd);
+        throw std::runtime_error(
+                "CanSocket: failed to bind to " + can_interface + ": " + std::string(std::strerror(bind_error))
+        );
+    }
+}
+
+CanSocket::~CanSocket() noexcept {
+    if (fd >= 0) { close(fd); }
+}
+
+bool CanSocket::receive(CanFrame& frame, const std::chrono::nanoseconds& timeout) noexcept {
+    // With a zero timeout skip the poll entirely, a non-blocking read already tells us whether anything is waiting
+    if (timeout > std::chrono::nanoseconds::zero() && !waitReadable(timeout)) { return false; }
+
+    can_frame raw{};
+    iovec vector{ &raw, sizeof(raw) };
+    alignas(cmsghdr) char control[CONTROL_BUFFER_SIZE];
+    msghdr header{};
+    header.msg_iov = &vector;
+    header.msg_iovlen = 1;
+    if (timestamp_mode.load(std::memory_order_relaxed) != CanTimestampMode::USERSPACE) {
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+    }
+
+    const ssize_t bytes = recvmsg(fd, &header, MSG_DONTWAIT);
+    if (bytes < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) { last_error = errno; }
+        return false;
+    }
+    if (static_cast<size_t>(bytes) < sizeof(raw)) {
+        // Truncated read, shouldn't happen on a non-FD socket
+        last_error = EIO;
+        return false;
+    }
+
+    fromRawFrame(raw, frame);
+    // The kernel flags frames it looped back from a local sender
+    frame.local = (header.msg_flags & MSG_DONTROUTE) != 0;
+    frame.timestamp = extractTimestamp(header, std::chrono::steady_clock::now());
+    return true;
+}
+
+size_t CanSocket::receiveBatch(CanFrame* frames, const size_t max_frames, const std::chrono::nanoseconds& timeout) noexcept {
+    if (max_frames == 0) { return 0; }
+    if (timeout > std::chrono::nanoseconds::zero() && !waitReadable(timeout)) { return 0; }
+
+    can_frame raw[MAX_BATCH];
+    iovec vectors[MAX_BATCH];
+    mmsghdr headers[MAX_BATCH];
+    alignas(cmsghdr) char controls[MAX_BATCH][CONTROL_BUFFER_SIZE];
+    const bool kernel_timestamps = timestamp_mode.load(std::memory_order_relaxed) != CanTimestampMode::USERSPACE;
+
+    size_t received = 0;
+    while (received < max_frames) {
+        const size_t batch = std::min(MAX_BATCH, max_frames - received);
+        for (size_t i = 0; i < batch; ++i) {
+            vectors[i] = { &raw[i], sizeof(can_frame) };
+            headers[i] = {};
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            if (kernel_timestamps) {
+                headers[i].msg_hdr.msg_control = controls[i];
+                headers[i].msg_hdr.msg_controllen = CONTROL_BUFFER_SIZE;
+            }
+        }
+
+        const int count = recvmmsg(fd, headers, static_cast<unsigned int>(batch), MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) { last_error = errno; }
+            break;
+        }
+
+        const auto read_time = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            // Truncated reads shouldn't happen on a non-FD socket, but don't hand out garbage if they do
+            if (headers[i].msg_len < sizeof(can_frame)) {
+                last_error = EIO;
+                continue;
+            }
+            fromRawFrame(raw[i], frames[received]);
+            frames[received].local = (headers[i].msg_hdr.msg_flags & MSG_DONTROUTE) != 0;
+            frames[received].timestamp = extractTimestamp(headers[i].msg_hdr, read_time);
+            ++received;
+        }
+
+        // A short batch means the queue has been emptied
+        if (static_cast<size_t>(count) < batch) { break; }
+    }
+    return received;
+}
+
+bool CanSocket::send(const CanFrame& frame, const std::chrono::nanoseconds& timeout) noexcept {
+    const can_frame raw = toRawFrame(frame);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (::send(fd, &raw, sizeof(raw), MSG_DONTWAIT) < 0) {
+        if (!waitWritable(errno, deadline)) { return false; }
+    }
+    return true;
+}
+
+size_t CanSocket::sendBatch(const CanFrame* frames, const size_t count, const std::chrono::nanoseconds& timeout) noexcept {
+    can_frame raw[MAX_BATCH];
+    iovec vectors[MAX_BATCH];
+    mmsghdr headers[MAX_BATCH];
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    size_t sent = 0;
+    while (sent < count) {
+        const size_t batch = std::min(MAX_BATCH, count - sent);
+        for (size_t i = 0; i < batch; ++i) {
+            raw[i] = toRawFrame(frames[sent + i]);
+            vectors[i] = { &raw[i], sizeof(can_frame) };
+            headers[i] = {};
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // sendmmsg only reports an error if the very first message fails; a short count means a later one did, and
+        // retrying from there surfaces its error
+        const int accepted = sendmmsg(fd, headers, static_cast<unsigned int>(batch), MSG_DONTWAIT);
+        if (accepted < 0) {
+            if (!waitWritable(errno, deadline)) { break; }
+            continue;
+        }
+        sent += static_cast<size_t>(accepted);
+    }
+    return sent;
+}
+
+bool CanSocket::enableTimestamps(const CanTimestampMode mode) noexcept {
+    int flags = 0;
+    switch (mode) {
+        case CanTimestampMode::USERSPACE: break;
+        case CanTimestampMode::SOFTWARE: flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE; break;
+        case CanTimestampMode::HARDWARE:
+            // Request software timestamps as well, so there is something to fall back on if the driver has no clock
+            flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE
+                    | SOF_TIMESTAMPING_SOFTWARE;
+            break;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+        last_error = errno;
+        return false;
+    }
+    timestamp_mode.store(mode, std::memory_order_relaxed);
+    return true;
+}
+
+bool CanSocket::acceptStandardIds(const std::vector<uint16_t>& ids) noexcept {
+    if (ids.size() > CAN_RAW_FILTER_MAX) {
+        // Same error the kernel reports for an oversized filter list
+        last_error = EINVAL;
+        return false;
+    }
+
+    // Match the identifier exactly, and require the extended and remote flags to be cleared
+    can_filter filters[CAN_RAW_FILTER_MAX];
+    for (size_t i = 0; i < ids.size(); ++i) {
+        filters[i].can_id = ids[i] & CAN_SFF_MASK;
+        filters[i].can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+    }
+
+    // A zero-length filter list tells the kernel to deliver nothing
+    const auto length = static_cast<socklen_t>(ids.size() * sizeof(can_filter));
+    if (setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, ids.empty() ? nullptr : filters, length) < 0) {
+        last_error = errno;
+        return false;
+    }
+    return true;
+}
+
+bool CanSocket::acceptAll() noexcept {
+    // Same as the kernel's default filter
+    const can_filter filter{ 0, 0 };
+    if (setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter)) < 0) {
+        last_error = errno;
+        return false;
+    }
+    return true;
+}
+
+int CanSocket::lastError() const noexcept { return last_error; }
+
+int CanSocket::fileDescriptor() const noexcept { return fd; }
+
+bool CanSocket::waitWritable(const int error, const std::chrono::steady_clock::time_point deadline) noexcept {
+    // ENOBUFS means the interface's queue is full; unlike EAGAIN, poll doesn't wait for it to drain, so back off for
+    // about one frame time instead
+    constexpr auto BACKOFF = std::chrono::microseconds(250);
+
+    if (error == EINTR) { return true; }
+    if (error != EAGAIN && error != EWOULDBLOCK && error != ENOBUFS) {
+        last_error = error;
+        return false;
+    }
+    const auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) { return false; }
+
+    const auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            error == ENOBUFS ? std::min<std::chrono::steady_clock::duration>(remaining, BACKOFF) : remaining
+    );
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(wait);
+    const timespec poll_timeout{ static_cast<time_t>(seconds.count()), static_cast<long>((wait - seconds).count()) };
+    if (error == ENOBUFS) {
+        nanosleep(&poll_timeout, nullptr);
+    } else {
+        pollfd poll_fd{ fd, POLLOUT, 0 };
+        ppoll(&poll_fd, 1, &poll_timeout, nullptr);
+    }
+    return true;
+}
+
+bool CanSocket::waitReadable(const std::chrono::nanoseconds& timeout) noexcept {
+    pollfd poll_fd{ fd, POLLIN, 0 };
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    const timespec poll_timeout{ static_cast<time_t>(seconds.count()), static_cast<long>((timeout - seconds).count()) };
+
+    const int ready = ppoll(&poll_fd, 1, &poll_timeout, nullptr);
+    if (ready < 0) {
+        if (errno != EINTR) { last_error = errno; }
+        return false;
+    }
+    return ready > 0 && (poll_fd.revents & POLLIN);
+}
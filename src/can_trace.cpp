@@ -0,0 +1,438 @@
+#include "can_trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include <boost/log/trivial.hpp>
+
+namespace {
+    // Flag bits packed alongside the identifier, matching the kernel's `can_id` layout
+    constexpr uint32_t EXTENDED_FLAG = 0x80000000U;
+    constexpr uint32_t REMOTE_FLAG = 0x40000000U;
+    constexpr uint32_t ERROR_FLAG = 0x20000000U;
+    constexpr uint32_t EXTENDED_ID_MASK = 0x1FFFFFFFU;
+    constexpr uint32_t STANDARD_ID_MASK = 0x7FFU;
+
+    // pcapng block types and option codes
+    constexpr uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+    constexpr uint32_t INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+    constexpr uint32_t ENHANCED_PACKET_BLOCK = 0x00000006;
+    constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+    constexpr uint16_t OPT_END = 0;
+    constexpr uint16_t IF_TSRESOL = 9;
+    constexpr uint16_t EPB_FLAGS = 2;
+    constexpr uint32_t EPB_DIRECTION_MASK = 3;
+    constexpr uint32_t EPB_FLAG_OUTBOUND = 2;
+
+    /** Link type whose packets are a 16-byte `struct can_frame`, with the identifier in network byte order. */
+    constexpr uint16_t LINKTYPE_CAN_SOCKETCAN = 227;
+    constexpr size_t SOCKETCAN_HEADER_SIZE = 8;
+
+    /** Flag in a SocketCAN frame's flags byte marking a CAN FD frame. */
+    constexpr uint8_t CANFD_FDF = 0x04;
+
+    constexpr int64_t NANOSECONDS_PER_SECOND = 1000000000;
+
+    /**
+     * A frame and its absolute timestamp in the trace, in nanoseconds since the Unix epoch.
+     */
+    struct TracedFrame {
+        CanFrame frame;
+        int64_t time;
+    };
+
+    /**
+     * Reads an integer stored in a pcapng section's byte order.
+     */
+    template <typename T>
+    T readSection(const uint8_t* bytes, const bool swap) {
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        if (!swap) { return value; }
+        if constexpr (sizeof(T) == 2) { return static_cast<T>(__builtin_bswap16(value)); }
+        if constexpr (sizeof(T) == 4) { return static_cast<T>(__builtin_bswap32(value)); }
+        return static_cast<T>(__builtin_bswap64(value));
+    }
+
+    uint32_t readBigEndian32(const uint8_t* bytes) {
+        return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16
+               | static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+    }
+
+    /**
+     * Unpacks a kernel-style `can_id`, with its flag bits, into `frame`.
+     */
+    void unpackCanId(const uint32_t can_id, CanFrame& frame) {
+        frame.extended = (can_id & EXTENDED_FLAG) != 0;
+        frame.remote = (can_id & REMOTE_FLAG) != 0;
+        frame.error = (can_id & ERROR_FLAG) != 0;
+        frame.id = can_id & (frame.extended || frame.error ? EXTENDED_ID_MASK : STANDARD_ID_MASK);
+    }
+
+    /** Latest timestamp which fits in nanoseconds since the Unix epoch. */
+    constexpr uint64_t MAX_TIMESTAMP_SECONDS = std::numeric_limits<int64_t>::max() / NANOSECONDS_PER_SECOND;
+
+    /**
+     * Decodes an `if_tsresol` option: a power of ten, or of two if the top bit is set, of timestamp units per second.
+     *
+     * @return the units per second, or 0 if they don't fit in 64 bits
+     */
+    uint64_t unitsPerSecond(const uint8_t resolution) {
+        const bool binary = (resolution & 0x80) != 0;
+        const uint8_t exponent = resolution & 0x7F;
+        if (exponent > (binary ? 63 : 19)) { return 0; }
+        uint64_t units = 1;
+        for (uint8_t i = 0; i < exponent; ++i) { units *= binary ? 2 : 10; }
+        return units;
+    }
+
+    /**
+     * Converts the part of a timestamp below one second, `remainder` out of `per_second` units, to nanoseconds.
+     */
+    int64_t fractionToNanoseconds(const uint64_t remainder, const uint64_t per_second) {
+        // remainder * 10^9 only fits in 64 bits for resolutions up to about 18 GHz, and finer decimal resolutions divide
+        // down to nanoseconds exactly
+        if (per_second <= std::numeric_limits<uint64_t>::max() / NANOSECONDS_PER_SECOND) {
+            return static_cast<int64_t>(remainder * NANOSECONDS_PER_SECOND / per_second);
+        }
+        if (per_second % NANOSECONDS_PER_SECOND == 0) {
+            return static_cast<int64_t>(remainder / (per_second / NANOSECONDS_PER_SECOND));
+        }
+        return static_cast<int64_t>(
+                static_cast<long double>(remainder) * NANOSECONDS_PER_SECOND / static_cast<long double>(per_second)
+        );
+    }
+
+    /**
+     * Calls `visit(code, value, length)` for each option in a pcapng block's option list.
+     */
+    template <typename Visitor>
+    void visitOptions(const uint8_t* options, const size_t size, const bool swap, Visitor&& visit) {
+        size_t offset = 0;
+        while (offset + 4 <= size) {
+            const auto code = readSection<uint16_t>(options + offset, swap);
+            const auto length = readSection<uint16_t>(options + offset + 2, swap);
+            offset += 4;
+            if (code == OPT_END || offset + length > size) { return; }
+            visit(code, options + offset, length);
+            offset += (length + 3u) & ~size_t{ 3 };
+        }
+    }
+
+    void readPcapng(const std::vector<uint8_t>& bytes, std::vector<TracedFrame>& frames) {
+        struct Interface {
+            uint16_t link_type;
+            uint64_t units_per_second;
+        };
+        std::vector<Interface> interfaces;
+        bool swap = false;
+        size_t skipped = 0;
+
+        size_t offset = 0;
+        while (offset + 12 <= bytes.size()) {
+            const uint8_t* block = bytes.data() + offset;
+            const auto type = readSection<uint32_t>(block, false);
+            if (type == SECTION_HEADER_BLOCK) {
+                // Every section declares its own byte order, and its own interfaces
+                const auto magic = readSection<uint32_t>(block + 8, false);
+                if (magic != BYTE_ORDER_MAGIC && magic != __builtin_bswap32(BYTE_ORDER_MAGIC)) {
+                    throw std::runtime_error("readCanTrace: Bad pcapng byte-order magic");
+                }
+                swap = magic != BYTE_ORDER_MAGIC;
+                interfaces.clear();
+            }
+
+            const auto length = readSection<uint32_t>(block + 4, swap);
+            if (length < 12 || length % 4 != 0 || offset + length > bytes.size()) {
+                // Most likely a capture cut short while being written; keep what came before
+                BOOST_LOG_TRIVIAL(warning) << "readCanTrace: pcapng capture truncated at byte " << offset;
+                break;
+            }
+            const uint8_t* body = block + 8;
+            const size_t body_size = length - 12;
+
+            if (type == INTERFACE_DESCRIPTION_BLOCK && body_size >= 8) {
+                Interface interface{ readSection<uint16_t>(body, swap), 1000000 };
+                visitOptions(
+                        body + 8, body_size - 8, swap,
+                        [&](const uint16_t code, const uint8_t* value, const uint16_t value_length) {
+                            if (code != IF_TSRESOL) { return; }
+                            interface.units_per_second = value_length >= 1 ? unitsPerSecond(value[0]) : 0;
+                        }
+                );
+                if (interface.units_per_second == 0) {
+                    BOOST_LOG_TRIVIAL(warning) << "readCanTrace: Ignoring packets from pcapng interface "
+                                               << interfaces.size() << ", its timestamp resolution is invalid";
+                }
+                interfaces.push_back(interface);
+            } else if (type == ENHANCED_PACKET_BLOCK && body_size >= 20) {
+                const auto interface_id = readSection<uint32_t>(body, swap);
+                const uint64_t units = static_cast<uint64_t>(readSection<uint32_t>(body + 4, swap)) << 32
+                                       | readSection<uint32_t>(body + 8, swap);
+                const auto captured = readSection<uint32_t>(body + 12, swap);
+                const uint8_t* packet = body + 20;
+                const size_t padded = (captured + 3u) & ~size_t{ 3 };
+
+                if (interface_id >= interfaces.size() || interfaces[interface_id].link_type != LINKTYPE_CAN_SOCKETCAN
+                    || interfaces[interface_id].units_per_second == 0 || 20 + padded > body_size
+                    || captured < SOCKETCAN_HEADER_SIZE
+                    || units / interfaces[interface_id].units_per_second > MAX_TIMESTAMP_SECONDS) {
+                    ++skipped;
+                } else {
+                    TracedFrame traced{};
+                    unpackCanId(readBigEndian32(packet), traced.frame);
+                    traced.frame.length = packet[4];
+                    if ((packet[5] & CANFD_FDF) || traced.frame.length > CanFrame::MAX_LENGTH
+                        || captured < SOCKETCAN_HEADER_SIZE + traced.frame.length) {
+                        ++skipped;
+                    } else {
+                        std::memcpy(traced.frame.data.data(), packet + SOCKETCAN_HEADER_SIZE, traced.frame.length);
+                        visitOptions(
+                                body + 20 + padded, body_size - 20 - padded, swap,
+                                [&](const uint16_t code, const uint8_t* value, const uint16_t value_length) {
+                                    if (code != EPB_FLAGS || value_length < 4) { return; }
+                                    const auto flags = readSection<uint32_t>(value, swap);
+                                    traced.frame.local = (flags & EPB_DIRECTION_MASK) == EPB_FLAG_OUTBOUND;
+                                }
+                        );
+                        const uint64_t per_second = interfaces[interface_id].units_per_second;
+                        traced.time = static_cast<int64_t>(units / per_second) * NANOSECONDS_PER_SECOND
+                                      + fractionToNanoseconds(units % per_second, per_second);
+                        frames.push_back(traced);
+                    }
+                }
+            }
+            offset += length;
+        }
+
+        if (skipped > 0) {
+            BOOST_LOG_TRIVIAL(warning) << "readCanTrace: Skipped " << skipped
+                                       << " pcapng packets which weren't classic CAN frames";
+        }
+    }
+
+    int hexDigit(const char character) {
+        if (character >= '0' && character <= '9') { return character - '0'; }
+        if (character >= 'a' && character <= 'f') { return character - 'a' + 10; }
+        if (character >= 'A' && character <= 'F') { return character - 'A' + 10; }
+        return -1;
+    }
+
+    /**
+     * Parses one candump log line, `(seconds.fraction) interface id#data [T|R]`.
+     *
+     * @return `false` if the line isn't a classic CAN frame
+     */
+    bool parseCandumpLine(const std::string& line, TracedFrame& traced) {
+        const char* cursor = line.c_str();
+        while (*cursor == ' ' || *cursor == '\t') { ++cursor; }
+        if (*cursor++ != '(') { return false; }
+
+        int64_t seconds = 0;
+        while (*cursor >= '0' && *cursor <= '9') { seconds = seconds * 10 + (*cursor++ - '0'); }
+        int64_t fraction = 0;
+        int64_t scale = NANOSECONDS_PER_SECOND;
+        if (*cursor == '.') {
+            ++cursor;
+            while (*cursor >= '0' && *cursor <= '9') {
+                // Digits past nanoseconds are dropped
+                if (scale > 1) {
+                    fraction = fraction * 10 + (*cursor - '0');
+                    scale /= 10;
+                }
+                ++cursor;
+            }
+        }
+        if (*cursor++ != ')') { return false; }
+        traced.time = seconds * NANOSECONDS_PER_SECOND + fraction * scale;
+
+        // Interface name, which is ignored
+        while (*cursor == ' ') { ++cursor; }
+        while (*cursor != ' ' && *cursor != '\0') { ++cursor; }
+        while (*cursor == ' ') { ++cursor; }
+
+        // Standard identifiers are written with 3 digits, extended and error frames with 8 and their flags
+        uint32_t can_id = 0;
+        int digits = 0;
+        for (int digit; (digit = hexDigit(*cursor)) >= 0; ++cursor, ++digits) { can_id = can_id << 4 | digit; }
+        if (*cursor++ != '#' || (digits != 3 && digits != 8)) { return false; }
+        if (digits == 8 && !(can_id & ERROR_FLAG)) { can_id |= EXTENDED_FLAG; }
+        traced.frame = CanFrame{};
+        unpackCanId(can_id, traced.frame);
+
+        if (*cursor == '#') { return false; } // CAN FD
+        if (*cursor == 'R') {
+            traced.frame.remote = true;
+            ++cursor;
+            const int length = hexDigit(*cursor);
+            if (length >= 0) {
+                traced.frame.length = static_cast<uint8_t>(std::min<int>(length, CanFrame::MAX_LENGTH));
+                ++cursor;
+            }
+        } else {
+            while (true) {
+                if (*cursor == '.') {
+                    ++cursor;
+                    continue;
+                }
+                const int high = hexDigit(*cursor);
+                if (high < 0) { break; }
+                const int low = hexDigit(cursor[1]);
+                if (low < 0 || traced.frame.length == CanFrame::MAX_LENGTH) { return false; }
+                traced.frame.data[traced.frame.length++] = static_cast<uint8_t>(high << 4 | low);
+                cursor += 2;
+            }
+            // An optional raw DLC for frames with more than 8 bytes signalled
+            if (*cursor == '_') { cursor += 2; }
+        }
+
+        // Newer candump versions append the direction
+        while (*cursor == ' ') { ++cursor; }
+        traced.frame.local = *cursor == 'T';
+        return *cursor == '\0' || *cursor == 'T' || *cursor == 'R' || *cursor == '\r';
+    }
+
+    void readCandump(std::ifstream& file, std::vector<TracedFrame>& frames) {
+        std::string line;
+        size_t skipped = 0;
+        TracedFrame traced{};
+        while (std::getline(file, line)) {
+            if (line.empty()) { continue; }
+            if (parseCandumpLine(line, traced)) {
+                frames.push_back(traced);
+            } else {
+                ++skipped;
+            }
+        }
+        if (skipped > 0) {
+            BOOST_LOG_TRIVIAL(warning) << "readCanTrace: Skipped " << skipped
+                                       << " candump lines which weren't classic CAN frames";
+        }
+    }
+} // namespace
+
+std::vector<CanFrame> readCanTrace(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) { throw std::runtime_error("readCanTrace: Can't open " + path); }
+
+    std::vector<TracedFrame> traced;
+    char magic[4]{};
+    file.read(magic, sizeof(magic));
+    uint32_t block_type = 0;
+    std::memcpy(&block_type, magic, sizeof(block_type));
+    if (file.gcount() == sizeof(magic) && block_type == SECTION_HEADER_BLOCK) {
+        const std::vector<uint8_t> bytes(
+                (std::istreambuf_iterator<char>(file.seekg(0))), std::istreambuf_iterator<char>()
+        );
+        readPcapng(bytes, traced);
+    } else {
+        file.clear();
+        file.seekg(0);
+        // candump logs start straight away with a timestamped line
+        char first = 0;
+        while (file.get(first) && (first == ' ' || first == '\n' || first == '\r' || first == '\t')) {}
+        if (first != '(') { throw std::runtime_error("readCanTrace: " + path + " isn't a candump log or pcapng capture"); }
+        file.seekg(0);
+        readCandump(file, traced);
+    }
+
+    std::vector<CanFrame> frames;
+    frames.reserve(traced.size());
+    const int64_t first_time = traced.empty() ? 0 : traced.front().time;
+    for (TracedFrame& entry : traced) {
+        entry.frame.timestamp = std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::nanoseconds(entry.time - first_time)
+                )
+        );
+        frames.push_back(entry.frame);
+    }
+    return frames;
+}
+
+CanReplay::CanReplay(const std::string& trace_path)
+    : frames{ readCanTrace(trace_path) }, start{ std::chrono::steady_clock::now() }, next_frame{ 0 }, accepted{},
+      accept_all{ true }, exhausted{ false }, sent_frames{ 0 } {}
+
+bool CanReplay::receive(CanFrame& frame, const std::chrono::nanoseconds& timeout) noexcept {
+    return receiveBatch(&frame, 1, timeout) == 1;
+}
+
+size_t CanReplay::receiveBatch(CanFrame* frames, const size_t max_frames, const std::chrono::nanoseconds& timeout) noexcept {
+    if (max_frames == 0) { return 0; }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        std::chrono::steady_clock::time_point due;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (next_frame < this->frames.size() && !accepts(this->frames[next_frame])) { ++next_frame; }
+            if (next_frame == this->frames.size()) {
+                exhausted.store(true, std::memory_order_relaxed);
+                break;
+            }
+
+            // Frame timestamps are offsets from the start of the trace
+            const auto now = std::chrono::steady_clock::now();
+            size_t count = 0;
+            while (count < max_frames && next_frame < this->frames.size()) {
+                const CanFrame& frame = this->frames[next_frame];
+                due = start + frame.timestamp.time_since_epoch();
+                if (due > now) { break; }
+                ++next_frame;
+                if (!accepts(frame)) { continue; }
+                frames[count] = frame;
+                frames[count].timestamp = due;
+                ++count;
+            }
+            if (count > 0) { return count; }
+        }
+
+        if (due > deadline) { break; }
+        std::this_thread::sleep_until(due);
+    }
+
+    // Nothing is due within the timeout, so idle like a quiet bus would
+    std::this_thread::sleep_until(deadline);
+    return 0;
+}
+
+bool CanReplay::send(const CanFrame& frame, const std::chrono::nanoseconds& timeout) noexcept {
+    return sendBatch(&frame, 1, timeout) == 1;
+}
+
+size_t CanReplay::sendBatch(const CanFrame*, const size_t count, const std::chrono::nanoseconds&) noexcept {
+    sent_frames.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+bool CanReplay::enableTimestamps(const CanTimestampMode) noexcept { return true; }
+
+bool CanReplay::acceptStandardIds(const std::vector<uint16_t>& ids) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    accepted.fill(false);
+    for (const uint16_t id : ids) { accepted[id & STANDARD_ID_MASK] = true; }
+    accept_all = false;
+    return true;
+}
+
+bool CanReplay::acceptAll() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    accept_all = true;
+    return true;
+}
+
+int CanReplay::lastError() const noexcept { return 0; }
+
+bool CanReplay::finished() const noexcept { return exhausted.load(std::memory_order_relaxed); }
+
+uint64_t CanReplay::sent() const noexcept { return sent_frames.load(std::memory_order_relaxed); }
+
+bool CanReplay::accepts(const CanFrame& frame) const noexcept {
+    // Same match as CanSocket's filters: standard data frames with a listed identifier
+    return accept_all || (!frame.extended && !frame.remote && !frame.error && accepted[frame.id & STANDARD_ID_MASK]);
+}
@@ -0,0 +1,220 @@
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <arpa/inet.h>
+
+#include "can_socket.hpp"
+
+namespace {
+    // Flag bits packed alongside the identifier, matching the kernel's `can_id` layout
+    constexpr uint32_t EXTENDED_FLAG = 0x80000000U;
+    constexpr uint32_t REMOTE_FLAG = 0x40000000U;
+    constexpr uint32_t ERROR_FLAG = 0x20000000U;
+    constexpr uint32_t ID_MASK = 0x1FFFFFFFU;
+
+    // pcapng block types and option codes
+    constexpr uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+    constexpr uint32_t INTERFACE_DESCRIPTION_BLOCK = 0x00000001;
+    constexpr uint32_t ENHANCED_PACKET_BLOCK = 0x00000006;
+    constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+    constexpr uint16_t OPT_END = 0;
+    constexpr uint16_t IF_TSRESOL = 9;
+    constexpr uint16_t EPB_FLAGS = 2;
+    constexpr uint32_t EPB_FLAG_INBOUND = 1;
+    constexpr uint32_t EPB_FLAG_OUTBOUND = 2;
+
+    /** Link type whose packets are a 16-byte `struct can_frame`, with the identifier in network byte order. */
+    constexpr uint16_t LINKTYPE_CAN_SOCKETCAN = 227;
+    constexpr uint32_t SOCKETCAN_FRAME_SIZE = 16;
+
+    size_t roundUpToPowerOfTwo(const size_t value) {
+        size_t result = 1;
+        while (result < value) { result <<= 1; }
+        return result;
+    }
+
+    /**
+     * Appends the bytes of a trivially copyable value, in host byte order as pcapng allows.
+     */
+    template <typename T>
+    void append(std::vector<uint8_t>& buffer, const T value) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void appendSectionHeader(std::vector<uint8_t>& buffer) {
+        constexpr uint32_t length = 28;
+        append(buffer, SECTION_HEADER_BLOCK);
+        append(buffer, length);
+        append(buffer, BYTE_ORDER_MAGIC);
+        append(buffer, uint16_t{ 1 }); // Major version
+        append(buffer, uint16_t{ 0 }); // Minor version
+        append(buffer, int64_t{ -1 }); // Section length unknown
+        append(buffer, length);
+    }
+
+    void appendInterfaceDescription(std::vector<uint8_t>& buffer) {
+        // Header and snapshot length, if_tsresol padded to 4 bytes, opt_endofopt, trailing length
+        constexpr uint32_t length = 16 + 8 + 4 + 4;
+        append(buffer, INTERFACE_DESCRIPTION_BLOCK);
+        append(buffer, length);
+        append(buffer, LINKTYPE_CAN_SOCKETCAN);
+        append(buffer, uint16_t{ 0 }); // Reserved
+        append(buffer, SOCKETCAN_FRAME_SIZE);
+        // Timestamps are in nanoseconds rather than the default microseconds
+        append(buffer, IF_TSRESOL);
+        append(buffer, uint16_t{ 1 });
+        append(buffer, uint8_t{ 9 }); // 10^-9
+        append(buffer, uint8_t{ 0 }); // Padding to 32 bits
+        append(buffer, uint16_t{ 0 });
+        append(buffer, OPT_END);
+        append(buffer, uint16_t{ 0 });
+        append(buffer, length);
+    }
+
+    void appendPacket(std::vector<uint8_t>& buffer, const FlightRecord& record, const uint64_t epoch_ns) {
+        // Header, 16 byte frame, epb_flags option, opt_endofopt, trailing length
+        constexpr uint32_t length = 28 + SOCKETCAN_FRAME_SIZE + 8 + 4 + 4;
+        append(buffer, ENHANCED_PACKET_BLOCK);
+        append(buffer, length);
+        append(buffer, uint32_t{ 0 }); // Interface ID
+        append(buffer, static_cast<uint32_t>(epoch_ns >> 32));
+        append(buffer, static_cast<uint32_t>(epoch_ns));
+        append(buffer, SOCKETCAN_FRAME_SIZE);
+        append(buffer, SOCKETCAN_FRAME_SIZE);
+
+        uint32_t can_id = record.id;
+        if (record.extended) { can_id |= EXTENDED_FLAG; }
+        if (record.remote) { can_id |= REMOTE_FLAG; }
+        if (record.error) { can_id |= ERROR_FLAG; }
+        append(buffer, htonl(can_id));
+        append(buffer, record.length);
+        append(buffer, uint8_t{ 0 }); // Flags, only used by CAN FD
+        append(buffer, uint16_t{ 0 }); // Reserved
+        buffer.insert(buffer.end(), record.data.begin(), record.data.end());
+
+        append(buffer, EPB_FLAGS);
+        append(buffer, uint16_t{ 4 });
+        append(buffer, record.direction == FrameDirection::RECEIVED ? EPB_FLAG_INBOUND : EPB_FLAG_OUTBOUND);
+        append(buffer, OPT_END);
+        append(buffer, uint16_t{ 0 });
+        append(buffer, length);
+    }
+} // namespace
+
+FlightRecorder::FlightRecorder(const size_t capacity)
+    : mask{ roundUpToPowerOfTwo(std::max<size_t>(capacity, 1)) - 1 }, slots{ std::make_unique<Slot[]>(mask + 1) },
+      enabled{ false }, next_ticket{ 0 } {}
+
+void FlightRecorder::enable() noexcept { enabled.store(true, std::memory_order_relaxed); }
+
+void FlightRecorder::disable() noexcept { enabled.store(false, std::memory_order_relaxed); }
+
+bool FlightRecorder::isEnabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+void FlightRecorder::record(const FrameDirection direction, const CanFrame& frame) noexcept {
+    if (!isEnabled()) { return; }
+
+    uint32_t id = frame.id & ID_MASK;
+    if (frame.extended) { id |= EXTENDED_FLAG; }
+    if (frame.remote) { id |= REMOTE_FLAG; }
+    if (frame.error) { id |= ERROR_FLAG; }
+
+    const uint64_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[ticket & mask];
+    const uint8_t length = std::min(frame.length, CanFrame::MAX_LENGTH);
+    uint64_t data = 0;
+    std::memcpy(&data, frame.data.data(), length);
+
+    // Same protocol as Seqlock, except that the sequence also identifies which ticket the contents belong to
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestamp.store(static_cast<uint64_t>(frame.timestamp.time_since_epoch().count()), std::memory_order_relaxed);
+    slot.header.store(
+            id | static_cast<uint64_t>(length) << 32 | static_cast<uint64_t>(direction) << 40,
+            std::memory_order_relaxed
+    );
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+void FlightRecorder::record(
+        const FrameDirection direction, const uint32_t id, const bool extended, const uint8_t* data, const size_t length,
+        const std::chrono::steady_clock::time_point timestamp
+) noexcept {
+    if (!isEnabled()) { return; }
+
+    CanFrame frame;
+    frame.id = id;
+    frame.extended = extended;
+    frame.length = static_cast<uint8_t>(std::min<size_t>(length, CanFrame::MAX_LENGTH));
+    std::memcpy(frame.data.data(), data, frame.length);
+    frame.timestamp = timestamp;
+    record(direction, frame);
+}
+
+void FlightRecorder::snapshot(std::vector<FlightRecord>& records) const {
+    records.clear();
+
+    const uint64_t end = next_ticket.load(std::memory_order_acquire);
+    const uint64_t begin = end > capacity() ? end - capacity() : 0;
+    records.reserve(end - begin);
+
+    for (uint64_t ticket = begin; ticket < end; ++ticket) {
+        const Slot& slot = slots[ticket & mask];
+        const uint64_t expected = 2 * ticket + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) { continue; }
+        const uint64_t timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        const uint64_t header = slot.header.load(std::memory_order_relaxed);
+        const uint64_t data = slot.data.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Still being written, or already overwritten by a newer frame
+        if (slot.sequence.load(std::memory_order_relaxed) != expected) { continue; }
+
+        FlightRecord record;
+        record.timestamp = std::chrono::steady_clock::time_point(
+                std::chrono::steady_clock::duration(static_cast<std::chrono::steady_clock::rep>(timestamp))
+        );
+        const auto id = static_cast<uint32_t>(header);
+        record.id = id & ID_MASK;
+        record.extended = (id & EXTENDED_FLAG) != 0;
+        record.remote = (id & REMOTE_FLAG) != 0;
+        record.error = (id & ERROR_FLAG) != 0;
+        record.length = static_cast<uint8_t>(header >> 32);
+        record.direction = static_cast<FrameDirection>(header >> 40);
+        std::memcpy(record.data.data(), &data, sizeof(data));
+        records.push_back(record);
+    }
+}
+
+bool FlightRecorder::dumpPcapng(const std::string& path) const {
+    std::vector<FlightRecord> records;
+    snapshot(records);
+
+    // pcapng timestamps are relative to the Unix epoch, so shift the monotonic timestamps onto the wall clock
+    const auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch() - std::chrono::steady_clock::now().time_since_epoch()
+    );
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve(28 + 36 + records.size() * 60);
+    appendSectionHeader(buffer);
+    appendInterfaceDescription(buffer);
+    for (const FlightRecord& record : records) {
+        const auto epoch_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(record.timestamp.time_since_epoch())
+                              + offset;
+        appendPacket(buffer, record, static_cast<uint64_t>(epoch_ns.count()));
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) { return false; }
+    file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(file);
+}
+
+size_t FlightRecorder::capacity() const noexcept { return mask + 1; }
+
+uint64_t FlightRecorder::recorded() const noexcept { return next_ticket.load(std::memory_order_relaxed); }
@@ -0,0 +1,604 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/program_options.hpp>
+#include <boost/signals2.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <ros2_socketcan/socket_can_receiver.hpp>
+#include <ros2_socketcan/socket_can_sender.hpp>
+
+#include "callback_registry.hpp"
+#include "can_loopback.hpp"
+#include "can_socket.hpp"
+#include "MKS_COMMANDS.hpp"
+#include "mks_encoder.hpp"
+#include "mks_stepper_controller.hpp"
+#include "motor_index.hpp"
+#include "utils.hpp"
+
+// Counts every heap allocation made by the process, see benchmarkDecodeAllocations
+std::atomic<uint64_t> allocation_count{ 0 };
+
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+constexpr char CAN_INTERFACE[] = "vcan0";
+constexpr double DEFAULT_DURATION = 5.0; // s
+
+// Same timeout mks_test_script polls with
+constexpr std::chrono::nanoseconds POLL_TIMEOUT{ 10 };
+
+struct BenchmarkOptions {
+    std::string interface;
+    std::vector<uint16_t> motor_ids;
+    std::chrono::duration<double> duration;
+};
+
+/**
+ * Wall-clock and CPU-time measurements of a polling loop.
+ */
+struct LoopResult {
+    uint64_t iterations = 0;
+    uint64_t frames = 0;
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+};
+
+/**
+ * Calls `poll` repeatedly for the configured duration.
+ * `poll` returns the number of frames it consumed during the iteration.
+ */
+LoopResult runPollingLoop(const BenchmarkOptions& options, const std::function<uint64_t()>& poll) {
+    LoopResult result;
+    const std::clock_t cpu_start = std::clock();
+    const auto wall_start = std::chrono::steady_clock::now();
+    const auto wall_end = wall_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(options.duration);
+
+    auto now = wall_start;
+    while (now < wall_end) {
+        // Only check the clock every so often so that the measurement doesn't dominate the loop
+        for (int i = 0; i < 256; ++i) {
+            result.frames += poll();
+            ++result.iterations;
+        }
+        now = std::chrono::steady_clock::now();
+    }
+
+    result.cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    result.wall_seconds = std::chrono::duration<double>(now - wall_start).count();
+    return result;
+}
+
+void printLoopResult(const std::string& name, const LoopResult& result, const std::string& frame_unit = "frames") {
+    const auto iterations = static_cast<double>(result.iterations);
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << iterations / result.wall_seconds << " iter/s" << std::setw(10)
+              << result.cpu_seconds * 1e9 / iterations << " ns CPU/iter" << std::setw(8)
+              << 100.0 * result.cpu_seconds / result.wall_seconds << " % CPU" << std::setw(12)
+              << static_cast<double>(result.frames) / result.wall_seconds << " " << frame_unit << "/s" << std::endl;
+}
+
+/**
+ * Compares the cost of polling an idle (or lightly loaded) bus through the exception-based ros2_socketcan receiver
+ * against the non-throwing @ref CanSocket path used by @ref BasicMksStepperController::update and the batched path
+ * used by @ref BasicMksStepperController::drain.
+ *
+ * Run with no traffic to measure the idle-loop cost, or alongside e.g. `cangen vcan0 -g 0` to measure throughput.
+ */
+bool benchmarkIdleReceive(const BenchmarkOptions& options) {
+    {
+        drivers::socketcan::SocketCanReceiver receiver(options.interface);
+        uint8_t buffer[8];
+        printLoopResult("SocketCanReceiver (throwing)", runPollingLoop(options, [&]() -> uint64_t {
+                            try {
+                                receiver.receive(&buffer, POLL_TIMEOUT);
+                                return 1;
+                            } catch (drivers::socketcan::SocketCanTimeout& _) { return 0; }
+                        }));
+    }
+
+    {
+        CanSocket socket(options.interface);
+        CanFrame frame;
+        printLoopResult("CanSocket::receive", runPollingLoop(options, [&]() -> uint64_t {
+                            return socket.receive(frame, POLL_TIMEOUT) ? 1 : 0;
+                        }));
+    }
+
+    {
+        MksStepperController controller(
+                options.interface,
+                std::make_shared<std::unordered_set<uint16_t>>(options.motor_ids.cbegin(), options.motor_ids.cend())
+        );
+        uint64_t events = 0;
+        controller.ESetSpeed.connect([&events](auto, auto) { ++events; });
+        controller.ESendStep.connect([&events](auto, auto) { ++events; });
+        controller.ESeekPosition.connect([&events](auto, auto) { ++events; });
+        controller.EGetPosition.connect([&events](auto, auto) { ++events; });
+
+        uint64_t last_events = 0;
+        printLoopResult(
+                "MksStepperController::update", runPollingLoop(options, [&]() -> uint64_t {
+                    controller.update(POLL_TIMEOUT);
+                    const uint64_t handled = events - last_events;
+                    last_events = events;
+                    return handled;
+                }),
+                "events"
+        );
+
+        last_events = 0;
+        printLoopResult(
+                "MksStepperController::drain", runPollingLoop(options, [&]() -> uint64_t {
+                    controller.drain(MksStepperController::DEFAULT_DRAIN_LIMIT, POLL_TIMEOUT);
+                    const uint64_t handled = events - last_events;
+                    last_events = events;
+                    return handled;
+                }),
+                "events"
+        );
+    }
+    return true;
+}
+
+/**
+ * Replays a burst of MKS responses onto the bus and counts the heap allocations made while
+ * @ref BasicMksStepperController::update decodes them. The steady-state receive path is expected to make none.
+ *
+ * Logging is disabled during the measurement since Boost.Log record construction is outside the decode path.
+ *
+ * @return `false` if the decode allocated, or didn't decode the whole burst, so that regressions fail the run
+ */
+bool benchmarkDecodeAllocations(const BenchmarkOptions& options) {
+    constexpr size_t BURST_SIZE = 128;
+    constexpr auto DRAIN_TIMEOUT = std::chrono::milliseconds(100);
+
+    MksStepperController controller(
+            options.interface,
+            std::make_shared<std::unordered_set<uint16_t>>(options.motor_ids.cbegin(), options.motor_ids.cend())
+    );
+    uint64_t events = 0;
+    controller.ESetSpeed.connect([&events](auto, auto) { ++events; });
+    controller.ESendStep.connect([&events](auto, auto) { ++events; });
+    controller.ESeekPosition.connect([&events](auto, auto) { ++events; });
+    controller.EGetPosition.connect([&events](auto, auto) { ++events; });
+
+    drivers::socketcan::SocketCanSender sender(options.interface);
+
+    // Cycle through each response type for each motor, as if several motors were answering a coordinated move
+    const auto send_burst = [&]() {
+        for (size_t i = 0; i < BURST_SIZE; ++i) {
+            const uint16_t motor = options.motor_ids[i % options.motor_ids.size()];
+            std::vector<uint8_t> payload;
+            switch (i / options.motor_ids.size() % 4) {
+                case 0: payload = { MksCommands::SET_SPEED, 1 }; break;
+                case 1: payload = { MksCommands::SEND_STEP, MksMoveResponse::MOVING }; break;
+                case 2: payload = { MksCommands::SEEK_POS_BY_STEPS, MksMoveResponse::COMPLETED }; break;
+                default:
+                    payload = { MksCommands::CURRENT_POS };
+                    const auto position = pack_32_big(static_cast<uint32_t>(i * 100));
+                    payload.insert(payload.end(), position.cbegin(), position.cend());
+                    break;
+            }
+            payload.push_back(0); // Checksum isn't validated on receive
+            sender.send(
+                    payload.data(), payload.size(),
+                    drivers::socketcan::CanId(
+                            motor, 0, drivers::socketcan::FrameType::DATA, drivers::socketcan::StandardFrame
+                    )
+            );
+        }
+    };
+
+    // Decode until the whole burst has been signalled, or the bus goes quiet
+    const auto receive_burst = [&]() {
+        const uint64_t target = events + BURST_SIZE;
+        auto last_progress = std::chrono::steady_clock::now();
+        while (events < target && std::chrono::steady_clock::now() - last_progress < DRAIN_TIMEOUT) {
+            const uint64_t before = events;
+            controller.update(std::chrono::milliseconds(1));
+            if (events != before) { last_progress = std::chrono::steady_clock::now(); }
+        }
+    };
+
+    boost::log::core::get()->set_logging_enabled(false);
+
+    // Warm up so that lazily-initialised state (e.g. signal slot caches) isn't counted
+    send_burst();
+    receive_burst();
+
+    send_burst();
+    const uint64_t events_before = events;
+    const uint64_t allocations_before = allocation_count.load();
+    receive_burst();
+    const uint64_t allocations = allocation_count.load() - allocations_before;
+    const uint64_t decoded = events - events_before;
+
+    boost::log::core::get()->set_logging_enabled(true);
+
+    std::cout << "Decoded " << decoded << "/" << BURST_SIZE << " frames with " << allocations << " heap allocations ("
+              << (decoded ? static_cast<double>(allocations) / static_cast<double>(decoded) : 0.0) << " per frame)"
+              << std::endl;
+    if (decoded != BURST_SIZE) {
+        std::cout << "FAILED: not every frame in the burst was decoded" << std::endl;
+        return false;
+    }
+    if (allocations != 0) {
+        std::cout << "FAILED: the steady-state decode path allocated" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Compares the per-frame cost of checking whether an identifier belongs to one of our motors using the
+ * `std::unordered_set` given to the controller against the @ref MotorIndex lookup table, under bus mixes with
+ * varying proportions of traffic from other devices.
+ */
+bool benchmarkMotorLookup(const BenchmarkOptions& options) {
+    constexpr size_t TRACE_LENGTH = 1 << 16;
+    constexpr size_t PASSES = 256;
+
+    const std::unordered_set<uint16_t> motor_set(options.motor_ids.cbegin(), options.motor_ids.cend());
+    const MotorIndex motor_index(motor_set);
+
+    std::mt19937 rng(0x5EED);
+    std::uniform_int_distribution<uint16_t> any_id(0, MotorIndex::TABLE_SIZE - 1);
+    std::uniform_int_distribution<size_t> any_motor(0, options.motor_ids.size() - 1);
+
+    for (const double foreign_fraction : { 0.0, 0.5, 0.9 }) {
+        // Build a trace where each identifier is either one of our motors, or some other device on the bus
+        std::bernoulli_distribution is_foreign(foreign_fraction);
+        std::vector<uint32_t> trace(TRACE_LENGTH);
+        for (auto& id : trace) { id = is_foreign(rng) ? any_id(rng) : options.motor_ids[any_motor(rng)]; }
+
+        const auto time_lookup = [&](const std::string& name, const auto& contains) {
+            size_t matches = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t pass = 0; pass < PASSES; ++pass) {
+                for (const uint32_t id : trace) { matches += contains(id) ? 1 : 0; }
+            }
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+            // Printing the match count stops the compiler discarding the loop
+            std::cout << "    " << std::left << std::setw(24) << name << std::right << std::setprecision(2)
+                      << std::setw(8) << elapsed.count() / static_cast<double>(TRACE_LENGTH * PASSES) << " ns/frame ("
+                      << matches << " matches)" << std::endl;
+        };
+
+        std::cout << std::fixed << std::setprecision(0) << std::setw(3) << foreign_fraction * 100 << "% foreign:"
+                  << std::endl;
+        time_lookup("unordered_set::count", [&](const uint32_t id) {
+            return motor_set.count(static_cast<uint16_t>(id)) != 0;
+        });
+        time_lookup("MotorIndex::contains", [&](const uint32_t id) { return motor_index.contains(id); });
+    }
+    return true;
+}
+
+/**
+ * Compares the per-event cost of firing a `boost::signals2::signal`, as the controllers do for every response, against
+ * invoking a @ref CallbackRegistry with the same signature, for increasing numbers of subscribers.
+ * Does not need a CAN interface.
+ */
+bool benchmarkDispatch(const BenchmarkOptions&) {
+    constexpr size_t EVENTS = 1 << 22;
+    constexpr size_t MAX_SUBSCRIBERS = 16;
+
+    for (const size_t subscribers : { 0, 1, 2, 4, 8, 16 }) {
+        boost::signals2::signal<void(uint16_t, int32_t)> signal;
+        CallbackRegistry<void(uint16_t, int32_t), MAX_SUBSCRIBERS> registry;
+        int64_t sum = 0;
+        for (size_t i = 0; i < subscribers; ++i) {
+            signal.connect([&sum](const uint16_t motor, const int32_t position) { sum += motor + position; });
+            registry.subscribe([&sum](const uint16_t motor, const int32_t position) { sum += motor + position; });
+        }
+
+        const auto time_dispatch = [&](const std::string& name, const auto& dispatch) {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < EVENTS; ++i) { dispatch(static_cast<uint16_t>(i & 0x7FF), static_cast<int32_t>(i)); }
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+            std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(8) << elapsed.count() / static_cast<double>(EVENTS) << " ns/event" << std::endl;
+        };
+
+        std::cout << subscribers << " subscribers:" << std::endl;
+        time_dispatch("signals2::signal", [&](const uint16_t motor, const int32_t position) { signal(motor, position); });
+        time_dispatch("CallbackRegistry", [&](const uint16_t motor, const int32_t position) {
+            registry(motor, position);
+        });
+        // Printing the sum stops the compiler discarding the callbacks
+        std::cout << "    (checksum " << sum << ")" << std::endl;
+    }
+    return true;
+}
+
+/**
+ * Measures the per-command cost and heap allocations of encoding each command with @ref MksEncoder, against the
+ * `std::vector` based encoding the controller used before, which is reproduced here as the baseline.
+ * Does not need a CAN interface.
+ */
+bool benchmarkEncode(const BenchmarkOptions& options) {
+    constexpr size_t COMMANDS = 1 << 22;
+
+    const auto legacy_checksum = [](const uint16_t id, const std::vector<uint8_t>& payload) {
+        uint8_t sum = static_cast<uint8_t>(id);
+        for (const uint8_t byte : payload) { sum = static_cast<uint8_t>(sum + byte); }
+        return sum;
+    };
+    const auto legacy_speed_properties = [](std::vector<uint8_t>& payload, const int16_t speed, const uint8_t accel) {
+        payload.push_back(static_cast<uint8_t>((speed & 0xF00) >> 8 | 1u << 7));
+        payload.push_back(static_cast<uint8_t>(speed & 0xFF));
+        payload.push_back(accel);
+    };
+
+    const auto time_encode = [&](const std::string& name, const auto& encode) {
+        uint64_t sum = 0;
+        const uint64_t allocations_before = allocation_count.load();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < COMMANDS; ++i) {
+            const uint16_t motor = options.motor_ids[i % options.motor_ids.size()];
+            sum += encode(motor, static_cast<uint32_t>(i));
+        }
+        const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        const uint64_t allocations = allocation_count.load() - allocations_before;
+        // Printing the sum stops the compiler discarding the encoding
+        std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(8) << elapsed.count() / static_cast<double>(COMMANDS) << " ns/command" << std::setw(8)
+                  << static_cast<double>(allocations) / static_cast<double>(COMMANDS) << " allocations/command"
+                  << " (checksum " << sum << ")" << std::endl;
+    };
+
+    std::vector<MksEncoder> encoders(MotorIndex::TABLE_SIZE);
+    for (const uint16_t motor : options.motor_ids) { encoders[motor] = MksEncoder(motor); }
+
+    std::cout << "SET_SPEED:" << std::endl;
+    time_encode("std::vector", [&](const uint16_t motor, const uint32_t i) -> uint64_t {
+        std::vector<uint8_t> payload{ MksCommands::SET_SPEED };
+        legacy_speed_properties(payload, static_cast<int16_t>(i & 0xFFF), static_cast<uint8_t>(i));
+        payload.push_back(legacy_checksum(motor, payload));
+        return payload.back();
+    });
+    time_encode("MksEncoder", [&](const uint16_t motor, const uint32_t i) -> uint64_t {
+        const MksPayload payload = encoders[motor].setSpeed(static_cast<int16_t>(i & 0xFFF), true, static_cast<uint8_t>(i));
+        return payload.data[payload.length - 1];
+    });
+
+    std::cout << "SEND_STEP:" << std::endl;
+    time_encode("std::vector", [&](const uint16_t motor, const uint32_t i) -> uint64_t {
+        std::vector<uint8_t> payload{ MksCommands::SEND_STEP };
+        legacy_speed_properties(payload, static_cast<int16_t>(i & 0xFFF), static_cast<uint8_t>(i));
+        const auto steps = pack_24_big(i);
+        payload.insert(payload.end(), steps.cbegin(), steps.cend());
+        payload.push_back(legacy_checksum(motor, payload));
+        return payload.back();
+    });
+    time_encode("MksEncoder", [&](const uint16_t motor, const uint32_t i) -> uint64_t {
+        const MksPayload payload = encoders[motor].sendStep(
+                i, static_cast<int16_t>(i & 0xFFF), true, static_cast<uint8_t>(i)
+        );
+        return payload.data[payload.length - 1];
+    });
+
+    std::cout << "SEEK_POS_BY_STEPS:" << std::endl;
+    time_encode("std::vector", [&](const uint16_t motor, const uint32_t i) -> uint64_t {
+        std::vector<uint8_t> payload{ MksCommands::SEEK_POS_BY_STEPS };
+        const auto speed = pack_16_big(static_cast<uint16_t>(i & 0xFFF));
+        const auto position = pack_24_big(i);
+        payload.insert(payload.end(), speed.cbegin(), speed.cend());
+        payload.push_back(static_cast<uint8_t>(i));
+        payload.insert(payload.end(), position.cbegin(), position.cend());
+        payload.push_back(legacy_checksum(motor, payload));
+        return payload.back();
+    });
+    time_encode("MksEncoder", [&](const uint16_t motor, const uint32_t i) -> uint64_t {
+        const MksPayload payload = encoders[motor].seekPosition(
+                static_cast<int32_t>(i), static_cast<int16_t>(i & 0xFFF), static_cast<uint8_t>(i)
+        );
+        return payload.data[payload.length - 1];
+    });
+
+    std::cout << "CURRENT_POS:" << std::endl;
+    time_encode("std::vector", [&](const uint16_t motor, const uint32_t) -> uint64_t {
+        std::vector<uint8_t> payload{ MksCommands::CURRENT_POS };
+        payload.push_back(legacy_checksum(motor, payload));
+        return payload.back();
+    });
+    time_encode("MksEncoder", [&](const uint16_t motor, const uint32_t) -> uint64_t {
+        const MksPayload& payload = encoders[motor].getPosition();
+        return payload.data[payload.length - 1];
+    });
+    return true;
+}
+
+/**
+ * Races @ref BasicMksStepperController::emergencyStopAll against the transmit thread: one thread floods the transmit
+ * queue with motion commands, and each round the flood is halted and every motor stopped while the backlog is still
+ * being sent. Another node keeps the bus busy, so that the transmit thread and the stop contend for it as they would
+ * for a real interface. As every motion command was issued before the stop, the last frame each motor sees must be a
+ * stop. Runs on an in-memory bus, so does not need a CAN interface.
+ */
+bool benchmarkEmergencyStopRace(const BenchmarkOptions& options) {
+    constexpr auto SETTLE_TIME = std::chrono::milliseconds(5);
+    constexpr uint16_t CHATTER_ID = 0x7FF;
+    constexpr size_t CHATTER_BATCH = 8;
+    const std::string bus = "estop-race";
+
+    MksLoopbackController controller(
+            bus, std::make_shared<std::unordered_set<uint16_t>>(options.motor_ids.cbegin(), options.motor_ids.cend())
+    );
+
+    // Stands in for the drivers, recording the last command each one received
+    CanLoopback drivers(bus, true);
+    drivers.acceptStandardIds(options.motor_ids);
+    std::unique_ptr<std::atomic<uint8_t>[]> last_command = std::make_unique<std::atomic<uint8_t>[]>(MotorIndex::TABLE_SIZE);
+    for (size_t id = 0; id < MotorIndex::TABLE_SIZE; ++id) { last_command[id].store(0, std::memory_order_relaxed); }
+    std::atomic<bool> running{ true };
+    std::thread observer([&]() {
+        std::array<CanFrame, CanLoopback::MAX_BATCH> frames;
+        while (running.load(std::memory_order_relaxed)) {
+            const size_t count = drivers.receiveBatch(frames.data(), frames.size(), std::chrono::milliseconds(1));
+            for (size_t i = 0; i < count; ++i) {
+                if (frames[i].length > 0 && frames[i].id < MotorIndex::TABLE_SIZE) {
+                    last_command[frames[i].id].store(frames[i].data[0], std::memory_order_relaxed);
+                }
+            }
+        }
+    });
+
+    // Stands in for unrelated traffic
+    CanLoopback other_node(bus, true);
+    std::thread chatter([&]() {
+        std::array<CanFrame, CHATTER_BATCH> frames{};
+        for (CanFrame& frame : frames) {
+            frame.id = CHATTER_ID;
+            frame.length = 8;
+        }
+        while (running.load(std::memory_order_relaxed)) { other_node.sendBatch(frames.data(), frames.size()); }
+    });
+
+    std::atomic<bool> flooding{ false };
+    std::atomic<bool> issuing{ false };
+    std::thread issuer([&]() {
+        while (running.load(std::memory_order_relaxed)) {
+            if (!flooding.load(std::memory_order_acquire)) {
+                issuing.store(false, std::memory_order_release);
+                std::this_thread::yield();
+                continue;
+            }
+            issuing.store(true, std::memory_order_release);
+            for (const uint16_t motor : options.motor_ids) { controller.setSpeed(motor, 100); }
+        }
+    });
+
+    // The flood fills the transmit queue, and every command refused for it would be logged
+    boost::log::core::get()->set_logging_enabled(false);
+
+    std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<int> flood_time(0, 500); // µs
+    std::uniform_int_distribution<int> stop_delay(0, 125); // µs
+    uint64_t rounds = 0;
+    uint64_t violations = 0;
+    const auto end = std::chrono::steady_clock::now()
+                     + std::chrono::duration_cast<std::chrono::steady_clock::duration>(options.duration);
+    while (std::chrono::steady_clock::now() < end) {
+        flooding.store(true, std::memory_order_release);
+        while (!issuing.load(std::memory_order_acquire)) { std::this_thread::yield(); }
+        std::this_thread::sleep_for(std::chrono::microseconds(flood_time(random)));
+        flooding.store(false, std::memory_order_release);
+        // Once the issuer is idle, every motion command it will ever send for this round has been issued
+        while (issuing.load(std::memory_order_acquire)) { std::this_thread::yield(); }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(stop_delay(random)));
+        controller.emergencyStopAll();
+        while (controller.getTransmitStats().queued > 0) { std::this_thread::yield(); }
+        std::this_thread::sleep_for(SETTLE_TIME);
+
+        for (const uint16_t motor : options.motor_ids) {
+            if (last_command[motor].load(std::memory_order_relaxed) != MksCommands::EMERGENCY_STOP) { ++violations; }
+        }
+        ++rounds;
+    }
+    running.store(false, std::memory_order_relaxed);
+    issuer.join();
+    chatter.join();
+    observer.join();
+    boost::log::core::get()->set_logging_enabled(true);
+
+    const MksTransmitStats stats = controller.getTransmitStats();
+    std::cout << rounds << " rounds, " << stats.sent << " frames sent, " << stats.superseded
+              << " motion commands superseded, " << stats.restopped << " stops resent, " << violations
+              << " motors left moving" << std::endl;
+    if (violations != 0) {
+        std::cout << "FAILED: a motion command issued before emergencyStopAll reached the bus after its stop" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, const char* argv[]) {
+    // Logging would dominate the measurements, only let warnings through
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+
+    // Each benchmark returns false if a check it makes fails, e.g. decode-allocations finding an allocation
+    const std::map<std::string, std::function<bool(const BenchmarkOptions&)>> benchmarks{
+        { "idle-receive", benchmarkIdleReceive },
+        { "decode-allocations", benchmarkDecodeAllocations },
+        { "motor-lookup", benchmarkMotorLookup },
+        { "dispatch", benchmarkDispatch },
+        { "encode", benchmarkEncode },
+        { "estop-race", benchmarkEmergencyStopRace },
+    };
+
+    BenchmarkOptions options;
+    std::vector<std::string> selected;
+    try {
+        boost::program_options::options_description description;
+        description.add_options()
+            ("interface,i", boost::program_options::value<std::string>()->default_value(CAN_INTERFACE), "SocketCAN network interface")
+            ("motors,m", boost::program_options::value<std::vector<uint16_t>>()->multitoken()->composing()->default_value({ 1 }, "1"), "List of CAN IDs for motor controllers")
+            ("duration,d", boost::program_options::value<double>()->default_value(DEFAULT_DURATION), "Duration of each timed benchmark, in seconds")
+            ("benchmark,b", boost::program_options::value<std::vector<std::string>>()->multitoken()->composing(), "Benchmarks to run, defaults to all")
+            ("help,h", "Show help");
+
+        boost::program_options::variables_map vm;
+        store(parse_command_line(argc, argv, description), vm);
+
+        if (vm.count("help")) {
+            std::cout << description << std::endl << "Benchmarks:";
+            for (const auto& [name, _] : benchmarks) { std::cout << " " << name; }
+            std::cout << std::endl;
+            return 0;
+        }
+
+        notify(vm);
+
+        options.interface = vm["interface"].as<std::string>();
+        options.motor_ids = vm["motors"].as<std::vector<uint16_t>>();
+        options.duration = std::chrono::duration<double>(vm["duration"].as<double>());
+        if (vm.count("benchmark")) { selected = vm["benchmark"].as<std::vector<std::string>>(); }
+    } catch (const boost::program_options::error& e) {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
+    if (selected.empty()) {
+        for (const auto& [name, _] : benchmarks) { selected.push_back(name); }
+    }
+
+    bool failed = false;
+    for (const auto& name : selected) {
+        const auto benchmark = benchmarks.find(name);
+        if (benchmark == benchmarks.cend()) {
+            std::cout << "Unknown benchmark: " << name << std::endl;
+            return -1;
+        }
+        std::cout << "===== " << name << " =====" << std::endl;
+        if (!benchmark->second(options)) { failed = true; }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#include "mks_ramp.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace {
+    uint16_t clampSpeed(const double speed, const uint16_t max_speed) {
+        return static_cast<uint16_t>(std::clamp(speed, 1.0, static_cast<double>(std::max<uint16_t>(max_speed, 1))));
+    }
+} // namespace
+
+double mksMoveDuration(const uint32_t distance, const MksRamp& ramp) {
+    if (distance == 0) { return 0; }
+    if (ramp.speed == 0) { return std::numeric_limits<double>::infinity(); }
+
+    const double steps = distance;
+    const double rate = ramp.speed * MKS_STEPS_PER_SPEED_UNIT;
+    if (ramp.acceleration == 0) { return steps / rate; }
+
+    // Speed rises by one unit per tick, i.e. the acceleration is one speed unit per tick period
+    const double tick = std::chrono::duration<double>(mksTickPeriod(ramp.acceleration)).count();
+    const double acceleration = MKS_STEPS_PER_SPEED_UNIT / tick;
+    const double ramp_distance = rate * rate / acceleration; // Up and back down
+    if (steps >= ramp_distance) { return steps / rate + rate / acceleration; }
+    return 2 * std::sqrt(steps / acceleration);
+}
+
+MksRamp mksMatchDuration(
+        const uint32_t distance, const double duration, const uint8_t preferred_acceleration, const uint16_t max_speed
+) {
+    const uint16_t limit = std::min(max_speed, MKS_MAX_SPEED);
+    if (distance == 0 || duration <= 0) { return { clampSpeed(limit, limit), preferred_acceleration }; }
+
+    const double steps = distance;
+    if (preferred_acceleration == 0) {
+        // Without ramps the duration is inversely proportional to speed, so the nearest of the two neighbouring
+        // integer speeds is the best there is
+        const double exact = steps / (MKS_STEPS_PER_SPEED_UNIT * duration);
+        const MksRamp below{ clampSpeed(std::floor(exact), limit), 0 };
+        const MksRamp above{ clampSpeed(std::ceil(exact), limit), 0 };
+        const double below_error = std::abs(mksMoveDuration(distance, below) - duration);
+        return std::abs(mksMoveDuration(distance, above) - duration) < below_error ? above : below;
+    }
+
+    // Best candidate speed for each acceleration, found by solving the trapezoidal duration in speed units v,
+    // steps / (K v) + v tick = duration, and trying the integer speeds either side. The smaller root gives the longer
+    // cruise; without a real root, even ramping straight up and down takes too long at this acceleration, and the
+    // fastest speed comes closest
+    std::array<MksRamp, 0xFF> candidates{};
+    std::array<double, 0xFF> errors{};
+    double least_error = std::numeric_limits<double>::infinity();
+    for (int acceleration = 1; acceleration <= 0xFF; ++acceleration) {
+        const auto acceleration_byte = static_cast<uint8_t>(acceleration);
+        const double tick = std::chrono::duration<double>(mksTickPeriod(acceleration_byte)).count();
+        const double discriminant = duration * duration - 4 * tick * steps / MKS_STEPS_PER_SPEED_UNIT;
+        const double exact = discriminant >= 0 ? (duration - std::sqrt(discriminant)) / (2 * tick) : limit;
+
+        const size_t index = acceleration - 1;
+        errors[index] = std::numeric_limits<double>::infinity();
+        for (const double speed : { std::floor(exact), std::ceil(exact) }) {
+            const MksRamp candidate{ clampSpeed(speed, limit), acceleration_byte };
+            const double error = std::abs(mksMoveDuration(distance, candidate) - duration);
+            if (error < errors[index]) {
+                candidates[index] = candidate;
+                errors[index] = error;
+            }
+        }
+        least_error = std::min(least_error, errors[index]);
+    }
+
+    // The driver can't time anything finer than its fastest tick, so candidates within one tick of the best are
+    // equally good, and the one closest to the preferred acceleration wins
+    const double tolerance = std::chrono::duration<double>(mksTickPeriod(0xFF)).count();
+    MksRamp best = candidates[0];
+    int best_distance = std::numeric_limits<int>::max();
+    for (size_t index = 0; index < candidates.size(); ++index) {
+        const int from_preferred = std::abs(static_cast<int>(candidates[index].acceleration) - preferred_acceleration);
+        if (errors[index] <= least_error + tolerance && from_preferred < best_distance) {
+            best = candidates[index];
+            best_distance = from_preferred;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,445 @@
+#include "mks_simulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+
+#include "can_loopback.hpp"
+#include "mks_ramp.hpp"
+
+namespace {
+    constexpr double INFINITE_TIME = std::numeric_limits<double>::infinity();
+
+    /**
+     * Slack, in seconds, when comparing end times with the current time: one tick of the clock, so that an event is
+     * due at the time @ref MksSimulator::nextEvent rounded it to.
+     */
+    constexpr double TIME_RESOLUTION =
+            std::chrono::duration<double>(std::chrono::steady_clock::duration(1)).count();
+
+    /** Standard IDs addressing every driver at once. */
+    constexpr uint32_t BROADCAST_ID = 0;
+
+    /** Largest valid group ID, see @ref MksCommands::SET_GROUP_ID. */
+    constexpr uint16_t MAX_GROUP_ID = 0x7FF;
+
+    /**
+     * Returns the acceleration, in steps/s², of an acceleration byte, infinity for the instant changes of 0.
+     */
+    double stepAcceleration(const uint8_t acceleration) {
+        if (acceleration == 0) { return INFINITE_TIME; }
+        return MKS_STEPS_PER_SPEED_UNIT / std::chrono::duration<double>(mksTickPeriod(acceleration)).count();
+    }
+
+    /**
+     * Reads the 12-bit speed of the speed properties structure shared by SET_SPEED and SEND_STEP.
+     */
+    uint16_t unpackSpeed(const uint8_t* data) { return static_cast<uint16_t>((data[1] & 0x0F) << 8 | data[2]); }
+
+    /**
+     * Reads the direction bit of the speed properties structure; `true` is CW, i.e. positive.
+     */
+    bool unpackDirection(const uint8_t* data) { return (data[1] & 0x80) != 0; }
+
+    uint32_t unpack24(const uint8_t* data) {
+        return static_cast<uint32_t>(data[0]) << 16 | static_cast<uint32_t>(data[1]) << 8 | data[2];
+    }
+} // namespace
+
+MksSimulator::MksSimulator(
+        const std::unordered_set<uint16_t>& motor_ids, const MksSimulatorOptions& options,
+        const std::chrono::steady_clock::time_point now
+)
+    : options{ options }, epoch{ now }, motor_index{ motor_ids } {
+    motors.resize(motor_index.size());
+    for (uint16_t slot = 0; slot < motors.size(); ++slot) {
+        motors[slot].id = motor_index.motor(slot);
+        motors[slot].end = INFINITE_TIME;
+    }
+}
+
+void MksSimulator::receive(const CanFrame& frame, const std::chrono::steady_clock::time_point now) {
+    advance(now);
+    if (frame.extended || frame.remote || frame.error) { return; }
+
+    const uint16_t slot = motor_index.slot(frame.id);
+    if (slot != MotorIndex::NO_SLOT) {
+        ++stats.received;
+        if (!validChecksum(frame)) {
+            ++stats.checksum_errors;
+            return;
+        }
+        execute(motors[slot], frame, true);
+    } else {
+        // Group commands are rare, so scanning every driver is cheaper than maintaining an index of groups
+        bool addressed = false;
+        for (Motor& motor : motors) {
+            if (frame.id != BROADCAST_ID && motor.group != frame.id) { continue; }
+            if (!addressed) {
+                addressed = true;
+                ++stats.received;
+                if (!validChecksum(frame)) {
+                    ++stats.checksum_errors;
+                    return;
+                }
+            }
+            execute(motor, frame, false);
+        }
+    }
+    // Commands can finish straight away, e.g. moves of no distance and stops without deceleration
+    advance(now);
+}
+
+void MksSimulator::advance(const std::chrono::steady_clock::time_point now) {
+    this->now = std::max(this->now, seconds(now));
+    for (Motor& motor : motors) {
+        // A queue of short moves can finish several within one call
+        while (motor.end <= this->now + TIME_RESOLUTION) { finish(motor); }
+    }
+    release(now);
+}
+
+void MksSimulator::takeReplies(std::vector<CanFrame>& replies) {
+    replies.clear();
+    replies.swap(released);
+}
+
+std::chrono::steady_clock::time_point MksSimulator::nextEvent() const noexcept {
+    double next = INFINITE_TIME;
+    for (const Motor& motor : motors) { next = std::min(next, motor.end); }
+    const auto next_time = timePoint(next);
+    return pending.empty() ? next_time : std::min(next_time, pending.front().timestamp);
+}
+
+MksSimulatedMotor MksSimulator::motor(const uint16_t motor, const std::chrono::steady_clock::time_point now) const {
+    const uint16_t slot = motor_index.slot(motor);
+    if (slot == MotorIndex::NO_SLOT) {
+        throw std::out_of_range("MksSimulator: motor " + std::to_string(motor) + " isn't simulated");
+    }
+
+    const Motor& simulated = motors[slot];
+    const double time = seconds(now);
+    const auto [position, velocity] = kinematics(simulated, time);
+
+    MksSimulatedMotor snapshot;
+    snapshot.id = simulated.id;
+    snapshot.group = simulated.group;
+    snapshot.position = static_cast<int32_t>(std::lround(position));
+    snapshot.velocity = velocity;
+    snapshot.status = status(simulated, time);
+    snapshot.queued = simulated.queue.size();
+    return snapshot;
+}
+
+MksSimulatorStats MksSimulator::getStats() const noexcept { return stats; }
+
+template <typename Transport>
+void MksSimulator::serve(Transport& socket, const std::atomic<bool>& running) {
+    std::array<CanFrame, Transport::MAX_BATCH> frames;
+    std::vector<CanFrame> replies;
+    while (running.load(std::memory_order_relaxed)) {
+        // Wake for the next reply or move end, but check running regularly
+        const auto now = std::chrono::steady_clock::now();
+        const auto wake = std::min(nextEvent(), now + SERVE_INTERVAL);
+        const auto timeout = std::max<std::chrono::nanoseconds>(wake - now, std::chrono::nanoseconds::zero());
+
+        const size_t count = socket.receiveBatch(frames.data(), frames.size(), timeout);
+        // Kernel timestamps may run behind the simulation's clock, so the frames are all taken to arrive now
+        const auto received = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) { receive(frames[i], received); }
+        advance(std::chrono::steady_clock::now());
+
+        takeReplies(replies);
+        if (replies.empty()) { continue; }
+        const size_t sent = socket.sendBatch(replies.data(), replies.size(), SERVE_INTERVAL);
+        if (sent < replies.size()) {
+            BOOST_LOG_TRIVIAL(warning) << "MksSimulator: Dropped " << replies.size() - sent << " of " << replies.size()
+                                       << " replies, the interface's transmit queue is full";
+        }
+    }
+}
+
+bool MksSimulator::validChecksum(const CanFrame& frame) noexcept {
+    if (frame.length < 2) { return false; }
+    auto sum = static_cast<uint8_t>(frame.id);
+    for (size_t i = 0; i + 1 < frame.length; ++i) { sum = static_cast<uint8_t>(sum + frame.data[i]); }
+    return sum == frame.data[frame.length - 1];
+}
+
+void MksSimulator::execute(Motor& motor, const CanFrame& frame, const bool answer) {
+    const uint8_t* data = frame.data.data();
+    const auto command = data[0];
+    // Every length below includes the command byte and checksum
+    switch (command) {
+        case MksCommands::SET_SPEED: {
+            if (frame.length != 5) { break; }
+            if (motor.mode == Mode::MOVE || !motor.queue.empty()) {
+                ++stats.rejected;
+                if (answer) { reply(motor, command, { 0 }, now); }
+                return;
+            }
+            const double rate = unpackSpeed(data) * MKS_STEPS_PER_SPEED_UNIT;
+            rampTo(motor, unpackDirection(data) ? rate : -rate, data[3]);
+            motor.mode = Mode::SPEED;
+            motor.command = 0;
+            if (answer) { reply(motor, command, { 1 }, now); }
+            return;
+        }
+        case MksCommands::SEND_STEP: {
+            if (frame.length != 8) { break; }
+            const uint16_t speed = unpackSpeed(data);
+            const auto steps = static_cast<int32_t>(unpack24(data + 4));
+            if (speed == 0 && steps == 0) {
+                stop(motor, command, data[3], answer);
+            } else {
+                enqueueMove(motor, { command, unpackDirection(data) ? steps : -steps, speed, data[3], answer });
+            }
+            return;
+        }
+        case MksCommands::SEEK_POS_BY_STEPS: {
+            if (frame.length != 8) { break; }
+            const auto speed = static_cast<uint16_t>((data[1] << 8 | data[2]) & MKS_MAX_SPEED);
+            // Sign-extend the 24-bit position
+            const auto position = static_cast<int32_t>(unpack24(data + 4) << 8) >> 8;
+            if (speed == 0 && position == 0) {
+                stop(motor, command, data[3], answer);
+            } else {
+                enqueueMove(motor, { command, position, speed, data[3], answer });
+            }
+            return;
+        }
+        case MksCommands::CURRENT_POS: {
+            if (frame.length != 2) { break; }
+            if (!answer) { return; }
+            const auto position = static_cast<uint32_t>(static_cast<int32_t>(std::lround(kinematics(motor, now).first)));
+            reply(motor, command,
+                  { static_cast<uint8_t>(position >> 24 & 0xFF), static_cast<uint8_t>(position >> 16 & 0xFF),
+                    static_cast<uint8_t>(position >> 8 & 0xFF), static_cast<uint8_t>(position & 0xFF) },
+                  now);
+            return;
+        }
+        case MksCommands::QUERY_STATUS: {
+            if (frame.length != 2) { break; }
+            if (answer) { reply(motor, command, { static_cast<uint8_t>(status(motor, now)) }, now); }
+            return;
+        }
+        case MksCommands::IO_STATUS: {
+            if (frame.length != 2) { break; }
+            // Nothing is wired to the simulated ports
+            if (answer) { reply(motor, command, { 0 }, now); }
+            return;
+        }
+        case MksCommands::SET_GROUP_ID: {
+            if (frame.length != 4) { break; }
+            const auto group = static_cast<uint16_t>(data[1] << 8 | data[2]);
+            const bool valid = group != BROADCAST_ID && group <= MAX_GROUP_ID;
+            if (valid) {
+                motor.group = group;
+            } else {
+                ++stats.rejected;
+            }
+            if (answer) { reply(motor, command, { static_cast<uint8_t>(valid ? 1 : 0) }, now); }
+            return;
+        }
+        case MksCommands::EMERGENCY_STOP: {
+            if (frame.length != 2) { break; }
+            // Stops dead, abandoning whatever was in progress without completing it
+            motor.queue.clear();
+            motor.position = kinematics(motor, now).first;
+            motor.phase_count = 0;
+            motor.mode = Mode::IDLE;
+            motor.end = INFINITE_TIME;
+            if (answer) { reply(motor, command, { 1 }, now); }
+            return;
+        }
+        default: break;
+    }
+    ++stats.unsupported;
+}
+
+void MksSimulator::enqueueMove(Motor& motor, const QueuedMove& move) {
+    const bool busy = motor.mode != Mode::IDLE;
+    if (move.speed == 0 || (busy && motor.queue.size() >= options.queue_depth)) {
+        ++stats.rejected;
+        if (move.answer) { reply(motor, move.command, { MksMoveResponse::FAILED }, now); }
+        return;
+    }
+
+    if (move.answer) { reply(motor, move.command, { MksMoveResponse::MOVING }, now); }
+    motor.queue.push_back(move);
+    startNextMove(motor, now);
+}
+
+void MksSimulator::stop(Motor& motor, const uint8_t command, const uint8_t acceleration, const bool answer) {
+    motor.queue.clear();
+    if (answer) { reply(motor, command, { MksMoveResponse::MOVING }, now); }
+    if (motor.mode == Mode::IDLE) {
+        if (answer) { reply(motor, command, { MksMoveResponse::COMPLETED }, now); }
+        return;
+    }
+
+    // The move being stopped never reaches its target, so only the stop itself completes
+    rampTo(motor, 0, acceleration);
+    motor.mode = Mode::STOP;
+    motor.command = answer ? command : 0;
+}
+
+void MksSimulator::startNextMove(Motor& motor, const double start) {
+    if (motor.mode != Mode::IDLE || motor.queue.empty()) { return; }
+    const QueuedMove move = motor.queue.front();
+    motor.queue.pop_front();
+
+    // Absolute targets are resolved once the move starts, from wherever the previous one ended
+    const double origin = motor.position;
+    const double target = move.command == MksCommands::SEEK_POS_BY_STEPS ? move.steps : origin + move.steps;
+    const double distance = std::abs(target - origin);
+    const double direction = target < origin ? -1 : 1;
+    const double rate = move.speed * MKS_STEPS_PER_SPEED_UNIT;
+    const double acceleration = stepAcceleration(move.acceleration);
+
+    // Same trapezoid as mksMoveDuration: ramp up, cruise, and ramp down, or straight up and down for short moves
+    double ramp = 0;
+    double cruise = distance / rate;
+    if (std::isfinite(acceleration)) {
+        if (distance >= rate * rate / acceleration) {
+            ramp = rate / acceleration;
+            cruise = (distance - rate * ramp) / rate;
+        } else {
+            ramp = std::sqrt(distance / acceleration);
+            cruise = 0;
+        }
+    }
+    const double peak = std::isfinite(acceleration) ? acceleration * ramp : rate;
+
+    motor.phase_count = 0;
+    double time = start;
+    double position = origin;
+    if (ramp > 0) {
+        motor.phases[motor.phase_count++] = { time, ramp, position, 0, direction * acceleration };
+        time += ramp;
+        position += direction * peak * ramp / 2;
+    }
+    if (cruise > 0) {
+        motor.phases[motor.phase_count++] = { time, cruise, position, direction * peak, 0 };
+        time += cruise;
+        position += direction * peak * cruise;
+    }
+    if (ramp > 0) {
+        motor.phases[motor.phase_count++] = { time, ramp, position, direction * peak, -direction * acceleration };
+        time += ramp;
+    }
+
+    motor.mode = Mode::MOVE;
+    motor.command = move.answer ? move.command : 0;
+    motor.end = time;
+}
+
+void MksSimulator::rampTo(Motor& motor, const double velocity, const uint8_t acceleration) {
+    const auto [position, current] = kinematics(motor, now);
+    motor.position = position;
+    motor.phase_count = 0;
+
+    double time = now;
+    double reached = position;
+    const double rate = stepAcceleration(acceleration);
+    if (current != velocity && std::isfinite(rate)) {
+        const double duration = std::abs(velocity - current) / rate;
+        motor.phases[motor.phase_count++] = { time, duration, position, current, velocity > current ? rate : -rate };
+        time += duration;
+        reached += (current + velocity) / 2 * duration;
+    }
+    if (velocity != 0) {
+        motor.phases[motor.phase_count++] = { time, INFINITE_TIME, reached, velocity, 0 };
+        motor.end = INFINITE_TIME;
+    } else {
+        motor.end = time;
+    }
+}
+
+void MksSimulator::finish(Motor& motor) {
+    const double end = motor.end;
+    motor.position = kinematics(motor, end).first;
+    motor.phase_count = 0;
+    motor.end = INFINITE_TIME;
+
+    const Mode mode = motor.mode;
+    motor.mode = Mode::IDLE;
+    if (mode != Mode::SPEED && motor.command != 0) {
+        reply(motor, motor.command, { MksMoveResponse::COMPLETED }, end);
+    }
+    startNextMove(motor, end);
+}
+
+const MksSimulator::Phase& MksSimulator::currentPhase(const Motor& motor, const double time) noexcept {
+    size_t index = motor.phase_count - 1;
+    while (index > 0 && motor.phases[index].start > time) { --index; }
+    return motor.phases[index];
+}
+
+std::pair<double, double> MksSimulator::kinematics(const Motor& motor, const double time) noexcept {
+    if (motor.phase_count == 0) { return { motor.position, 0 }; }
+
+    const Phase& phase = currentPhase(motor, time);
+    const double elapsed = std::clamp(time - phase.start, 0.0, phase.duration);
+    return {
+        phase.position + phase.velocity * elapsed + phase.acceleration * elapsed * elapsed / 2,
+        phase.velocity + phase.acceleration * elapsed,
+    };
+}
+
+MksMotorStatus MksSimulator::status(const Motor& motor, const double time) noexcept {
+    if (motor.phase_count == 0 || time + TIME_RESOLUTION >= motor.end) { return MksMotorStatus::STOPPED; }
+
+    const Phase& phase = currentPhase(motor, time);
+    const double velocity = kinematics(motor, time).second;
+    if (phase.acceleration == 0) { return MksMotorStatus::FULL_SPEED; }
+    if (velocity == 0 || (velocity > 0) == (phase.acceleration > 0)) { return MksMotorStatus::ACCELERATING; }
+    return MksMotorStatus::DECELERATING;
+}
+
+void MksSimulator::reply(
+        const Motor& motor, const uint8_t command, const std::initializer_list<uint8_t> arguments, const double time
+) {
+    CanFrame frame;
+    frame.id = motor.id;
+    frame.data[0] = command;
+    std::copy(arguments.begin(), arguments.end(), frame.data.begin() + 1);
+    frame.length = static_cast<uint8_t>(arguments.size() + 1);
+
+    auto sum = static_cast<uint8_t>(motor.id);
+    for (size_t i = 0; i < frame.length; ++i) { sum = static_cast<uint8_t>(sum + frame.data[i]); }
+    frame.data[frame.length++] = sum;
+    frame.timestamp = timePoint(time) + options.response_delay;
+
+    // Completions found late by advance can be due before replies already pending for other motors
+    const auto position = std::upper_bound(
+            pending.begin(), pending.end(), frame.timestamp,
+            [](const auto timestamp, const CanFrame& other) { return timestamp < other.timestamp; }
+    );
+    pending.insert(position, frame);
+    ++stats.replied;
+}
+
+void MksSimulator::release(const std::chrono::steady_clock::time_point time) {
+    while (!pending.empty() && pending.front().timestamp <= time) {
+        released.push_back(pending.front());
+        pending.pop_front();
+    }
+}
+
+double MksSimulator::seconds(const std::chrono::steady_clock::time_point time) const noexcept {
+    return std::chrono::duration<double>(time - epoch).count();
+}
+
+std::chrono::steady_clock::time_point MksSimulator::timePoint(const double seconds) const noexcept {
+    if (!std::isfinite(seconds)) { return std::chrono::steady_clock::time_point::max(); }
+    // Rounded up, so that nothing is reported as due before it has happened
+    return epoch + std::chrono::ceil<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+template void MksSimulator::serve(CanSocket& socket, const std::atomic<bool>& running);
+template void MksSimulator::serve(CanLoopback& socket, const std::atomic<bool>& running);
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * Serves simulated MKS drivers on a CAN interface, so that the controllers, or mks_test_script, can be run and
+ * load-tested against a vcan interface without hardware. Prints what the drivers handled on exit.
+ *
+ * A virtual interface can be created with:
+ * @code{.sh}
+ * sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ * @endcode
+ */
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/program_options.hpp>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "can_socket.hpp"
+#include "mks_simulator.hpp"
+
+constexpr char CAN_INTERFACE[] = "vcan0";
+
+std::atomic<bool> running{ true };
+
+void stopServing(int) { running.store(false, std::memory_order_relaxed); }
+
+int main(int argc, const char* argv[]) {
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::info);
+
+    std::string interface;
+    std::vector<uint16_t> motor_ids;
+    MksSimulatorOptions options;
+    try {
+        boost::program_options::options_description description;
+        description.add_options()
+            ("interface,i", boost::program_options::value<std::string>()->default_value(CAN_INTERFACE), "SocketCAN network interface")
+            ("motors,m", boost::program_options::value<std::vector<uint16_t>>()->multitoken()->composing()->default_value({ 1 }, "1"), "List of CAN IDs to simulate drivers for")
+            ("count,n", boost::program_options::value<uint16_t>(), "Simulate this many drivers, with consecutive CAN IDs from the first of --motors")
+            ("queue-depth,q", boost::program_options::value<size_t>()->default_value(options.queue_depth), "Position moves each driver queues behind the running one")
+            ("response-delay,r", boost::program_options::value<uint32_t>()->default_value(0), "Delay before each reply, in µs")
+            ("help,h", "Show help");
+
+        boost::program_options::variables_map vm;
+        store(parse_command_line(argc, argv, description), vm);
+
+        if (vm.count("help")) {
+            std::cout << description << std::endl;
+            return 0;
+        }
+
+        notify(vm);
+
+        interface = vm["interface"].as<std::string>();
+        motor_ids = vm["motors"].as<std::vector<uint16_t>>();
+        if (vm.count("count")) {
+            const uint16_t first = motor_ids.front();
+            motor_ids.clear();
+            for (uint16_t i = 0; i < vm["count"].as<uint16_t>(); ++i) {
+                motor_ids.push_back(static_cast<uint16_t>(first + i));
+            }
+        }
+        options.queue_depth = vm["queue-depth"].as<size_t>();
+        options.response_delay = std::chrono::microseconds(vm["response-delay"].as<uint32_t>());
+    } catch (const boost::program_options::error& e) {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
+    CanSocket socket(interface);
+    MksSimulator simulator(std::unordered_set<uint16_t>(motor_ids.cbegin(), motor_ids.cend()), options);
+
+    std::signal(SIGINT, stopServing);
+    std::signal(SIGTERM, stopServing);
+    BOOST_LOG_TRIVIAL(info) << "Simulating " << motor_ids.size() << " drivers on " << interface << ", Ctrl+C to stop";
+    simulator.serve(socket, running);
+
+    const MksSimulatorStats stats = simulator.getStats();
+    std::cout << "Received " << stats.received << " commands, sent " << stats.replied << " replies, rejected "
+              << stats.rejected << ", ignored " << stats.checksum_errors << " with bad checksums and "
+              << stats.unsupported << " unsupported" << std::endl;
+    for (const uint16_t motor : motor_ids) {
+        const MksSimulatedMotor state = simulator.motor(motor, std::chrono::steady_clock::now());
+        std::cout << "Motor " << motor << ": position " << state.position << ", status "
+                  << to_string_mks_motor_status(state.status) << std::endl;
+    }
+    return 0;
+}
@@ -4,30 +4,120 @@
 
 #include <boost/log/trivial.hpp>
 
-#include <ros2_socketcan/socket_can_receiver.hpp>
-#include <ros2_socketcan/socket_can_sender.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
 
-#include <numeric>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
 #include "MKS_COMMANDS.hpp"
+#include "can_loopback.hpp"
+#include "can_socket.hpp"
+#include "can_trace.hpp"
 #include "mks_stepper_controller.hpp"
 #include "utils.hpp"
 #include <cmath>
 
-uint8_t checksum(uint16_t driver_id, const std::vector<uint8_t>& payload);
-void packSpeedProperties(
-        std::vector<uint8_t>& payload, const uint8_t acceleration, const int16_t normalised_speed, const bool dir
-);
+namespace {
+    // Layout of a streaming mailbox word: the deadline in the upper 40 bits, then the acceleration and speed. A
+    // deadline of 0 marks an empty mailbox, so deadlines are offset by one tick of their resolution
+    constexpr unsigned STREAM_DEADLINE_SHIFT = 24;
+    constexpr uint64_t STREAM_DEADLINE_MAX = (uint64_t{ 1 } << 40) - 1;
+    constexpr uint64_t STREAM_COMMAND_MASK = (uint64_t{ 1 } << STREAM_DEADLINE_SHIFT) - 1;
 
-MksStepperController::MksStepperController(
+    /** Resolution of mailbox deadlines; 40 bits of it cover about four months from the controller's construction. */
+    using StreamDeadlineUnit = std::chrono::duration<int64_t, std::ratio<1, 100000>>;
+
+    // Argument-free frames are fixed once the ID is known, so they can be built entirely at compile time
+    static_assert(MksEncoder(0x01).getPosition().length == 2 && MksEncoder(0x01).getPosition().data[1] == 0x34);
+
+    /** Number of standard (11-bit) CAN identifiers. */
+    constexpr size_t STANDARD_ID_COUNT = 0x800;
+
+    /** How long the transmit thread waits before retrying after the kernel refuses a frame. */
+    constexpr std::chrono::microseconds TRANSMIT_RETRY_INTERVAL{ 250 };
+
+    /**
+     * Whether a command stops the motor ahead of anything queued on the driver: EMERGENCY_STOP, or SEND_STEP or
+     * SEEK_POS_BY_STEPS with zero speed properties and steps, see @ref MksCommands.
+     */
+    bool isStopCommand(const uint8_t* payload, const size_t length) {
+        if (length >= 1 && payload[0] == MksCommands::EMERGENCY_STOP) { return true; }
+        if (length < 7 || (payload[0] != MksCommands::SEND_STEP && payload[0] != MksCommands::SEEK_POS_BY_STEPS)) {
+            return false;
+        }
+        return payload[1] == 0 && payload[2] == 0 && payload[4] == 0 && payload[5] == 0 && payload[6] == 0;
+    }
+
+    /**
+     * Whether a command sets the motor moving, so that sending it after a stop would undo the stop.
+     */
+    bool isMotionCommand(const uint8_t* payload, const size_t length) {
+        return length >= 1
+               && (payload[0] == MksCommands::SET_SPEED || payload[0] == MksCommands::SEND_STEP
+                   || payload[0] == MksCommands::SEEK_POS_BY_STEPS);
+    }
+} // namespace
+
+template <typename Transport>
+BasicMksStepperController<Transport>::BasicMksStepperController(
         const std::string& can_interface, std::shared_ptr<const std::unordered_set<uint16_t>> motor_ids,
-        const uint8_t norm_factor
+        const uint8_t norm_factor, const RealtimeOptions& realtime
 )
-    : motor_ids{ std::move(motor_ids) }, norm_factor{ norm_factor } {
+    : motor_ids{ std::move(motor_ids) }, norm_factor{ norm_factor }, realtime_options{ realtime },
+      receive_thread_running{ false },
+      priority_lane{ std::make_unique<MpscRing<TransmitEntry, PRIORITY_QUEUE_CAPACITY>>() },
+      normal_lane{ std::make_unique<MpscRing<TransmitEntry, TRANSMIT_QUEUE_CAPACITY>>() }, transmitting{ false },
+      transmit_event{ -1 }, transmitter_idle{ false }, transmit_sequence{ 0 },
+      stop_sequences{ std::make_unique<std::atomic<uint64_t>[]>(STANDARD_ID_COUNT) }, emergency_sequence{ 0 },
+      transmit_sent{ 0 }, transmit_priority_sent{ 0 }, transmit_rejected{ 0 }, transmit_failed{ 0 },
+      transmit_superseded{ 0 }, transmit_restopped{ 0 },
+      transmit_max_latency{ 0 }, transmit_max_priority_latency{ 0 }, queue_events{ false },
+      event_queue{ std::make_unique<SpscRing<MksEvent, EVENT_QUEUE_CAPACITY>>() }, dropped_events{ 0 },
+      signals_enabled{ true }, dump_on_fault{ false }, next_request_id{ 0 }, pending_request_count{ 0 },
+      window_depth{ 0 }, window_timeout{ DEFAULT_REQUEST_TIMEOUT }, window_enabled{ false }, admission_threshold{ 1 },
+      admission_policy{ MksAdmissionPolicy::DISABLED }, admission_refused{ 0 }, admission_deferred{ 0 },
+      has_deferred{ false }, polling{ false }, poll_scale{ 1 }, streaming{ false }, stream_timer{ -1 }, stream_rate{ 0 },
+      stream_max_age{ MksStreamConfig{}.max_age.count() }, stream_epoch{ std::chrono::steady_clock::now() },
+      stream_ticks{ 0 }, stream_missed{ 0 }, stream_sent{ 0 }, stream_unchanged{ 0 }, stream_stale{ 0 },
+      stream_replaced{ 0 }, stream_expired{ 0 }, stream_failed{ 0 }, stream_total_jitter{ 0 }, stream_max_jitter{ 0 } {
     BOOST_LOG_TRIVIAL(trace) << "MksStepperController construction begun";
 
-    this->can_receiver = std::make_unique<drivers::socketcan::SocketCanReceiver>(can_interface);
-    this->can_sender = std::make_unique<drivers::socketcan::SocketCanSender>(can_interface);
+    for (size_t query = 0; query < POLL_QUERY_COUNT; ++query) {
+        poll_issued[query] = 0;
+        poll_skipped[query] = 0;
+        poll_failed[query] = 0;
+        poll_responses[query] = 0;
+    }
+    for (size_t id = 0; id < STANDARD_ID_COUNT; ++id) { stop_sequences[id].store(0, std::memory_order_relaxed); }
+
+    process_realtime = applyProcessRealtime(realtime_options);
+    if (process_realtime.memory_lock == RealtimeResult::FAILED || process_realtime.prefault == RealtimeResult::FAILED) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController failed to lock or prefault memory, errno="
+                                   << process_realtime.error;
+    }
+
+    this->can_receiver = std::make_unique<Transport>(can_interface);
+    this->can_sender = std::make_unique<Transport>(can_interface);
+    this->can_emergency = std::make_unique<Transport>(can_interface);
+    // Only used for sending, so don't let the bus' traffic pile up in their receive queues
+    can_sender->acceptStandardIds({});
+    can_emergency->acceptStandardIds({});
+    applyMotorIds();
+
+    transmit_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (transmit_event < 0) {
+        throw std::runtime_error(
+                "MksStepperController: failed to create transmit event: " + std::string(std::strerror(errno))
+        );
+    }
+    transmitting = true;
+    transmit_thread = std::thread(&BasicMksStepperController::transmitLoop, this);
+    applyRealtime(MksThread::TRANSMIT, transmit_thread);
 
     //TODO: Write norm_factor as microstepping factor to the driver
 
@@ -36,9 +126,23 @@ MksStepperController::MksStepperController(
     setup_completed = true;
 }
 
-MksStepperController::~MksStepperController() noexcept { BOOST_LOG_TRIVIAL(debug) << "MksStepperController destructed"; }
+template <typename Transport>
+BasicMksStepperController<Transport>::~BasicMksStepperController() noexcept {
+    stopStreaming();
+    stopPolling();
+    stopReceiveThread();
+
+    // Last, as the other threads issue commands; whatever is still queued gets until its timeout to go out
+    transmitting = false;
+    const uint64_t signal = 1;
+    [[maybe_unused]] const ssize_t written = write(transmit_event, &signal, sizeof(signal));
+    transmit_thread.join();
+    close(transmit_event);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController destructed";
+}
 
-bool MksStepperController::setSpeed(const uint16_t motor, const int16_t speed, const uint8_t acceleration) {
+template <typename Transport>
+bool BasicMksStepperController<Transport>::setSpeed(const uint16_t motor, const int16_t speed, const uint8_t acceleration) {
     if (!isSetup()) { return false; }
 
     // Speed is normalised when norm_factor is 16
@@ -47,21 +151,13 @@ bool MksStepperController::setSpeed(const uint16_t motor, const int16_t speed, c
     // At 32, normalised_speed = speed * 2
     auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
 
-    std::vector<uint8_t> payload{ MksCommands::SET_SPEED };
-
-    packSpeedProperties(payload, acceleration, normalised_speed, speed > 0);
-
-    payload.insert(payload.end(), checksum(motor, payload));
+    const MksPayload payload = encoder(motor).setSpeed(normalised_speed, speed > 0, acceleration);
 
     // accel casted to uint16_t so that it outputs as an integer instead of a char
     BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SetSpeed sent for motor 0x" << std::hex << motor << std::dec
                              << " with speed=" << speed << ", accel=" << static_cast<uint16_t>(acceleration)
                              << ", normalised_speed=" << normalised_speed;
-    try {
-        drivers::socketcan::CanId can_id(motor, 0, drivers::socketcan::FrameType::DATA, drivers::socketcan::StandardFrame);
-        can_sender->send(payload.data(), payload.size(), can_id);
-    } catch (drivers::socketcan::SocketCanTimeout& e) {
-        // Won't bother with e.what(), it is always "CAN Send timeout"
+    if (!submit(motor, MksEvent::Type::SET_SPEED, payload)) {
         BOOST_LOG_TRIVIAL(warning) << "MksStepperController setSpeed timeout: motor=0x" << std::hex << motor << std::dec
                                    << ", speed=" << normalised_speed << ", accel=" << static_cast<uint16_t>(acceleration);
         return false;
@@ -88,7 +184,8 @@ bool MksStepperController::setSpeed(const uint16_t motor, const int16_t speed, c
 //    return true;
 //}
 
-bool MksStepperController::sendStep(
+template <typename Transport>
+bool BasicMksStepperController<Transport>::sendStep(
         const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration
 ) {
     if (!isSetup()) { return false; }
@@ -96,25 +193,13 @@ bool MksStepperController::sendStep(
     auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
     uint32_t normalised_steps = num_steps * norm_factor;
 
-    std::vector<uint8_t> payload{ MksCommands::SEND_STEP };
-
-    packSpeedProperties(payload, acceleration, normalised_speed, speed > 0);
-
-    // With move iterators the compiler might invoke copy elision? Not entirely sure
-    auto steps_packed = pack_24_big(normalised_steps);
-    payload.insert(
-            payload.end(), std::make_move_iterator(steps_packed.begin()), std::make_move_iterator(steps_packed.end())
-    );
-    payload.insert(payload.end(), checksum(motor, payload));
+    const MksPayload payload = encoder(motor).sendStep(normalised_steps, normalised_speed, speed > 0, acceleration);
 
     BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SendStep sent for motor 0x" << std::hex << motor << std::dec
                              << " with steps=" << num_steps << ", speed=" << speed
                              << ", accel=" << static_cast<uint16_t>(acceleration)
                              << ", normalised_steps=" << normalised_steps << ", normalised_speed=" << normalised_speed;
-    try {
-        drivers::socketcan::CanId can_id(motor, 0, drivers::socketcan::FrameType::DATA, drivers::socketcan::StandardFrame);
-        can_sender->send(payload.data(), payload.size(), can_id);
-    } catch (drivers::socketcan::SocketCanTimeout& e) {
+    if (!submit(motor, MksEvent::Type::SEND_STEP, payload)) {
         BOOST_LOG_TRIVIAL(warning) << "MksStepperController sendStep timeout: motor=0x" << std::hex << motor << std::dec
                                    << ", num_steps=" << num_steps << ", speed=" << normalised_speed
                                    << ", accel=" << static_cast<uint16_t>(acceleration);
@@ -123,7 +208,8 @@ bool MksStepperController::sendStep(
     return true;
 }
 
-bool MksStepperController::seekPosition(
+template <typename Transport>
+bool BasicMksStepperController<Transport>::seekPosition(
         const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration
 ) {
     if (!isSetup()) { return false; }
@@ -131,28 +217,13 @@ bool MksStepperController::seekPosition(
     auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
     int32_t normalised_position = position * norm_factor;
 
-    std::vector<uint8_t> payload{ MksCommands::SEEK_POS_BY_STEPS };
-
-    // With move iterators the compiler might invoke copy elision? Not entirely sure
-    auto speed_packed = pack_16_big(normalised_speed);
-    auto position_packed = pack_24_big(normalised_position);
-    payload.insert(
-            payload.end(), std::make_move_iterator(speed_packed.begin()), std::make_move_iterator(speed_packed.end())
-    );
-    payload.insert(payload.end(), acceleration);
-    payload.insert(
-            payload.end(), std::make_move_iterator(position_packed.begin()), std::make_move_iterator(position_packed.end())
-    );
-    payload.insert(payload.end(), checksum(motor, payload));
+    const MksPayload payload = encoder(motor).seekPosition(normalised_position, normalised_speed, acceleration);
 
     BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SeekPosition sent for motor 0x" << std::hex << motor << std::dec
                              << " with position=" << position << ", speed=" << speed
                              << ", accel=" << static_cast<uint16_t>(acceleration)
                              << ", normalised_position=" << normalised_position << ", normalised_speed=" << normalised_speed;
-    try {
-        drivers::socketcan::CanId can_id(motor, 0, drivers::socketcan::FrameType::DATA, drivers::socketcan::StandardFrame);
-        can_sender->send(payload.data(), payload.size(), can_id);
-    } catch (drivers::socketcan::SocketCanTimeout& e) {
+    if (!submit(motor, MksEvent::Type::SEEK_POSITION, payload)) {
         BOOST_LOG_TRIVIAL(warning) << "MksStepperController sendStep timeout: motor=0x" << std::hex << motor << std::dec
                                    << ", position=" << normalised_position << ", speed=" << normalised_speed
                                    << ", accel=" << static_cast<uint16_t>(acceleration);
@@ -161,129 +232,1944 @@ bool MksStepperController::seekPosition(
     return true;
 }
 
-bool MksStepperController::getPosition(const uint16_t motor) {
+template <typename Transport>
+bool BasicMksStepperController<Transport>::emergencyStop(const uint16_t motor) {
     if (!isSetup()) { return false; }
 
-    std::vector<uint8_t> payload{ MksCommands::CURRENT_POS };
-    payload.insert(payload.end(), checksum(motor, payload));
+    const MksPayload payload = encoder(motor).query(MksCommands::EMERGENCY_STOP);
+    bool sent;
+    const uint16_t slot = motor_index.slot(motor);
+    if (window_enabled.load(std::memory_order_acquire) && slot != MotorIndex::NO_SLOT) {
+        // The response isn't decoded, so the stop doesn't enter the window, but what is waiting for room in it mustn't
+        // follow the stop out; held under the lock so that nothing new is queued in between
+        std::lock_guard<std::mutex> lock(pipeline_mutex);
+        discardQueuedMotion(pipelines[slot]);
+        sent = transmit(motor, payload.data.data(), payload.length);
+    } else {
+        sent = transmit(motor, payload.data.data(), payload.length);
+    }
+
+    if (!sent) {
+        BOOST_LOG_TRIVIAL(error) << "MksStepperController emergencyStop couldn't be queued: motor=0x" << std::hex << motor
+                                 << std::dec;
+        return false;
+    }
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: EmergencyStop sent for motor 0x" << std::hex << motor << std::dec;
+    return true;
+}
+
+template <typename Transport>
+MksEmergencyStopResult
+BasicMksStepperController<Transport>::emergencyStopAll(const std::chrono::nanoseconds& timeout) noexcept {
+    // A signal handler may interrupt code which is about to inspect errno
+    const int saved_errno = errno;
+    const auto start = std::chrono::steady_clock::now();
+
+    MksEmergencyStopResult result;
+    result.motors = motor_index.size();
+    // Everything issued so far is superseded, whether it is waiting for the transmit thread or in a window; only
+    // atomic stores, so nothing here can block on a lock held by the code this interrupted
+    const uint64_t sequence = transmit_sequence.load(std::memory_order_relaxed);
+    for (size_t slot = 0; slot < result.motors; ++slot) {
+        stop_sequences[motor_index.motor(static_cast<uint16_t>(slot)) % STANDARD_ID_COUNT].store(
+                sequence, std::memory_order_relaxed
+        );
+        stream_mailboxes[slot].store(0, std::memory_order_relaxed);
+    }
+    // Ordered before the stops reach the kernel, so the transmit thread sees it once it has sent anything which
+    // follows them on the bus, see sendStaged
+    emergency_sequence.store(sequence, std::memory_order_seq_cst);
+
+    result.sent = can_emergency->sendBatch(emergency_frames.get(), result.motors, timeout);
+    const auto sent_time = std::chrono::steady_clock::now();
+    result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(sent_time - start);
+
+    // Both are lock-free, and only touched once the frames are out
+    for (size_t frame = 0; frame < result.sent; ++frame) {
+        const CanFrame& stop = emergency_frames[frame];
+        recordTransmitted(static_cast<uint16_t>(stop.id), stop.data.data(), stop.length, sent_time);
+    }
+    errno = saved_errno;
+    return result;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::getPosition(const uint16_t motor) {
+    if (!isSetup()) { return false; }
 
     BOOST_LOG_TRIVIAL(debug) << "MksStepperController: GetPosition sent for motor 0x" << std::hex << motor << std::dec;
-    try {
-        drivers::socketcan::CanId can_id(motor, 0, drivers::socketcan::FrameType::DATA, drivers::socketcan::StandardFrame);
-        can_sender->send(payload.data(), payload.size(), can_id);
-    } catch (drivers::socketcan::SocketCanTimeout& e) {
+    if (!submit(motor, MksEvent::Type::GET_POSITION, encoder(motor).getPosition())) {
         BOOST_LOG_TRIVIAL(warning) << "MksStepperController getPosition timeout: motor=0x" << std::hex << motor << std::dec;
         return false;
     }
     return true;
 }
 
-bool MksStepperController::isSetup() const { return this->setup_completed; }
+template <typename Transport>
+bool BasicMksStepperController<Transport>::getStatus(const uint16_t motor) {
+    if (!isSetup()) { return false; }
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: GetStatus sent for motor 0x" << std::hex << motor << std::dec;
+    if (!submit(motor, MksEvent::Type::GET_STATUS, encoder(motor).getStatus())) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController getStatus timeout: motor=0x" << std::hex << motor << std::dec;
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::getIoStatus(const uint16_t motor) {
+    if (!isSetup()) { return false; }
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: GetIoStatus sent for motor 0x" << std::hex << motor << std::dec;
+    if (!submit(motor, MksEvent::Type::GET_IO_STATUS, encoder(motor).getIoStatus())) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController getIoStatus timeout: motor=0x" << std::hex << motor
+                                   << std::dec;
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::setGroupId(const uint16_t motor, const uint16_t group) {
+    if (!isSetup()) { return false; }
+    // 0 is the broadcast address, and a group sharing an ID with one of our motors would hijack its responses
+    if (group == 0 || group > 0x7FF || motor_index.contains(group)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController refusing invalid group ID 0x" << std::hex << group
+                                   << " for motor 0x" << motor << std::dec;
+        return false;
+    }
+
+    const MksPayload payload = encoder(motor).setGroupId(group);
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SetGroupId sent for motor 0x" << std::hex << motor
+                             << " with group=0x" << group << std::dec;
+    if (!submit(motor, MksEvent::Type::SET_GROUP_ID, payload)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController setGroupId timeout: motor=0x" << std::hex << motor
+                                   << ", group=0x" << group << std::dec;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(group_mutex);
+    for (auto& [id, members] : group_members) {
+        members.erase(std::remove(members.begin(), members.end(), motor), members.end());
+    }
+    group_members[group].push_back(motor);
+    return true;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::groupSetSpeed(
+        const uint16_t group, const int16_t speed, const uint8_t acceleration
+) {
+    if (!isSetup()) { return false; }
+
+    auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
+    // The checksum is computed over the ID the frame is addressed to, which is the group ID here
+    const MksPayload payload = MksEncoder(group).setSpeed(normalised_speed, speed > 0, acceleration);
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SetSpeed sent for group 0x" << std::hex << group << std::dec
+                             << " with speed=" << speed << ", accel=" << static_cast<uint16_t>(acceleration)
+                             << ", normalised_speed=" << normalised_speed;
+    // Drivers don't respond to group frames, so there is nothing to hold a window slot open for
+    if (!transmit(group, payload.data.data(), payload.length)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController groupSetSpeed timeout: group=0x" << std::hex << group
+                                   << std::dec << ", speed=" << normalised_speed
+                                   << ", accel=" << static_cast<uint16_t>(acceleration);
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::groupSendStep(
+        const uint16_t group, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration
+) {
+    if (!isSetup()) { return false; }
+
+    auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
+    uint32_t normalised_steps = num_steps * norm_factor;
+    const MksPayload payload = MksEncoder(group).sendStep(normalised_steps, normalised_speed, speed > 0, acceleration);
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SendStep sent for group 0x" << std::hex << group << std::dec
+                             << " with steps=" << num_steps << ", speed=" << speed
+                             << ", accel=" << static_cast<uint16_t>(acceleration)
+                             << ", normalised_steps=" << normalised_steps << ", normalised_speed=" << normalised_speed;
+    if (!transmit(group, payload.data.data(), payload.length)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController groupSendStep timeout: group=0x" << std::hex << group
+                                   << std::dec << ", num_steps=" << num_steps << ", speed=" << normalised_speed
+                                   << ", accel=" << static_cast<uint16_t>(acceleration);
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::groupSeekPosition(
+        const uint16_t group, const int32_t position, const int16_t speed, const uint8_t acceleration
+) {
+    if (!isSetup()) { return false; }
+
+    auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
+    int32_t normalised_position = position * norm_factor;
+    const MksPayload payload = MksEncoder(group).seekPosition(normalised_position, normalised_speed, acceleration);
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SeekPosition sent for group 0x" << std::hex << group << std::dec
+                             << " with position=" << position << ", speed=" << speed
+                             << ", accel=" << static_cast<uint16_t>(acceleration)
+                             << ", normalised_position=" << normalised_position << ", normalised_speed=" << normalised_speed;
+    if (!transmit(group, payload.data.data(), payload.length)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController groupSeekPosition timeout: group=0x" << std::hex << group
+                                   << std::dec << ", position=" << normalised_position << ", speed=" << normalised_speed
+                                   << ", accel=" << static_cast<uint16_t>(acceleration);
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+std::vector<MksAxisPlan> BasicMksStepperController<Transport>::planCoordinatedSeek(
+        const std::vector<MksAxisMove>& moves, const int16_t speed, const uint8_t acceleration
+) const {
+    const auto max_speed = static_cast<uint16_t>(
+            std::clamp<int32_t>(std::abs(speed) * (int32_t)16 / norm_factor, 1, MKS_MAX_SPEED)
+    );
+
+    // Distances in driver steps, i.e. after interpolated normalisation
+    std::vector<uint32_t> distances(moves.size());
+    uint32_t longest = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const int64_t distance = (static_cast<int64_t>(moves[i].position) - moves[i].current_position) * norm_factor;
+        distances[i] = static_cast<uint32_t>(std::min<int64_t>(std::abs(distance), UINT32_MAX));
+        longest = std::max(longest, distances[i]);
+    }
+    const MksRamp lead{ max_speed, acceleration };
+    const double duration = mksMoveDuration(longest, lead);
+
+    std::vector<MksAxisPlan> plan(moves.size());
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const MksRamp ramp = distances[i] == longest ? lead
+                                                     : mksMatchDuration(distances[i], duration, acceleration, max_speed);
+        plan[i].motor = moves[i].motor;
+        plan[i].position = moves[i].position;
+        plan[i].speed = ramp.speed;
+        plan[i].acceleration = ramp.acceleration;
+        plan[i].duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double>(mksMoveDuration(distances[i], ramp))
+        );
+    }
+    return plan;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::seekCoordinated(const std::vector<MksAxisPlan>& plan) {
+    if (!isSetup()) { return false; }
+
+    // Encode everything up front and send it as one batch, so that the frames go out as close together as possible
+    std::vector<EncodedCommand> commands;
+    commands.reserve(plan.size());
+    for (const MksAxisPlan& axis : plan) {
+        const MksPayload payload = encoder(axis.motor).seekPosition(
+                axis.position * norm_factor, axis.speed, axis.acceleration
+        );
+        commands.push_back({ axis.motor, MksEvent::Type::SEEK_POSITION, payload });
+    }
+
+    const MksBatchResult result = submitBatch(commands);
+    for (const size_t i : result.failed) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController seekCoordinated timeout: motor=0x" << std::hex
+                                   << plan[i].motor << std::dec << ", speed=" << plan[i].speed
+                                   << ", accel=" << static_cast<uint16_t>(plan[i].acceleration);
+    }
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SeekPosition sent for " << plan.size() << " coordinated motors";
+    return result.failed.empty();
+}
+
+void MksBatch::setSpeed(const uint16_t motor, const int16_t speed, const uint8_t acceleration) {
+    entries.push_back({ motor, MksEvent::Type::SET_SPEED, speed, acceleration, 0 });
+}
+
+void MksBatch::sendStep(const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration) {
+    entries.push_back({ motor, MksEvent::Type::SEND_STEP, speed, acceleration, static_cast<int32_t>(num_steps) });
+}
+
+void MksBatch::seekPosition(const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration) {
+    entries.push_back({ motor, MksEvent::Type::SEEK_POSITION, speed, acceleration, position });
+}
+
+void MksBatch::getPosition(const uint16_t motor) { entries.push_back({ motor, MksEvent::Type::GET_POSITION, 0, 0, 0 }); }
+
+void MksBatch::getStatus(const uint16_t motor) { entries.push_back({ motor, MksEvent::Type::GET_STATUS, 0, 0, 0 }); }
+
+void MksBatch::getIoStatus(const uint16_t motor) { entries.push_back({ motor, MksEvent::Type::GET_IO_STATUS, 0, 0, 0 }); }
+
+const std::vector<MksBatchCommand>& MksBatch::commands() const { return entries; }
+
+void MksBatch::clear() { entries.clear(); }
+
+template <typename Transport>
+MksBatchResult BasicMksStepperController<Transport>::sendBatch(const MksBatch& batch) {
+    const std::vector<MksBatchCommand>& batched = batch.commands();
+    MksBatchResult result;
+    if (!isSetup()) {
+        for (size_t i = 0; i < batched.size(); ++i) { result.failed.push_back(i); }
+        return result;
+    }
+
+    // Commands which can't be encoded are reported as failed without holding up the rest
+    std::vector<EncodedCommand> commands;
+    std::vector<size_t> indices;
+    std::vector<size_t> unencodable;
+    commands.reserve(batched.size());
+    indices.reserve(batched.size());
+    for (size_t i = 0; i < batched.size(); ++i) {
+        EncodedCommand command{ batched[i].motor, batched[i].type, {} };
+        if (!encodeBatchCommand(batched[i], command.payload)) {
+            unencodable.push_back(i);
+            continue;
+        }
+        commands.push_back(command);
+        indices.push_back(i);
+    }
+
+    result = submitBatch(commands);
+    for (size_t& failed : result.failed) { failed = indices[failed]; }
+    if (!unencodable.empty()) {
+        result.failed.insert(result.failed.end(), unencodable.cbegin(), unencodable.cend());
+        std::sort(result.failed.begin(), result.failed.end());
+    }
+
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: Batch of " << batched.size() << " commands sent, "
+                             << result.sent << " transmitted, " << result.queued << " queued, "
+                             << result.failed.size() << " failed";
+    return result;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::encodeBatchCommand(const MksBatchCommand& command, MksPayload& payload) const {
+    const MksEncoder motor_encoder = encoder(command.motor);
+    const auto normalised_speed = static_cast<int16_t>(std::abs(command.speed) * (int32_t)16 / norm_factor);
+    switch (command.type) {
+        case MksEvent::Type::SET_SPEED:
+            payload = motor_encoder.setSpeed(normalised_speed, command.speed > 0, command.acceleration);
+            return true;
+        case MksEvent::Type::SEND_STEP:
+            payload = motor_encoder.sendStep(
+                    static_cast<uint32_t>(command.value) * norm_factor, normalised_speed, command.speed > 0,
+                    command.acceleration
+            );
+            return true;
+        case MksEvent::Type::SEEK_POSITION:
+            payload = motor_encoder.seekPosition(command.value * norm_factor, normalised_speed, command.acceleration);
+            return true;
+        case MksEvent::Type::GET_POSITION: payload = motor_encoder.getPosition(); return true;
+        case MksEvent::Type::GET_STATUS: payload = motor_encoder.getStatus(); return true;
+        case MksEvent::Type::GET_IO_STATUS: payload = motor_encoder.getIoStatus(); return true;
+        default: return false;
+    }
+}
+
+template <typename Transport>
+MksBatchResult BasicMksStepperController<Transport>::submitBatch(const std::vector<EncodedCommand>& commands) {
+    MksBatchResult result;
+
+    // Admission control first, as releaseDeferred takes the admission lock before the pipeline lock
+    std::vector<size_t> admitted;
+    admitted.reserve(commands.size());
+    for (size_t i = 0; i < commands.size(); ++i) {
+        switch (admit(commands[i].motor, commands[i].type, commands[i].payload)) {
+            case Admission::ADMITTED: admitted.push_back(i); break;
+            case Admission::DEFERRED: ++result.queued; break;
+            default: result.failed.push_back(i); break;
+        }
+    }
+
+    std::vector<TransmitEntry> entries;
+    std::vector<size_t> entry_commands;
+    entries.reserve(admitted.size());
+    entry_commands.reserve(admitted.size());
+
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    const bool windowed = window_enabled.load(std::memory_order_acquire);
+    const auto now = std::chrono::steady_clock::now();
+    const auto pipeline_of = [&](const uint16_t motor) -> MotorPipeline* {
+        const uint16_t slot = motor_index.slot(motor);
+        return windowed && slot != MotorIndex::NO_SLOT ? &pipelines[slot] : nullptr;
+    };
+
+    // Hands the run collected so far to the transmit thread in one go, so that its frames go out together
+    const auto flush = [&]() {
+        if (transmitAll(entries.data(), entries.size())) {
+            result.sent += entries.size();
+        } else {
+            // Nothing was queued, so give back the room taken in the windows, newest first
+            for (auto i = entry_commands.crbegin(); i != entry_commands.crend(); ++i) {
+                if (MotorPipeline* pipeline = pipeline_of(commands[*i].motor)) {
+                    pipeline->in_flight.pop_back();
+                    --pipeline->stats.sent;
+                }
+                result.failed.push_back(*i);
+            }
+        }
+        entries.clear();
+        entry_commands.clear();
+    };
+
+    for (const size_t i : admitted) {
+        const EncodedCommand& command = commands[i];
+        MotorPipeline* pipeline = pipeline_of(command.motor);
+        const uint8_t* payload = command.payload.data.data();
+
+        if (isStopCommand(payload, command.payload.length)) {
+            // Queue everything before the stop first, so that the stop supersedes it rather than the other way around
+            flush();
+            if (pipeline != nullptr) { discardQueuedMotion(*pipeline); }
+            if (!transmit(command.motor, payload, command.payload.length)) {
+                result.failed.push_back(i);
+                continue;
+            }
+            if (pipeline != nullptr) {
+                pipeline->in_flight.push_back({ command.type, now, true });
+                ++pipeline->stats.sent;
+            }
+            ++result.sent;
+            continue;
+        }
+
+        // Earlier commands in this batch have already taken their room in the window
+        if (pipeline != nullptr
+            && (!pipeline->queue.empty() || (window_depth != 0 && pipeline->in_flight.size() >= window_depth))) {
+            queueCommand(*pipeline, command.type, payload, command.payload.length, now);
+            ++result.queued;
+            continue;
+        }
+
+        TransmitEntry entry{};
+        entry.id = command.motor;
+        entry.length = command.payload.length;
+        entry.payload = command.payload.data;
+        entry.queued = now;
+        entries.push_back(entry);
+        entry_commands.push_back(i);
+        if (pipeline != nullptr) {
+            pipeline->in_flight.push_back({ command.type, now });
+            ++pipeline->stats.sent;
+        }
+    }
+    flush();
+    std::sort(result.failed.begin(), result.failed.end());
+    return result;
+}
+
+template <typename Transport>
+std::vector<uint16_t> BasicMksStepperController<Transport>::getGroupMembers(const uint16_t group) const {
+    std::lock_guard<std::mutex> lock(group_mutex);
+    const auto members = group_members.find(group);
+    return members == group_members.end() ? std::vector<uint16_t>{} : members->second;
+}
+
+template <typename Transport>
+std::vector<MksGroupConfirmation> BasicMksStepperController<Transport>::confirmGroup(
+        const uint16_t group, const std::chrono::nanoseconds& timeout
+) {
+    const std::vector<uint16_t> members = getGroupMembers(group);
+
+    // Send every query before waiting on any of them, so the members answer concurrently
+    std::vector<Request> requests;
+    requests.reserve(members.size());
+    for (const uint16_t motor : members) {
+        requests.push_back(beginRequest(motor, MksEvent::Type::GET_STATUS, MksCompletion::ACKNOWLEDGED, timeout));
+        if (!getStatus(motor)) { cancelRequest(requests.back().id); }
+    }
+
+    std::vector<MksGroupConfirmation> confirmations(members.size());
+    for (size_t i = 0; i < members.size(); ++i) {
+        confirmations[i].motor = members[i];
+        confirmations[i].status = awaitRequest(requests[i]);
+    }
+    return confirmations;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::transmit(const uint16_t motor, const uint8_t* payload, const size_t length) {
+    TransmitEntry entry{};
+    entry.id = motor;
+    entry.length = static_cast<uint8_t>(std::min(length, entry.payload.size()));
+    std::copy_n(payload, entry.length, entry.payload.begin());
+    entry.queued = std::chrono::steady_clock::now();
+    if (!isStopCommand(payload, length)) { return transmitAll(&entry, 1); }
+
+    // Ordinary frames numbered below this were issued before the stop; published by the push below, so the transmit
+    // thread sees it by the time it has taken the stop from the lane
+    entry.sequence = transmit_sequence.load(std::memory_order_relaxed);
+    stop_sequences[motor % STANDARD_ID_COUNT].store(entry.sequence, std::memory_order_relaxed);
+    if (!priority_lane->push(entry)) {
+        transmit_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    wakeTransmitter();
+    return true;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::transmitAll(TransmitEntry* entries, const size_t count) {
+    if (count == 0) { return true; }
+    const uint64_t first = transmit_sequence.fetch_add(count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) { entries[i].sequence = first + i; }
+    if (!normal_lane->pushAll(entries, count)) {
+        transmit_rejected.fetch_add(count, std::memory_order_relaxed);
+        return false;
+    }
+    wakeTransmitter();
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::wakeTransmitter() {
+    // Pairs with the fence in waitForFrames: either the transmit thread sees the frame just pushed, or we see that it
+    // has gone to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!transmitter_idle.load(std::memory_order_relaxed)) { return; }
+    const uint64_t signal = 1;
+    [[maybe_unused]] const ssize_t written = write(transmit_event, &signal, sizeof(signal));
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::recordTransmitted(
+        const uint16_t motor, const uint8_t* payload, const size_t length, const std::chrono::steady_clock::time_point time
+) {
+    bus_load.record(static_cast<uint8_t>(length), time);
+    flight_recorder.record(FrameDirection::TRANSMITTED, motor, false, payload, length, time);
+}
+
+template <typename Transport>
+MksEncoder BasicMksStepperController<Transport>::encoder(const uint16_t can_id) const {
+    const uint16_t slot = motor_index.slot(can_id);
+    return slot == MotorIndex::NO_SLOT ? MksEncoder(can_id) : encoders[slot];
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::submit(
+        const uint16_t motor, const MksEvent::Type type, const MksPayload& payload,
+        const std::chrono::steady_clock::time_point deadline
+) {
+    switch (admit(motor, type, payload)) {
+        case Admission::ADMITTED: return enqueue(motor, type, payload.data.data(), payload.length, deadline);
+        case Admission::DEFERRED: return true;
+        default: return false;
+    }
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Admission BasicMksStepperController<Transport>::admit(
+        const uint16_t motor, const MksEvent::Type type, const MksPayload& payload
+) {
+    const MksAdmissionPolicy policy = admission_policy.load(std::memory_order_acquire);
+    // Queries only refresh state which is polled again anyway, whereas motion commands must always go out
+    const bool low_priority = type == MksEvent::Type::GET_POSITION || type == MksEvent::Type::GET_STATUS
+                              || type == MksEvent::Type::GET_IO_STATUS;
+    if (policy == MksAdmissionPolicy::DISABLED || !low_priority
+        || bus_load.utilisation() < admission_threshold.load(std::memory_order_relaxed)) {
+        return Admission::ADMITTED;
+    }
+
+    if (policy == MksAdmissionPolicy::DEFER) {
+        std::lock_guard<std::mutex> lock(admission_mutex);
+        if (deferred_commands.size() < MAX_DEFERRED_COMMANDS) {
+            DeferredCommand command{};
+            command.motor = motor;
+            command.type = type;
+            command.length = payload.length;
+            command.payload = payload.data;
+            deferred_commands.push_back(command);
+            has_deferred.store(true, std::memory_order_release);
+            ++admission_deferred;
+            return Admission::DEFERRED;
+        }
+    }
+    ++admission_refused;
+    return Admission::REFUSED;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::releaseDeferred() {
+    if (!has_deferred.load(std::memory_order_acquire)) { return; }
+
+    std::lock_guard<std::mutex> lock(admission_mutex);
+    const bool admit_all = admission_policy.load(std::memory_order_relaxed) == MksAdmissionPolicy::DISABLED;
+    // The responses to released queries only show up in the estimate once they have been received, so reserve room
+    // for them up front; otherwise a single release would overshoot the threshold by the whole backlog's responses
+    const double window_capacity = static_cast<double>(bus_load.bitrate())
+                                   * std::chrono::duration<double>(bus_load.window()).count();
+    double reserved = 0;
+    while (!deferred_commands.empty()) {
+        if (!admit_all && window_capacity > 0
+            && bus_load.utilisation() + reserved / window_capacity >= admission_threshold.load(std::memory_order_relaxed)) {
+            break;
+        }
+        const DeferredCommand& command = deferred_commands.front();
+        reserved += standardFrameBits(CanFrame::MAX_LENGTH);
+        if (!enqueue(command.motor, command.type, command.payload.data(), command.length)) {
+            BOOST_LOG_TRIVIAL(warning) << "MksStepperController dropped deferred command after send timeout: motor=0x"
+                                       << std::hex << command.motor << std::dec;
+        }
+        deferred_commands.pop_front();
+    }
+    has_deferred.store(!deferred_commands.empty(), std::memory_order_release);
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::setAdmissionControl(const double threshold, const MksAdmissionPolicy policy) {
+    {
+        std::lock_guard<std::mutex> lock(admission_mutex);
+        admission_threshold.store(threshold, std::memory_order_relaxed);
+        admission_policy.store(policy, std::memory_order_release);
+    }
+    releaseDeferred();
+}
+
+template <typename Transport>
+MksAdmissionStats BasicMksStepperController<Transport>::getAdmissionStats() const {
+    MksAdmissionStats stats;
+    stats.bus_load = bus_load.utilisation();
+    stats.refused = admission_refused.load(std::memory_order_relaxed);
+    stats.deferred = admission_deferred.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(admission_mutex);
+    stats.waiting = deferred_commands.size();
+    return stats;
+}
+
+template <typename Transport>
+BusLoadEstimator& BasicMksStepperController<Transport>::busLoad() { return bus_load; }
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::enqueue(
+        const uint16_t motor, const MksEvent::Type type, const uint8_t* payload, const size_t length,
+        const std::chrono::steady_clock::time_point deadline
+) {
+    const uint16_t slot = motor_index.slot(motor);
+    // Motors we don't listen to never release their window, so they bypass it
+    if (!window_enabled.load(std::memory_order_acquire) || slot == MotorIndex::NO_SLOT) {
+        return transmit(motor, payload, length);
+    }
+
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    MotorPipeline& pipeline = pipelines[slot];
+    const auto now = std::chrono::steady_clock::now();
+    // Stops aren't queued by the driver, so they don't wait behind the commands they are meant to cut short; they
+    // still enter the window so that their response is matched
+    const bool stop = isStopCommand(payload, length);
+    if (stop) { discardQueuedMotion(pipeline); }
+    // Commands already waiting go first, so that the motor still sees commands in the order they were issued
+    if (stop || (pipeline.queue.empty() && (window_depth == 0 || pipeline.in_flight.size() < window_depth))) {
+        if (!transmit(motor, payload, length)) { return false; }
+        pipeline.in_flight.push_back({ type, now, stop });
+        ++pipeline.stats.sent;
+        return true;
+    }
+
+    // A streamed setpoint supersedes the one still waiting, rather than queueing behind it, so that a lagging window
+    // delays the stream by at most one setpoint instead of an ever-growing backlog
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        const size_t before = pipeline.queue.size();
+        pipeline.queue.erase(
+                std::remove_if(
+                        pipeline.queue.begin(), pipeline.queue.end(),
+                        [](const QueuedCommand& command) {
+                            return command.deadline != std::chrono::steady_clock::time_point::max();
+                        }
+                ),
+                pipeline.queue.end()
+        );
+        stream_replaced.fetch_add(before - pipeline.queue.size(), std::memory_order_relaxed);
+    }
+    queueCommand(pipeline, type, payload, length, now, deadline);
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::discardQueuedMotion(MotorPipeline& pipeline) {
+    const size_t before = pipeline.queue.size();
+    pipeline.queue.erase(
+            std::remove_if(
+                    pipeline.queue.begin(), pipeline.queue.end(),
+                    [](const QueuedCommand& command) { return isMotionCommand(command.payload.data(), command.length); }
+            ),
+            pipeline.queue.end()
+    );
+    transmit_superseded.fetch_add(before - pipeline.queue.size(), std::memory_order_relaxed);
+    // The stop cuts short whatever is moving, so no final response will arrive for it
+    pipeline.moves_in_progress = 0;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::queueCommand(
+        MotorPipeline& pipeline, const MksEvent::Type type, const uint8_t* payload, const size_t length,
+        const std::chrono::steady_clock::time_point time, const std::chrono::steady_clock::time_point deadline
+) {
+    QueuedCommand command{};
+    command.type = type;
+    command.length = static_cast<uint8_t>(std::min(length, command.payload.size()));
+    std::copy_n(payload, command.length, command.payload.begin());
+    command.queued = time;
+    command.sequence = transmit_sequence.fetch_add(1, std::memory_order_relaxed);
+    command.deadline = deadline;
+    pipeline.queue.push_back(command);
+    pipeline.stats.max_queued = std::max(pipeline.stats.max_queued, pipeline.queue.size());
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::transmitQueued(const uint16_t motor, MotorPipeline& pipeline) {
+    const auto now = std::chrono::steady_clock::now();
+    while (!pipeline.queue.empty() && (window_depth == 0 || pipeline.in_flight.size() < window_depth)) {
+        const QueuedCommand& command = pipeline.queue.front();
+        // emergencyStopAll can't take the lock to discard motion commands, so they are caught on their way out
+        if (isMotionCommand(command.payload.data(), command.length)
+            && command.sequence < stop_sequences[motor % STANDARD_ID_COUNT].load(std::memory_order_relaxed)) {
+            transmit_superseded.fetch_add(1, std::memory_order_relaxed);
+            pipeline.queue.pop_front();
+            continue;
+        }
+        // A setpoint which waited out its deadline would only be sent late
+        if (now > command.deadline) {
+            stream_expired.fetch_add(1, std::memory_order_relaxed);
+            pipeline.queue.pop_front();
+            continue;
+        }
+        if (transmit(motor, command.payload.data(), command.length)) {
+            pipeline.in_flight.push_back({ command.type, now });
+            ++pipeline.stats.sent;
+        } else {
+            BOOST_LOG_TRIVIAL(warning) << "MksStepperController dropped queued command after send timeout: motor=0x"
+                                       << std::hex << motor << std::dec;
+        }
+
+        const auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(now - command.queued);
+        ++pipeline.stats.deferred;
+        pipeline.stats.total_wait += wait;
+        pipeline.stats.max_wait = std::max(pipeline.stats.max_wait, wait);
+        pipeline.queue.pop_front();
+    }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::releaseInFlight(const MksEvent& event) {
+    if (!window_enabled.load(std::memory_order_acquire)) { return; }
+    const uint16_t slot = motor_index.slot(event.motor);
+    if (slot == MotorIndex::NO_SLOT) { return; }
+
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    MotorPipeline& pipeline = pipelines[slot];
+    const auto command = std::find_if(pipeline.in_flight.begin(), pipeline.in_flight.end(), [&event](const auto& sent) {
+        return sent.type == event.type;
+    });
+    const bool is_move = event.type == MksEvent::Type::SEND_STEP || event.type == MksEvent::Type::SEEK_POSITION;
+
+    if (is_move) {
+        // Acknowledging a stop means every move before it was abandoned, and won't send a final response
+        if (command != pipeline.in_flight.end() && command->stop) { pipeline.moves_in_progress = 0; }
+        if (event.status == MksMoveResponse::MOVING) {
+            ++pipeline.moves_in_progress;
+        } else if (pipeline.moves_in_progress > 0
+                   && (event.status != MksMoveResponse::FAILED || command == pipeline.in_flight.end())) {
+            // The final response to a move which was already acknowledged, so it doesn't free up any room
+            --pipeline.moves_in_progress;
+            return;
+        }
+    }
+    if (command == pipeline.in_flight.end()) { return; }
+
+    pipeline.in_flight.erase(command);
+    transmitQueued(event.motor, pipeline);
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::expireInFlight() {
+    if (!window_enabled.load(std::memory_order_acquire)) { return; }
+
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    for (size_t slot = 0; slot < motor_index.size(); ++slot) {
+        MotorPipeline& pipeline = pipelines[slot];
+        const size_t before = pipeline.in_flight.size();
+        // Commands are sent in order, so the oldest are at the front
+        while (!pipeline.in_flight.empty() && now - pipeline.in_flight.front().sent >= window_timeout) {
+            pipeline.in_flight.pop_front();
+            ++pipeline.stats.timeouts;
+        }
+        if (pipeline.in_flight.size() != before) {
+            transmitQueued(motor_index.motor(static_cast<uint16_t>(slot)), pipeline);
+        }
+    }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::setInFlightWindow(
+        const size_t depth, const std::chrono::nanoseconds& response_timeout
+) {
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    window_depth = depth;
+    window_timeout = response_timeout;
+    // Release anything which fits in the new window; with the window disabled, that is everything
+    for (size_t slot = 0; slot < motor_index.size(); ++slot) {
+        MotorPipeline& pipeline = pipelines[slot];
+        transmitQueued(motor_index.motor(static_cast<uint16_t>(slot)), pipeline);
+        if (depth == 0) {
+            pipeline.in_flight.clear();
+            pipeline.moves_in_progress = 0;
+        }
+    }
+    window_enabled.store(depth != 0, std::memory_order_release);
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::getPipelineStats(const uint16_t motor, MksPipelineStats& stats) const {
+    const uint16_t slot = motor_index.slot(motor);
+    if (slot == MotorIndex::NO_SLOT) { return false; }
+
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    const MotorPipeline& pipeline = pipelines[slot];
+    stats = pipeline.stats;
+    stats.in_flight = pipeline.in_flight.size();
+    stats.queued = pipeline.queue.size();
+    return true;
+}
+
+template <typename Transport>
+std::future<typename BasicMksStepperController<Transport>::Response> BasicMksStepperController<Transport>::requestSetSpeed(
+        const uint16_t motor, const int16_t speed, const uint8_t acceleration, const std::chrono::nanoseconds& timeout
+) {
+    Request request = beginRequest(motor, MksEvent::Type::SET_SPEED, MksCompletion::ACKNOWLEDGED, timeout);
+    if (!setSpeed(motor, speed, acceleration)) { cancelRequest(request.id); }
+    return std::move(request.response);
+}
+
+template <typename Transport>
+std::future<typename BasicMksStepperController<Transport>::Response> BasicMksStepperController<Transport>::requestSendStep(
+        const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration,
+        const MksCompletion completion, const std::chrono::nanoseconds& timeout
+) {
+    Request request = beginRequest(motor, MksEvent::Type::SEND_STEP, completion, timeout);
+    if (!sendStep(motor, num_steps, speed, acceleration)) { cancelRequest(request.id); }
+    return std::move(request.response);
+}
+
+template <typename Transport>
+std::future<typename BasicMksStepperController<Transport>::Response>
+BasicMksStepperController<Transport>::requestSeekPosition(
+        const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration,
+        const MksCompletion completion, const std::chrono::nanoseconds& timeout
+) {
+    Request request = beginRequest(motor, MksEvent::Type::SEEK_POSITION, completion, timeout);
+    if (!seekPosition(motor, position, speed, acceleration)) { cancelRequest(request.id); }
+    return std::move(request.response);
+}
+
+template <typename Transport>
+std::future<typename BasicMksStepperController<Transport>::Response>
+BasicMksStepperController<Transport>::requestPosition(const uint16_t motor, const std::chrono::nanoseconds& timeout) {
+    Request request = beginRequest(motor, MksEvent::Type::GET_POSITION, MksCompletion::ACKNOWLEDGED, timeout);
+    if (!getPosition(motor)) { cancelRequest(request.id); }
+    return std::move(request.response);
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Response BasicMksStepperController<Transport>::setSpeedAndWait(
+        const uint16_t motor, const int16_t speed, const uint8_t acceleration, const std::chrono::nanoseconds& timeout
+) {
+    Request request = beginRequest(motor, MksEvent::Type::SET_SPEED, MksCompletion::ACKNOWLEDGED, timeout);
+    if (!setSpeed(motor, speed, acceleration)) { cancelRequest(request.id); }
+    return awaitRequest(request);
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Response BasicMksStepperController<Transport>::sendStepAndWait(
+        const uint16_t motor, const uint32_t num_steps, const int16_t speed, const uint8_t acceleration,
+        const MksCompletion completion, const std::chrono::nanoseconds& timeout
+) {
+    Request request = beginRequest(motor, MksEvent::Type::SEND_STEP, completion, timeout);
+    if (!sendStep(motor, num_steps, speed, acceleration)) { cancelRequest(request.id); }
+    return awaitRequest(request);
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Response BasicMksStepperController<Transport>::seekPositionAndWait(
+        const uint16_t motor, const int32_t position, const int16_t speed, const uint8_t acceleration,
+        const MksCompletion completion, const std::chrono::nanoseconds& timeout
+) {
+    Request request = beginRequest(motor, MksEvent::Type::SEEK_POSITION, completion, timeout);
+    if (!seekPosition(motor, position, speed, acceleration)) { cancelRequest(request.id); }
+    return awaitRequest(request);
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Response
+BasicMksStepperController<Transport>::getPositionAndWait(const uint16_t motor, const std::chrono::nanoseconds& timeout) {
+    Request request = beginRequest(motor, MksEvent::Type::GET_POSITION, MksCompletion::ACKNOWLEDGED, timeout);
+    if (!getPosition(motor)) { cancelRequest(request.id); }
+    return awaitRequest(request);
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Request BasicMksStepperController<Transport>::beginRequest(
+        const uint16_t motor, const MksEvent::Type type, const MksCompletion completion,
+        const std::chrono::nanoseconds& timeout
+) {
+    const auto deadline = std::chrono::steady_clock::now()
+                          + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+
+    std::lock_guard<std::mutex> lock(request_mutex);
+    const uint64_t id = next_request_id++;
+    PendingRequest& pending = pending_requests.emplace_back();
+    pending.id = id;
+    pending.motor = motor;
+    pending.type = type;
+    pending.completion = completion;
+    pending.acknowledged = false;
+    pending.deadline = deadline;
+    pending_request_count.store(pending_requests.size(), std::memory_order_release);
+    return { id, deadline, pending.promise.get_future() };
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::cancelRequest(const uint64_t id) {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    const auto pending = std::find_if(pending_requests.begin(), pending_requests.end(), [id](const auto& request) {
+        return request.id == id;
+    });
+    // Already completed
+    if (pending == pending_requests.end()) { return; }
+
+    pending->promise.set_value(std::nullopt);
+    pending_requests.erase(pending);
+    pending_request_count.store(pending_requests.size(), std::memory_order_release);
+}
+
+template <typename Transport>
+typename BasicMksStepperController<Transport>::Response
+BasicMksStepperController<Transport>::awaitRequest(Request& request) {
+    if (request.response.wait_until(request.deadline) != std::future_status::ready) {
+        // Completes the future with std::nullopt, unless the response slipped in just now
+        cancelRequest(request.id);
+    }
+    return request.response.get();
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::resolveRequests(const MksEvent& event) {
+    if (pending_request_count.load(std::memory_order_acquire) == 0) { return; }
+
+    const bool is_move = event.type == MksEvent::Type::SEND_STEP || event.type == MksEvent::Type::SEEK_POSITION;
+    const bool still_moving = is_move && event.status == MksMoveResponse::MOVING;
+
+    std::lock_guard<std::mutex> lock(request_mutex);
+    for (auto pending = pending_requests.begin(); pending != pending_requests.end(); ++pending) {
+        if (pending->motor != event.motor || pending->type != event.type) { continue; }
+
+        if (pending->completion == MksCompletion::FINISHED && still_moving) {
+            // A MOVING response acknowledges the oldest move which hasn't been acknowledged yet
+            if (pending->acknowledged) { continue; }
+            pending->acknowledged = true;
+            return;
+        }
+
+        pending->promise.set_value(event);
+        pending_requests.erase(pending);
+        pending_request_count.store(pending_requests.size(), std::memory_order_release);
+        return;
+    }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::expireRequests() {
+    if (pending_request_count.load(std::memory_order_acquire) == 0) { return; }
+
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(request_mutex);
+    const auto expired = std::remove_if(pending_requests.begin(), pending_requests.end(), [now](auto& request) {
+        if (request.deadline > now) { return false; }
+        request.promise.set_value(std::nullopt);
+        return true;
+    });
+    pending_requests.erase(expired, pending_requests.end());
+    pending_request_count.store(pending_requests.size(), std::memory_order_release);
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::enableReceiveTimestamps(const CanTimestampMode mode) {
+    if (!can_receiver->enableTimestamps(mode)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController failed to enable receive timestamps, errno="
+                                   << can_receiver->lastError();
+        return false;
+    }
+    return true;
+}
+
+template <typename Transport>
+std::chrono::steady_clock::time_point
+BasicMksStepperController<Transport>::eventTimestamp() const { return dispatching_timestamp; }
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::startReceiveThread() {
+    if (receive_thread.joinable()) { return false; }
+    queue_events = true;
+    receive_thread_running = true;
+    receive_thread = std::thread(&BasicMksStepperController::receiveLoop, this);
+    applyRealtime(MksThread::RECEIVE, receive_thread);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController receive thread started";
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::stopReceiveThread() {
+    if (!receive_thread.joinable()) { return; }
+    receive_thread_running = false;
+    receive_thread.join();
+    queue_events = false;
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController receive thread stopped";
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::startPolling(const MksPollSchedule& schedule) {
+    if (poll_thread.joinable()) { return false; }
+
+    // Worst-case bus time of each query and its response, see MksCommands for the response formats
+    constexpr std::array<uint32_t, POLL_QUERY_COUNT> QUERY_BITS{
+        standardFrameBits(2) + standardFrameBits(6),
+        standardFrameBits(2) + standardFrameBits(3),
+        standardFrameBits(2) + standardFrameBits(3),
+    };
+    const std::array<double, POLL_QUERY_COUNT> rates{ schedule.position_rate, schedule.status_rate, schedule.io_rate };
+
+    double load = 0;
+    for (size_t query = 0; query < POLL_QUERY_COUNT; ++query) {
+        load += static_cast<double>(motor_index.size()) * std::max(rates[query], 0.0) * QUERY_BITS[query];
+    }
+    if (load <= 0) { return false; }
+    const double budget = std::clamp(schedule.max_bus_load, 0.0, 1.0) * schedule.bitrate;
+
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex);
+        poll_schedule = schedule;
+        poll_scale = std::min(1.0, budget / load);
+        poll_start = std::chrono::steady_clock::now();
+    }
+    if (load > budget) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController polling would use " << 100 * load / schedule.bitrate
+                                   << "% of the bus, scaling rates down by " << budget / load << " to fit within "
+                                   << 100 * schedule.max_bus_load << "%";
+    }
+    for (size_t query = 0; query < POLL_QUERY_COUNT; ++query) {
+        poll_issued[query] = 0;
+        poll_skipped[query] = 0;
+        poll_failed[query] = 0;
+        poll_responses[query] = 0;
+    }
+
+    polling = true;
+    poll_thread = std::thread(&BasicMksStepperController::pollLoop, this);
+    applyRealtime(MksThread::POLL, poll_thread);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController polling started";
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::stopPolling() {
+    if (!poll_thread.joinable()) { return; }
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex);
+        polling = false;
+    }
+    poll_wakeup.notify_all();
+    poll_thread.join();
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex);
+        poll_stop = std::chrono::steady_clock::now();
+    }
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController polling stopped";
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::isPolling() const { return polling; }
+
+template <typename Transport>
+MksPollStats BasicMksStepperController<Transport>::getPollStats(const MksPollQuery query) const {
+    const auto index = static_cast<size_t>(query);
+    MksPollStats stats;
+    std::chrono::duration<double> elapsed{};
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex);
+        const std::array<double, POLL_QUERY_COUNT> rates{
+            poll_schedule.position_rate, poll_schedule.status_rate, poll_schedule.io_rate
+        };
+        stats.requested_rate = std::max(rates[index], 0.0);
+        stats.scheduled_rate = stats.requested_rate * poll_scale;
+        elapsed = (polling ? std::chrono::steady_clock::now() : poll_stop) - poll_start;
+    }
+    stats.issued = poll_issued[index];
+    stats.skipped = poll_skipped[index];
+    stats.failed = poll_failed[index];
+
+    const double motor_seconds = elapsed.count() * static_cast<double>(motor_index.size());
+    if (motor_seconds > 0) {
+        stats.achieved_rate = static_cast<double>(stats.issued) / motor_seconds;
+        stats.response_rate = static_cast<double>(poll_responses[index]) / motor_seconds;
+    }
+    return stats;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::startStreaming(const MksStreamConfig& config) {
+    if (stream_thread.joinable() || config.rate <= 0) { return false; }
+
+    stream_timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (stream_timer < 0) {
+        BOOST_LOG_TRIVIAL(error) << "MksStepperController failed to create streaming timer, errno=" << errno;
+        return false;
+    }
+
+    stream_rate = config.rate;
+    stream_max_age = config.max_age.count();
+    stream_ticks = 0;
+    stream_missed = 0;
+    stream_sent = 0;
+    stream_unchanged = 0;
+    stream_stale = 0;
+    stream_replaced = 0;
+    stream_expired = 0;
+    stream_failed = 0;
+    stream_total_jitter = 0;
+    stream_max_jitter = 0;
+
+    streaming = true;
+    stream_thread = std::thread(&BasicMksStepperController::streamLoop, this);
+    applyRealtime(MksThread::STREAM, stream_thread);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController streaming started at " << config.rate << " Hz";
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::stopStreaming() {
+    if (!stream_thread.joinable()) { return; }
+    streaming = false;
+    // Fire the timer right away, rather than waiting out the rest of the period
+    const itimerspec wake{ {}, { 0, 1 } };
+    timerfd_settime(stream_timer, 0, &wake, nullptr);
+    stream_thread.join();
+    close(stream_timer);
+    stream_timer = -1;
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController streaming stopped";
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::isStreaming() const { return streaming; }
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::streamSpeed(
+        const uint16_t motor, const int16_t speed, const uint8_t acceleration,
+        const std::chrono::steady_clock::time_point deadline
+) {
+    const uint16_t slot = motor_index.slot(motor);
+    if (slot == MotorIndex::NO_SLOT) { return false; }
+
+    const auto expiry = deadline == std::chrono::steady_clock::time_point{}
+                                ? std::chrono::steady_clock::now()
+                                          + std::chrono::nanoseconds(stream_max_age.load(std::memory_order_relaxed))
+                                : deadline;
+    const auto offset = std::chrono::duration_cast<StreamDeadlineUnit>(expiry - stream_epoch).count() + 1;
+    const auto packed_deadline = static_cast<uint64_t>(std::clamp<int64_t>(offset, 1, STREAM_DEADLINE_MAX));
+    const uint64_t word = packed_deadline << STREAM_DEADLINE_SHIFT | static_cast<uint64_t>(acceleration) << 16
+                          | static_cast<uint16_t>(speed);
+    stream_mailboxes[slot].store(word, std::memory_order_release);
+    return true;
+}
+
+template <typename Transport>
+MksStreamStats BasicMksStepperController<Transport>::getStreamStats() const {
+    MksStreamStats stats;
+    stats.ticks = stream_ticks;
+    stats.missed_ticks = stream_missed;
+    stats.sent = stream_sent;
+    stats.unchanged = stream_unchanged;
+    stats.stale = stream_stale;
+    stats.replaced = stream_replaced;
+    stats.expired = stream_expired;
+    stats.failed = stream_failed;
+    if (stats.ticks > 0) {
+        stats.mean_jitter = std::chrono::nanoseconds(stream_total_jitter / static_cast<int64_t>(stats.ticks));
+    }
+    stats.max_jitter = std::chrono::nanoseconds(stream_max_jitter);
+    return stats;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::streamLoop() {
+    prefaultStack(realtime_options.prefault_stack);
+    const auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1 / stream_rate));
+    const auto start = std::chrono::steady_clock::now();
+
+    // Absolute expiries, so that the rate doesn't drift with how long each tick takes; steady_clock is
+    // CLOCK_MONOTONIC on Linux, so its time points can be handed to the timer directly
+    const auto to_timespec = [](const std::chrono::nanoseconds& time) {
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(time);
+        return timespec{ static_cast<time_t>(seconds.count()), static_cast<long>((time - seconds).count()) };
+    };
+    const itimerspec schedule{ to_timespec(period), to_timespec(start.time_since_epoch() + period) };
+    if (timerfd_settime(stream_timer, TFD_TIMER_ABSTIME, &schedule, nullptr) < 0) {
+        BOOST_LOG_TRIVIAL(error) << "MksStepperController failed to arm streaming timer, errno=" << errno;
+        streaming = false;
+        return;
+    }
+
+    // Mailbox words already handled, and the command last sent to each motor; only this thread touches either
+    const size_t motors = motor_index.size();
+    std::vector<uint64_t> last_seen(motors, 0);
+    std::vector<uint64_t> last_sent(motors, ~uint64_t{ 0 });
+    // A stop for the motor, or a frame dropped by the transmit thread, means the last command sent may no longer be in
+    // effect, so it is forgotten and sent again if it is posted again
+    std::vector<uint64_t> last_stop(motors);
+    for (size_t slot = 0; slot < motors; ++slot) {
+        last_stop[slot] = stop_sequences[motor_index.motor(static_cast<uint16_t>(slot)) % STANDARD_ID_COUNT].load(
+                std::memory_order_relaxed
+        );
+    }
+    uint64_t last_dropped = transmit_failed.load(std::memory_order_relaxed)
+                            + transmit_rejected.load(std::memory_order_relaxed)
+                            + stream_expired.load(std::memory_order_relaxed);
+
+    uint64_t due_ticks = 0;
+    while (streaming.load(std::memory_order_relaxed)) {
+        uint64_t expirations = 0;
+        if (read(stream_timer, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            if (errno == EINTR) { continue; }
+            BOOST_LOG_TRIVIAL(error) << "MksStepperController streaming timer failed, errno=" << errno;
+            break;
+        }
+        if (!streaming.load(std::memory_order_relaxed)) { break; }
+
+        const auto now = std::chrono::steady_clock::now();
+        due_ticks += expirations;
+        const auto jitter = std::max(now - (start + period * static_cast<int64_t>(due_ticks)), {});
+        const int64_t jitter_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(jitter).count();
+        stream_total_jitter.fetch_add(jitter_ns, std::memory_order_relaxed);
+        if (jitter_ns > stream_max_jitter.load(std::memory_order_relaxed)) {
+            stream_max_jitter.store(jitter_ns, std::memory_order_relaxed);
+        }
+        // Several expirations mean the thread slept through whole ticks; they are gone, not made up
+        stream_missed.fetch_add(expirations - 1, std::memory_order_relaxed);
+        stream_ticks.fetch_add(1, std::memory_order_relaxed);
+
+        // Drops aren't attributed to motors, so any of them invalidates every motor's last command
+        const uint64_t dropped = transmit_failed.load(std::memory_order_relaxed)
+                                 + transmit_rejected.load(std::memory_order_relaxed)
+                                 + stream_expired.load(std::memory_order_relaxed);
+        if (dropped != last_dropped) {
+            last_dropped = dropped;
+            std::fill(last_sent.begin(), last_sent.end(), ~uint64_t{ 0 });
+        }
+
+        const auto now_offset = std::chrono::duration_cast<StreamDeadlineUnit>(now - stream_epoch).count() + 1;
+        for (size_t slot = 0; slot < motors; ++slot) {
+            const uint16_t motor = motor_index.motor(static_cast<uint16_t>(slot));
+            const uint64_t stop = stop_sequences[motor % STANDARD_ID_COUNT].load(std::memory_order_relaxed);
+            if (stop != last_stop[slot]) {
+                last_stop[slot] = stop;
+                last_sent[slot] = ~uint64_t{ 0 };
+            }
+
+            const uint64_t word = stream_mailboxes[slot].load(std::memory_order_acquire);
+            if (word == last_seen[slot]) { continue; }
+            last_seen[slot] = word;
+            // Cleared by emergencyStopAll, which leaves no setpoint rather than a stale one
+            if (word == 0) { continue; }
+
+            const auto deadline_offset = static_cast<int64_t>(word >> STREAM_DEADLINE_SHIFT);
+            if (deadline_offset < now_offset) {
+                stream_stale.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            const uint64_t command = word & STREAM_COMMAND_MASK;
+            if (command == last_sent[slot]) {
+                stream_unchanged.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            const auto speed = static_cast<int16_t>(command & 0xFFFF);
+            const auto acceleration = static_cast<uint8_t>(command >> 16);
+            const auto normalised_speed = static_cast<int16_t>(std::abs(speed) * (int32_t)16 / norm_factor);
+            const auto deadline = stream_epoch + StreamDeadlineUnit(deadline_offset);
+            if (submit(motor, MksEvent::Type::SET_SPEED,
+                       encoders[slot].setSpeed(normalised_speed, speed > 0, acceleration), deadline)) {
+                last_sent[slot] = command;
+                stream_sent.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                stream_failed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::pollLoop() {
+    prefaultStack(realtime_options.prefault_stack);
+    struct PollTask {
+        uint16_t motor;
+        MksPollQuery query;
+        std::chrono::steady_clock::duration period;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    std::vector<PollTask> tasks;
+    std::chrono::steady_clock::time_point start;
+    {
+        std::lock_guard<std::mutex> lock(poll_mutex);
+        const std::array<double, POLL_QUERY_COUNT> rates{
+            poll_schedule.position_rate, poll_schedule.status_rate, poll_schedule.io_rate
+        };
+        for (size_t query = 0; query < POLL_QUERY_COUNT; ++query) {
+            const double rate = rates[query] * poll_scale;
+            if (rate <= 0) { continue; }
+            const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / rate)
+            );
+            for (const uint16_t motor : motor_index.motors()) {
+                tasks.push_back({ motor, static_cast<MksPollQuery>(query), period, {} });
+            }
+        }
+        start = poll_start;
+    }
+
+    // Stagger the first deadlines so that each task's queries are spread evenly across its period, interleaved with
+    // every other task's, rather than every motor being queried at once
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].due = start + tasks[i].period * static_cast<int64_t>(i) / static_cast<int64_t>(tasks.size());
+    }
+
+    std::unique_lock<std::mutex> lock(poll_mutex);
+    while (polling) {
+        auto next = std::min_element(tasks.begin(), tasks.end(), [](const PollTask& a, const PollTask& b) {
+            return a.due < b.due;
+        });
+        // Absolute deadlines on the monotonic clock, so that the rate doesn't drift with how long each query takes
+        if (poll_wakeup.wait_until(lock, next->due, [this]() { return !polling; })) { break; }
+        lock.unlock();
+
+        const auto index = static_cast<size_t>(next->query);
+        const auto now = std::chrono::steady_clock::now();
+        if (now - next->due >= next->period) {
+            // Skip the queries we missed instead of sending them back to back, which would only flood the bus
+            const auto missed = (now - next->due) / next->period;
+            next->due += next->period * missed;
+            poll_skipped[index] += static_cast<uint64_t>(missed);
+        }
+
+        bool sent = false;
+        switch (next->query) {
+            case MksPollQuery::POSITION: sent = getPosition(next->motor); break;
+            case MksPollQuery::STATUS: sent = getStatus(next->motor); break;
+            case MksPollQuery::IO_STATUS: sent = getIoStatus(next->motor); break;
+        }
+        if (sent) {
+            ++poll_issued[index];
+        } else {
+            ++poll_failed[index];
+        }
+        next->due += next->period;
+
+        lock.lock();
+    }
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::isReceiveThreadRunning() const { return receive_thread_running; }
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::popEvent(MksEvent& event) { return event_queue->pop(event); }
+
+template <typename Transport>
+size_t BasicMksStepperController<Transport>::pollEvents(const size_t max_events) {
+    size_t processed = 0;
+    MksEvent event;
+    while (processed < max_events && event_queue->pop(event)) {
+        dispatchEvent(event);
+        ++processed;
+    }
+    return processed;
+}
+
+template <typename Transport>
+uint64_t BasicMksStepperController<Transport>::droppedEvents() const { return dropped_events; }
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::applyRealtime(const MksThread thread, std::thread& handle) {
+    const RealtimeStatus status = applyThreadRealtime(handle, realtime_options);
+    if (status.scheduling == RealtimeResult::FAILED || status.affinity == RealtimeResult::FAILED) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController failed to apply real-time options to thread "
+                                   << static_cast<int>(thread) << ", errno=" << status.error;
+    }
+    std::lock_guard<std::mutex> lock(realtime_mutex);
+    thread_realtime[static_cast<size_t>(thread)] = status;
+}
+
+template <typename Transport>
+RealtimeStatus BasicMksStepperController<Transport>::getRealtimeStatus(const MksThread thread) const {
+    RealtimeStatus status = process_realtime;
+    {
+        std::lock_guard<std::mutex> lock(realtime_mutex);
+        const RealtimeStatus& applied = thread_realtime[static_cast<size_t>(thread)];
+        status.scheduling = applied.scheduling;
+        status.affinity = applied.affinity;
+        if (applied.error != 0) { status.error = applied.error; }
+    }
+    // Touching the stack can't fail short of overflowing it, so only a failed heap prefault counts against it
+    if (realtime_options.prefault_stack > 0 && status.prefault == RealtimeResult::NOT_REQUESTED) {
+        status.prefault = RealtimeResult::APPLIED;
+    }
+    return status;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::receiveLoop() {
+    prefaultStack(realtime_options.prefault_stack);
+    // The timeout only bounds how long it takes to notice a stop request, frames are handled as soon as they arrive
+    constexpr auto STOP_POLL_TIMEOUT = std::chrono::milliseconds(10);
+    while (receive_thread_running.load(std::memory_order_relaxed)) { drain(DEFAULT_DRAIN_LIMIT, STOP_POLL_TIMEOUT); }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::transmitLoop() {
+    prefaultStack(realtime_options.prefault_stack);
+
+    // Frames taken from each lane which the kernel hasn't accepted yet, oldest first; only this thread touches them
+    std::array<TransmitEntry, Transport::MAX_BATCH> priority_staged{};
+    std::array<TransmitEntry, Transport::MAX_BATCH> normal_staged{};
+    size_t priority_count = 0;
+    size_t normal_count = 0;
+    std::chrono::steady_clock::time_point retry_at{};
+
+    for (;;) {
+        while (priority_count < priority_staged.size() && priority_lane->pop(priority_staged[priority_count])) {
+            ++priority_count;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= retry_at) {
+            if (priority_count > 0) { priority_count = sendStaged(priority_staged.data(), priority_count, true); }
+            // Ordinary frames only go out once every stop has, so that no backlog can hold a stop up
+            if (priority_count == 0 && priority_lane->empty()) {
+                while (normal_count < normal_staged.size() && normal_lane->pop(normal_staged[normal_count])) {
+                    ++normal_count;
+                }
+                if (normal_count > 0) { normal_count = sendStaged(normal_staged.data(), normal_count, false); }
+            }
+            // Anything left over was refused, so give the interface's queue a moment to drain
+            if (priority_count > 0 || normal_count > 0) { retry_at = now + TRANSMIT_RETRY_INTERVAL; }
+        }
+
+        if (priority_count > 0 || normal_count > 0) {
+            // The kernel won't take anything, stops included, until its queue drains
+            std::this_thread::sleep_until(retry_at);
+        } else if (priority_lane->empty() && normal_lane->empty()) {
+            if (!transmitting.load(std::memory_order_acquire)) { break; }
+            waitForFrames();
+        }
+    }
+}
+
+template <typename Transport>
+size_t BasicMksStepperController<Transport>::sendStaged(TransmitEntry* staged, const size_t count, const bool priority) {
+    const auto now = std::chrono::steady_clock::now();
+
+    // Drop what has waited too long, or has been overtaken by a stop for the same motor
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const TransmitEntry& entry = staged[i];
+        if (!priority && isMotionCommand(entry.payload.data(), entry.length)
+            && entry.sequence < stop_sequences[entry.id % STANDARD_ID_COUNT].load(std::memory_order_relaxed)) {
+            transmit_superseded.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (now - entry.queued >= TRANSMIT_TIMEOUT) {
+            transmit_failed.fetch_add(1, std::memory_order_relaxed);
+            BOOST_LOG_TRIVIAL(warning) << "MksStepperController dropped frame after send timeout: id=0x" << std::hex
+                                       << entry.id << std::dec << ", command=0x" << std::hex
+                                       << static_cast<uint16_t>(entry.payload[0]) << std::dec;
+            continue;
+        }
+        staged[kept++] = entry;
+    }
+    if (kept == 0) { return 0; }
+
+    std::array<CanFrame, Transport::MAX_BATCH> frames;
+    for (size_t i = 0; i < kept; ++i) {
+        frames[i].id = staged[i].id;
+        frames[i].length = staged[i].length;
+        frames[i].data = staged[i].payload;
+    }
+    const size_t sent = can_sender->sendBatch(frames.data(), kept);
+
+    const auto sent_time = std::chrono::steady_clock::now();
+    std::atomic<int64_t>& max_latency = priority ? transmit_max_priority_latency : transmit_max_latency;
+    for (size_t i = 0; i < sent; ++i) {
+        recordTransmitted(staged[i].id, staged[i].payload.data(), staged[i].length, sent_time);
+        const int64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(sent_time - staged[i].queued).count();
+        // Only this thread writes the maxima, so there is no need for a compare-and-swap
+        if (latency > max_latency.load(std::memory_order_relaxed)) { max_latency.store(latency, std::memory_order_relaxed); }
+    }
+    transmit_sent.fetch_add(sent, std::memory_order_relaxed);
+    if (priority) { transmit_priority_sent.fetch_add(sent, std::memory_order_relaxed); }
+
+    // emergencyStopAll sends on its own socket without waiting for this thread, so it may have landed between the
+    // check above and sendBatch, putting a motion command it superseded on the bus after its stop; chase each such
+    // motor with another stop, on this socket so that it follows the command
+    const uint64_t emergency = emergency_sequence.load(std::memory_order_seq_cst);
+    std::array<CanFrame, Transport::MAX_BATCH> stops;
+    size_t stop_count = 0;
+    for (size_t i = 0; i < sent; ++i) {
+        const TransmitEntry& entry = staged[i];
+        if (priority || entry.sequence >= emergency || !isMotionCommand(entry.payload.data(), entry.length)) { continue; }
+        const auto stopped = [&entry](const CanFrame& stop) { return stop.id == entry.id; };
+        if (std::any_of(stops.begin(), stops.begin() + static_cast<ptrdiff_t>(stop_count), stopped)) { continue; }
+        const MksPayload stop = MksEncoder(entry.id).query(MksCommands::EMERGENCY_STOP);
+        stops[stop_count].id = entry.id;
+        stops[stop_count].length = stop.length;
+        stops[stop_count].data = stop.data;
+        ++stop_count;
+    }
+    if (stop_count > 0) {
+        const size_t restopped = can_sender->sendBatch(stops.data(), stop_count, TRANSMIT_TIMEOUT);
+        const auto stop_time = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < restopped; ++i) {
+            recordTransmitted(static_cast<uint16_t>(stops[i].id), stops[i].data.data(), stops[i].length, stop_time);
+        }
+        transmit_restopped.fetch_add(restopped, std::memory_order_relaxed);
+    }
+
+    std::copy(staged + sent, staged + kept, staged);
+    return kept - sent;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::waitForFrames() {
+    transmitter_idle.store(true, std::memory_order_relaxed);
+    // Pairs with the fence in wakeTransmitter, see there
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (priority_lane->empty() && normal_lane->empty() && transmitting.load(std::memory_order_relaxed)) {
+        pollfd event{ transmit_event, POLLIN, 0 };
+        poll(&event, 1, -1);
+    }
+    transmitter_idle.store(false, std::memory_order_relaxed);
+
+    // Reset the eventfd; it is non-blocking, so this is harmless if nothing was written
+    uint64_t signals = 0;
+    [[maybe_unused]] const ssize_t read_bytes = read(transmit_event, &signals, sizeof(signals));
+}
+
+template <typename Transport>
+MksTransmitStats BasicMksStepperController<Transport>::getTransmitStats() const {
+    MksTransmitStats stats;
+    stats.queued = priority_lane->size() + normal_lane->size();
+    stats.sent = transmit_sent.load(std::memory_order_relaxed);
+    stats.priority_sent = transmit_priority_sent.load(std::memory_order_relaxed);
+    stats.rejected = transmit_rejected.load(std::memory_order_relaxed);
+    stats.failed = transmit_failed.load(std::memory_order_relaxed);
+    stats.superseded = transmit_superseded.load(std::memory_order_relaxed);
+    stats.restopped = transmit_restopped.load(std::memory_order_relaxed);
+    stats.max_latency = std::chrono::nanoseconds(transmit_max_latency.load(std::memory_order_relaxed));
+    stats.max_priority_latency = std::chrono::nanoseconds(transmit_max_priority_latency.load(std::memory_order_relaxed));
+    return stats;
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::getMotorState(const uint16_t motor, MksMotorState& state) const {
+    const uint16_t slot = motor_index.slot(motor);
+    if (slot == MotorIndex::NO_SLOT) { return false; }
+    state = motor_states[slot].load();
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::setSignalsEnabled(const bool enabled) { signals_enabled = enabled; }
+
+template <typename Transport>
+FlightRecorder& BasicMksStepperController<Transport>::flightRecorder() { return flight_recorder; }
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::setFaultDumpPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(fault_dump_mutex);
+    fault_dump_path = path;
+    dump_on_fault = !path.empty();
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::checkFault(const MksEvent& event) {
+    if (!dump_on_fault.load(std::memory_order_relaxed)) { return; }
+
+    bool fault = false;
+    switch (event.type) {
+        case MksEvent::Type::SET_SPEED:
+        case MksEvent::Type::SET_GROUP_ID: fault = !event.succeeded; break;
+        case MksEvent::Type::SEND_STEP:
+        case MksEvent::Type::SEEK_POSITION: fault = event.status == MksMoveResponse::FAILED; break;
+        case MksEvent::Type::GET_POSITION:
+        case MksEvent::Type::GET_STATUS:
+        case MksEvent::Type::GET_IO_STATUS: break;
+    }
+    if (!fault) { return; }
+
+    std::lock_guard<std::mutex> lock(fault_dump_mutex);
+    if (fault_dump_path.empty()) { return; }
+    if (flight_recorder.dumpPcapng(fault_dump_path)) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController: fault reported by motor 0x" << std::hex << event.motor
+                                   << std::dec << ", flight recorder dumped to " << fault_dump_path;
+    } else {
+        BOOST_LOG_TRIVIAL(error) << "MksStepperController: fault reported by motor 0x" << std::hex << event.motor
+                                 << std::dec << ", failed to dump flight recorder to " << fault_dump_path;
+    }
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::setMotorIds(std::shared_ptr<const std::unordered_set<uint16_t>> motor_ids) {
+    if (receive_thread.joinable() || poll_thread.joinable() || stream_thread.joinable()) { return false; }
+    this->motor_ids = std::move(motor_ids);
+    applyMotorIds();
+    return true;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::applyMotorIds() {
+    {
+        // Don't lose commands which were waiting for room in the old windows
+        std::lock_guard<std::mutex> lock(pipeline_mutex);
+        for (size_t slot = 0; slot < motor_index.size(); ++slot) {
+            for (const QueuedCommand& command : pipelines[slot].queue) {
+                transmit(motor_index.motor(static_cast<uint16_t>(slot)), command.payload.data(), command.length);
+            }
+        }
+        motor_index = MotorIndex(*motor_ids);
+        pipelines = std::make_unique<MotorPipeline[]>(motor_index.size());
+    }
+    motor_states = std::make_unique<Seqlock<MksMotorState>[]>(motor_index.size());
+    encoders = std::make_unique<MksEncoder[]>(motor_index.size());
+    emergency_frames = std::make_unique<CanFrame[]>(motor_index.size());
+    for (size_t slot = 0; slot < motor_index.size(); ++slot) {
+        encoders[slot] = MksEncoder(motor_index.motor(static_cast<uint16_t>(slot)));
+        const MksPayload stop = encoders[slot].query(MksCommands::EMERGENCY_STOP);
+        emergency_frames[slot].id = encoders[slot].canId();
+        emergency_frames[slot].length = stop.length;
+        emergency_frames[slot].data = stop.data;
+    }
+    stream_mailboxes = std::make_unique<std::atomic<uint64_t>[]>(motor_index.size());
+    for (size_t slot = 0; slot < motor_index.size(); ++slot) { stream_mailboxes[slot].store(0, std::memory_order_relaxed); }
+    if (motor_index.size() != motor_ids->size()) {
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController ignoring "
+                                   << motor_ids->size() - motor_index.size()
+                                   << " motor IDs which don't fit in a standard CAN identifier";
+    }
+
+    const std::vector<uint16_t>& ids = motor_index.motors();
+    if (!can_receiver->acceptStandardIds(ids)) {
+        // Not fatal, handleCanMessage still drops foreign messages, it just costs us a wakeup for each one
+        BOOST_LOG_TRIVIAL(warning) << "MksStepperController failed to install CAN filters, errno="
+                                   << can_receiver->lastError();
+        can_receiver->acceptAll();
+        return;
+    }
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController installed CAN filters for " << ids.size() << " motors";
+}
+
+template <typename Transport>
+bool BasicMksStepperController<Transport>::isSetup() const { return this->setup_completed; }
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::update(const std::chrono::nanoseconds& timeout) {
+    // Read a message from the CAN bus; an empty bus is the common case, so it is reported by return value rather
+    // than by exception
+    // Messages from other devices are already dropped by the kernel, see applyMotorIds
+    CanFrame frame;
+    if (this->can_receiver->receive(frame, timeout)) { this->processFrame(frame); }
+    expireInFlight();
+    expireRequests();
+    releaseDeferred();
+}
+
+template <typename Transport>
+size_t BasicMksStepperController<Transport>::drain(const size_t max_messages, const std::chrono::nanoseconds& timeout) {
+    // Read in chunks so that the batch buffer can live on the stack regardless of max_messages
+    CanFrame frames[Transport::MAX_BATCH];
+    size_t handled = 0;
+    auto wait = timeout;
+    while (handled < max_messages) {
+        const size_t chunk = std::min(Transport::MAX_BATCH, max_messages - handled);
+        const size_t received = this->can_receiver->receiveBatch(frames, chunk, wait);
+        for (size_t i = 0; i < received; ++i) { this->processFrame(frames[i]); }
+        handled += received;
+
+        // Only wait for the first message, and stop as soon as the queue runs dry
+        wait = std::chrono::nanoseconds::zero();
+        if (received < chunk) { break; }
+    }
+    expireInFlight();
+    expireRequests();
+    releaseDeferred();
+    return handled;
+}
 
-void MksStepperController::update(const std::chrono::nanoseconds& timeout) {
-    // Read a message from the CAN bus
-    // TODO: Consider bus-level message filtering for efficiency
-    try {
-        uint8_t msg_buffer[8];
-        drivers::socketcan::CanId msg_info = this->can_receiver->receive(&msg_buffer, timeout);
+template <typename Transport>
+void BasicMksStepperController<Transport>::injectFrame(const CanFrame& frame) { this->processFrame(frame); }
 
-        // If this isn't a standard CAN message, then it isn't a message applicable to us
-        if (msg_info.frame_type() != drivers::socketcan::FrameType::DATA) { return; }
+template <typename Transport>
+void BasicMksStepperController<Transport>::processFrame(const CanFrame& frame) {
+    // Our own commands are already recorded and counted by transmit, and would appear twice, once as received, if
+    // looped back
+    if (!frame.local) {
+        flight_recorder.record(FrameDirection::RECEIVED, frame);
+        if (!frame.error) { bus_load.record(frame.length, frame.timestamp); }
+    }
 
-        // Turn the raw buffer into a vector
-        std::vector msg(msg_buffer, msg_buffer + msg_info.length());
+    // If this isn't a standard CAN data frame, then it isn't a message applicable to us
+    if (frame.error || frame.remote || frame.extended) { return; }
 
-        this->handleCanMessage(msg, msg_info);
-    } catch (drivers::socketcan::SocketCanTimeout& _) {} // Don't care if we don't receive a message
+    this->handleCanMessage(frame);
 }
 
 
-void MksStepperController::handleESetSpeed(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info) {
-    if (message.size() != 3) { return; } // Don't want to process loop-backed requests, only responses
-    const auto status = static_cast<MksMoveResponse>(message.at(1));
-    BOOST_LOG_TRIVIAL(debug) << "[" << info.get_bus_time() << "]: MksStepperController: SetSpeed received for motor 0x"
-                             << std::hex << info.identifier() << std::dec
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleESetSpeed(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    const auto status = static_cast<MksMoveResponse>(frame.data[1]);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SetSpeed received for motor 0x" << std::hex << frame.id << std::dec
                              << " with status=" << to_string_mks_move_response(status);
-    ESetSpeed(static_cast<uint16_t>(info.identifier()), status == 1);
+    MksEvent event;
+    event.type = MksEvent::Type::SET_SPEED;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.succeeded = status == 1;
+    emitEvent(event);
 }
 
-void MksStepperController::handleESendStep(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info) {
-    if (message.size() != 3) { return; } // Don't want to process loop-backed requests, only responses
-    const auto status = static_cast<MksMoveResponse>(message.at(1));
-    BOOST_LOG_TRIVIAL(debug) << "[" << info.get_bus_time() << "]: MksStepperController: SendStep received for motor 0x"
-                             << std::hex << info.identifier() << std::dec
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleESendStep(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    const auto status = static_cast<MksMoveResponse>(frame.data[1]);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SendStep received for motor 0x" << std::hex << frame.id << std::dec
                              << " with status=" << to_string_mks_move_response(status);
-    ESendStep(static_cast<uint16_t>(info.identifier()), status);
+    MksEvent event;
+    event.type = MksEvent::Type::SEND_STEP;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.status = status;
+    emitEvent(event);
 }
 
-void MksStepperController::handleESeekPosition(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info) {
-    if (message.size() != 3) { return; } // Don't want to process loop-backed requests, only responses
-    const auto status = static_cast<MksMoveResponse>(message.at(1));
-    BOOST_LOG_TRIVIAL(debug) << "[" << info.get_bus_time() << "]: SeekPosition received for motor 0x" << std::hex
-                             << info.identifier() << std::dec << " with status=" << to_string_mks_move_response(status);
-    ESeekPosition(static_cast<uint16_t>(info.identifier()), status);
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleESeekPosition(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    const auto status = static_cast<MksMoveResponse>(frame.data[1]);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SeekPosition received for motor 0x" << std::hex << frame.id
+                             << std::dec << " with status=" << to_string_mks_move_response(status);
+    MksEvent event;
+    event.type = MksEvent::Type::SEEK_POSITION;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.status = status;
+    emitEvent(event);
 }
 
-void MksStepperController::handleEGetPosition(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info) {
-    if (message.size() != 6) { return; } // Don't want to process loop-backed requests, only responses
-    auto position = static_cast<int32_t>(decode_32_big(message.cbegin() + 1));
-    BOOST_LOG_TRIVIAL(debug) << "[" << info.get_bus_time() << "]: MksStepperController: GetPosition received for motor 0x"
-                             << std::hex << info.identifier() << std::dec << " with position=" << position
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleEGetPosition(const CanFrame& frame) {
+    if (frame.length != 6) { return; } // Don't want to process loop-backed requests, only responses
+    auto position = static_cast<int32_t>(decode_32_big(frame.data.data() + 1));
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: GetPosition received for motor 0x" << std::hex << frame.id
+                             << std::dec << " with position=" << position
                              << ", normalised_position=" << position / norm_factor;
-    EGetPosition(static_cast<uint16_t>(info.identifier()), position / norm_factor);
+    MksEvent event;
+    event.type = MksEvent::Type::GET_POSITION;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.position = position / norm_factor;
+    emitEvent(event);
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleEGetStatus(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    const auto status = static_cast<MksMotorStatus>(frame.data[1]);
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: GetStatus received for motor 0x" << std::hex << frame.id
+                             << std::dec << " with status=" << static_cast<uint16_t>(status);
+    MksEvent event;
+    event.type = MksEvent::Type::GET_STATUS;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.motor_status = status;
+    emitEvent(event);
 }
 
-void MksStepperController::handleCanMessage(const std::vector<uint8_t>& message, drivers::socketcan::CanId& info) {
-    // Note: info can't be const because get_bus_time isn't const-qualified...
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleEGetIoStatus(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: GetIoStatus received for motor 0x" << std::hex << frame.id
+                             << " with flags=0x" << static_cast<uint16_t>(frame.data[1]) << std::dec;
+    MksEvent event;
+    event.type = MksEvent::Type::GET_IO_STATUS;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.io_flags = frame.data[1];
+    emitEvent(event);
+}
 
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleESetGroupId(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    BOOST_LOG_TRIVIAL(debug) << "MksStepperController: SetGroupId received for motor 0x" << std::hex << frame.id
+                             << std::dec << " with status=" << static_cast<uint16_t>(frame.data[1]);
+    MksEvent event;
+    event.type = MksEvent::Type::SET_GROUP_ID;
+    event.motor = static_cast<uint16_t>(frame.id);
+    event.timestamp = frame.timestamp;
+    event.succeeded = frame.data[1] == 1;
+    emitEvent(event);
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleEmergencyStopResponse(const CanFrame& frame) {
+    if (frame.length != 3) { return; } // Don't want to process loop-backed requests, only responses
+    if (!window_enabled.load(std::memory_order_acquire)) { return; }
+    const uint16_t slot = motor_index.slot(static_cast<uint16_t>(frame.id));
+    if (slot == MotorIndex::NO_SLOT) { return; }
+
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    pipelines[slot].moves_in_progress = 0;
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::recordMotorState(const MksEvent& event) {
+    const uint16_t slot = motor_index.slot(event.motor);
+    if (slot == MotorIndex::NO_SLOT) { return; }
+
+    // The receive path is the only writer, so reading back the current state can't race with another update
+    MksMotorState state = motor_states[slot].load();
+    switch (event.type) {
+        case MksEvent::Type::SET_SPEED:
+            state.speed_ack = event.succeeded;
+            state.speed_ack_time = event.timestamp;
+            break;
+        case MksEvent::Type::SEND_STEP:
+        case MksEvent::Type::SEEK_POSITION:
+            state.move_status = event.status;
+            state.move_status_time = event.timestamp;
+            break;
+        case MksEvent::Type::GET_POSITION:
+            state.position = event.position;
+            state.position_time = event.timestamp;
+            break;
+        case MksEvent::Type::GET_STATUS:
+            state.motor_status = event.motor_status;
+            state.motor_status_time = event.timestamp;
+            break;
+        case MksEvent::Type::GET_IO_STATUS:
+            state.io_flags = event.io_flags;
+            state.io_flags_time = event.timestamp;
+            break;
+        case MksEvent::Type::SET_GROUP_ID: break;
+    }
+    motor_states[slot].store(state);
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::emitEvent(const MksEvent& event) {
+    recordMotorState(event);
+    switch (event.type) {
+        case MksEvent::Type::GET_POSITION: ++poll_responses[static_cast<size_t>(MksPollQuery::POSITION)]; break;
+        case MksEvent::Type::GET_STATUS: ++poll_responses[static_cast<size_t>(MksPollQuery::STATUS)]; break;
+        case MksEvent::Type::GET_IO_STATUS: ++poll_responses[static_cast<size_t>(MksPollQuery::IO_STATUS)]; break;
+        default: break;
+    }
+    checkFault(event);
+    releaseInFlight(event);
+    resolveRequests(event);
+
+    if (!queue_events.load(std::memory_order_relaxed)) {
+        dispatchEvent(event);
+        return;
+    }
+    if (!event_queue->push(event)) {
+        // Logging every drop would only make the consumer fall further behind
+        if (dropped_events.fetch_add(1, std::memory_order_relaxed) == 0) {
+            BOOST_LOG_TRIVIAL(warning) << "MksStepperController event queue full, dropping events";
+        }
+    }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::dispatchEvent(const MksEvent& event) {
+    dispatching_timestamp = event.timestamp;
+    const bool fire_signals = signals_enabled.load(std::memory_order_relaxed);
+    switch (event.type) {
+        case MksEvent::Type::SET_SPEED:
+            OnSetSpeed(event.motor, event.succeeded);
+            if (fire_signals) { ESetSpeed(event.motor, event.succeeded); }
+            break;
+        case MksEvent::Type::SEND_STEP:
+            OnSendStep(event.motor, event.status);
+            if (fire_signals) { ESendStep(event.motor, event.status); }
+            break;
+        case MksEvent::Type::SEEK_POSITION:
+            OnSeekPosition(event.motor, event.status);
+            if (fire_signals) { ESeekPosition(event.motor, event.status); }
+            break;
+        case MksEvent::Type::GET_POSITION:
+            OnGetPosition(event.motor, event.position);
+            if (fire_signals) { EGetPosition(event.motor, event.position); }
+            break;
+        case MksEvent::Type::GET_STATUS:
+            OnGetStatus(event.motor, event.motor_status);
+            if (fire_signals) { EGetStatus(event.motor, event.motor_status); }
+            break;
+        case MksEvent::Type::GET_IO_STATUS:
+            OnGetIoStatus(event.motor, event.io_flags);
+            if (fire_signals) { EGetIoStatus(event.motor, event.io_flags); }
+            break;
+        case MksEvent::Type::SET_GROUP_ID:
+            OnSetGroupId(event.motor, event.succeeded);
+            if (fire_signals) { ESetGroupId(event.motor, event.succeeded); }
+            break;
+    }
+}
+
+template <typename Transport>
+void BasicMksStepperController<Transport>::handleCanMessage(const CanFrame& frame) {
     // Drop message if not addressed to us
-    if (info.is_extended() || !motor_ids->count(static_cast<uint16_t>(info.identifier()))) {
-        // We are subscribing to all messages on the bus, there is no reason to spam our log over it
+    if (frame.extended || !motor_index.contains(frame.id)) {
+        // The kernel filters should have dropped these, but we fall back to subscribing to all messages on the bus if
+        // they couldn't be installed, so there is no reason to spam our log over it
         return;
     }
 
     // So this message is from a motor driver; it must contain a command or there is something weird happening
-    if (message.empty()) {
-        BOOST_LOG_TRIVIAL(error) << "[" << info.get_bus_time() << "]: MksStepperController: Message received for motor 0x"
-                                 << std::hex << info.identifier() << std::dec << " with no payload";
+    if (frame.length == 0) {
+        BOOST_LOG_TRIVIAL(error) << "MksStepperController: Message received for motor 0x" << std::hex << frame.id
+                                 << std::dec << " with no payload";
+        return;
     }
 
     // Process the message
-    switch (message[0]) {
-        case MksCommands::SET_SPEED: this->handleESetSpeed(message, info); break;
-        case MksCommands::SEND_STEP: this->handleESendStep(message, info); break;
-        case MksCommands::SEEK_POS_BY_STEPS: this->handleESeekPosition(message, info); break;
-        case MksCommands::CURRENT_POS: this->handleEGetPosition(message, info); break;
+    switch (frame.data[0]) {
+        case MksCommands::SET_SPEED: this->handleESetSpeed(frame); break;
+        case MksCommands::SEND_STEP: this->handleESendStep(frame); break;
+        case MksCommands::SEEK_POS_BY_STEPS: this->handleESeekPosition(frame); break;
+        case MksCommands::CURRENT_POS: this->handleEGetPosition(frame); break;
+        case MksCommands::QUERY_STATUS: this->handleEGetStatus(frame); break;
+        case MksCommands::IO_STATUS: this->handleEGetIoStatus(frame); break;
+        case MksCommands::SET_GROUP_ID: this->handleESetGroupId(frame); break;
+        case MksCommands::EMERGENCY_STOP: this->handleEmergencyStopResponse(frame); break;
         default:
-            // Again, we are subscribing to all messages on the bus, no need to spam log with ignored messages
+            // Responses to commands we never send are expected on a shared bus, no need to spam log with them
             break;
     }
 }
 
-/**
- * Calculates the "CRC" for an MKS message in accordance with @ref MksCommands.
- * @param driver_id CAN ID of the driver this message is sent to
- * @param payload CAN message payload
- * @return computed checksum for the CAN message
- */
-uint8_t checksum(uint16_t driver_id, const std::vector<uint8_t>& payload) {
-    // Note: Accumulate is going to work in uint8_t, and unsigned integer overflow is well-defined - no need for explicit modulo
-    return std::accumulate(payload.cbegin(), payload.cend(), static_cast<uint8_t>(driver_id));
-}
-
-/**
- * Creates the speed properties structure used in the @ref MksCommands::SET_SPEED and @ref MksCommands::SEEK_POS commands.
- * @param payload std::vector<uint8_t> to append the properties structure to
- * @param acceleration the speed ramp profile, see @ref MksTest.Constants.MAX_ACCEL;
- * @param normalised_speed speed value to write to the motor controller
- * @param dir direction to spin, set to `true` if speed is positive
- */
-void packSpeedProperties(
-        std::vector<uint8_t>& payload, const uint8_t acceleration, const int16_t normalised_speed, const bool dir
-) {
-    const auto speed_properties_low = static_cast<uint8_t>((normalised_speed & 0xF00) >> 8 | (dir ? 1u << 7 : 0u));
-    const auto speed_properties_high = static_cast<uint8_t>(normalised_speed & 0xFF);
-    payload.insert(payload.end(), speed_properties_low);
-    payload.insert(payload.end(), speed_properties_high);
-    payload.insert(payload.end(), acceleration);
-}
+// Definitions live here rather than in the header, so every supported transport is instantiated up front
+template class BasicMksStepperController<CanSocket>;
+template class BasicMksStepperController<CanLoopback>;
+template class BasicMksStepperController<CanReplay>;
@@ -9,7 +9,8 @@
 #include <unordered_set>
 #include <utils.hpp>
 
-#include <ros2_socketcan/socket_can_id.hpp>
+// Generous bound on how long the test moves take to complete
+constexpr std::chrono::seconds MOVE_TIMEOUT{ 5 };
 
 MksTest::MksTest(const std::string& can_interface, std::vector<uint16_t>&& motor_ids, const uint8_t norm_factor)
     : s{ can_interface, std::make_shared<std::unordered_set<uint16_t>>(motor_ids.cbegin(), motor_ids.cend()), norm_factor },
@@ -26,11 +27,7 @@ MksTest::MksTest(const std::string& can_interface, std::vector<uint16_t>&& motor
     test_thread = std::thread(&MksTest::sendTestRoutine, this);
 }
 
-void MksTest::update() {
-    try {
-        s.update(std::chrono::nanoseconds(10));
-    } catch (drivers::socketcan::SocketCanTimeout& _) {}
-}
+void MksTest::update() { s.drain(MksStepperController::DEFAULT_DRAIN_LIMIT, std::chrono::nanoseconds(10)); }
 
 void MksTest::sendTestRoutine() {
     // Wait 1 second
@@ -47,30 +44,26 @@ void MksTest::sendTestRoutine() {
         s.setSpeed(motor, 0);
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
-        //Step forward 20 steps at 10 RPM, then back 10 steps at 5 RPM
-        s.getPosition(motor);
-        s.sendStep(motor, 20, 10);
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        s.getPosition(motor);
-        s.sendStep(motor, 10, -5);
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        s.getPosition(motor);
+        //Step forward 20 steps at 10 RPM, then back 10 steps at 5 RPM, querying the position once each move finishes
+        s.getPositionAndWait(motor);
+        s.sendStepAndWait(motor, 20, 10, 0, MksCompletion::FINISHED, MOVE_TIMEOUT);
+        s.getPositionAndWait(motor);
+        s.sendStepAndWait(motor, 10, -5, 0, MksCompletion::FINISHED, MOVE_TIMEOUT);
+        s.getPositionAndWait(motor);
 
         // Wait 1 second
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
         // Seek back to position -10 from wherever we ended up at 30 RPM
-        s.seekPosition(motor, -10, 30);
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        s.getPosition(motor);
+        s.seekPositionAndWait(motor, -10, 30, 0, MksCompletion::FINISHED, MOVE_TIMEOUT);
+        s.getPositionAndWait(motor);
 
         // Wait 1 second
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
         // Seek back to position 0 from wherever we ended up at 10 RPM
-        s.seekPosition(motor, 0, 10);
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-        s.getPosition(motor);
+        s.seekPositionAndWait(motor, 0, 10, 0, MksCompletion::FINISHED, MOVE_TIMEOUT);
+        s.getPositionAndWait(motor);
 
         // Wait 1 second
         std::this_thread::sleep_for(std::chrono::seconds(1));
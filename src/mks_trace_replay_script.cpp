@@ -0,0 +1,318 @@
+/**
+ * @file
+ * Replays a recorded CAN trace, a candump log or pcapng capture, through the MKS decode path of a controller, and
+ * reports the throughput and per-frame decode latency. Needs no CAN interface: the controller sits on an in-memory bus
+ * of its own, and each frame is handed to it with @ref BasicMksStepperController::injectFrame.
+ *
+ * By default frames are replayed as fast as they can be decoded; `--paced` replays them at their original spacing
+ * instead. `--events` writes every decoded event to a file, one per line, so that the output of two builds can be
+ * diffed.
+ */
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "can_loopback.hpp"
+#include "can_trace.hpp"
+#include "mks_enums.hpp"
+#include "mks_stepper_controller.hpp"
+
+// Name of the controller's in-memory bus; nothing else joins it, so commands the controller sends go nowhere
+constexpr char REPLAY_BUS[] = "mks_trace_replay";
+
+/** Frames handed in later than this behind their original timing are counted as late by a paced replay. */
+constexpr std::chrono::milliseconds LATE_THRESHOLD{ 1 };
+
+struct ReplayOptions {
+    std::string trace;
+    std::vector<uint16_t> motor_ids;
+    uint8_t norm_factor = 1;
+    bool paced = false;
+    unsigned passes = 1;
+    std::string events_path;
+};
+
+/**
+ * An event decoded during the first pass, and the index in the trace of the frame which produced it.
+ */
+struct RecordedEvent {
+    size_t frame;
+    MksEvent event;
+};
+
+/**
+ * Measurements of a replay.
+ */
+struct ReplayResult {
+    uint64_t frames = 0;
+    uint64_t events = 0;
+    uint64_t late_frames = 0;
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+
+    /** Time taken to process each frame, in ns, saturating at the maximum of the type. */
+    std::vector<uint32_t> latencies;
+};
+
+/**
+ * Returns the standard identifiers of every data frame in the trace, for when no motor IDs are given.
+ */
+std::vector<uint16_t> traceIds(const std::vector<CanFrame>& frames) {
+    std::vector<bool> seen(0x800);
+    std::vector<uint16_t> ids;
+    for (const CanFrame& frame : frames) {
+        if (frame.extended || frame.remote || frame.error || seen[frame.id]) { continue; }
+        seen[frame.id] = true;
+        ids.push_back(static_cast<uint16_t>(frame.id));
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+/**
+ * Prints an event in the format mks_test_script uses.
+ */
+void printEvent(std::ostream& out, const RecordedEvent& recorded) {
+    const MksEvent& event = recorded.event;
+    out << recorded.frame << " Motor 0x" << std::hex << event.motor << std::dec << ": ";
+    switch (event.type) {
+        case MksEvent::Type::SET_SPEED: out << "SetSpeed: success=" << event.succeeded; break;
+        case MksEvent::Type::SEND_STEP:
+            out << "SendStep: success=" << to_string_mks_move_response(event.status);
+            break;
+        case MksEvent::Type::SEEK_POSITION:
+            out << "SeekPos: success=" << to_string_mks_move_response(event.status);
+            break;
+        case MksEvent::Type::GET_POSITION: out << "GetPos: position=" << event.position; break;
+        case MksEvent::Type::GET_STATUS:
+            out << "GetStatus: status=" << to_string_mks_motor_status(event.motor_status);
+            break;
+        case MksEvent::Type::GET_IO_STATUS: out << "GetIo: flags=0x" << std::hex << +event.io_flags << std::dec; break;
+        case MksEvent::Type::SET_GROUP_ID: out << "SetGroupId: success=" << event.succeeded; break;
+    }
+    out << '\n';
+}
+
+/**
+ * Hands every frame of the trace to the controller, `passes` times over, timing each call.
+ *
+ * Each frame is stamped with when it was handed in, as a live receive would be. Events are counted through the
+ * callback registries, which is all the decode path fires, as the signals are disabled; those of the first pass are
+ * also recorded into `events`, if given.
+ */
+ReplayResult replay(
+        const ReplayOptions& options, const std::vector<CanFrame>& frames, std::vector<RecordedEvent>* events
+) {
+    MksLoopbackController controller(
+            REPLAY_BUS,
+            std::make_shared<std::unordered_set<uint16_t>>(options.motor_ids.cbegin(), options.motor_ids.cend()),
+            options.norm_factor
+    );
+    controller.setSignalsEnabled(false);
+
+    ReplayResult result;
+    size_t current_frame = 0;
+    bool recording = events != nullptr;
+    const auto record = [&](const MksEvent& event) {
+        ++result.events;
+        if (recording) { events->push_back({ current_frame, event }); }
+    };
+    controller.OnSetSpeed.subscribe([&](const uint16_t motor, const bool succeeded) {
+        MksEvent event;
+        event.type = MksEvent::Type::SET_SPEED;
+        event.motor = motor;
+        event.succeeded = succeeded;
+        record(event);
+    });
+    controller.OnSendStep.subscribe([&](const uint16_t motor, const MksMoveResponse status) {
+        MksEvent event;
+        event.type = MksEvent::Type::SEND_STEP;
+        event.motor = motor;
+        event.status = status;
+        record(event);
+    });
+    controller.OnSeekPosition.subscribe([&](const uint16_t motor, const MksMoveResponse status) {
+        MksEvent event;
+        event.type = MksEvent::Type::SEEK_POSITION;
+        event.motor = motor;
+        event.status = status;
+        record(event);
+    });
+    controller.OnGetPosition.subscribe([&](const uint16_t motor, const int32_t position) {
+        MksEvent event;
+        event.type = MksEvent::Type::GET_POSITION;
+        event.motor = motor;
+        event.position = position;
+        record(event);
+    });
+    controller.OnGetStatus.subscribe([&](const uint16_t motor, const MksMotorStatus status) {
+        MksEvent event;
+        event.type = MksEvent::Type::GET_STATUS;
+        event.motor = motor;
+        event.motor_status = status;
+        record(event);
+    });
+    controller.OnGetIoStatus.subscribe([&](const uint16_t motor, const uint8_t flags) {
+        MksEvent event;
+        event.type = MksEvent::Type::GET_IO_STATUS;
+        event.motor = motor;
+        event.io_flags = flags;
+        record(event);
+    });
+    controller.OnSetGroupId.subscribe([&](const uint16_t motor, const bool succeeded) {
+        MksEvent event;
+        event.type = MksEvent::Type::SET_GROUP_ID;
+        event.motor = motor;
+        event.succeeded = succeeded;
+        record(event);
+    });
+
+    // Allocated up front, so the measurement doesn't include growing it
+    result.latencies.resize(frames.size() * options.passes);
+    if (events) { events->reserve(frames.size()); }
+
+    // Logging would dominate the measurements, see benchmarkDecodeAllocations in mks_benchmark_script
+    boost::log::core::get()->set_logging_enabled(false);
+
+    const std::clock_t cpu_start = std::clock();
+    const auto wall_start = std::chrono::steady_clock::now();
+    auto pass_start = wall_start;
+    for (unsigned pass = 0; pass < options.passes; ++pass) {
+        for (current_frame = 0; current_frame < frames.size(); ++current_frame) {
+            CanFrame frame = frames[current_frame];
+            if (options.paced) {
+                // Trace timestamps are offsets from its first frame, see readCanTrace
+                const auto due = pass_start + frame.timestamp.time_since_epoch();
+                std::this_thread::sleep_until(due);
+                if (std::chrono::steady_clock::now() - due > LATE_THRESHOLD) { ++result.late_frames; }
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            frame.timestamp = start;
+            controller.injectFrame(frame);
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start
+            );
+            result.latencies[result.frames++] = static_cast<uint32_t>(
+                    std::min<int64_t>(elapsed.count(), std::numeric_limits<uint32_t>::max())
+            );
+        }
+        recording = false;
+        if (!frames.empty()) { pass_start += frames.back().timestamp.time_since_epoch(); }
+    }
+    const auto wall_end = std::chrono::steady_clock::now();
+    result.cpu_seconds = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    result.wall_seconds = std::chrono::duration<double>(wall_end - wall_start).count();
+
+    boost::log::core::get()->set_logging_enabled(true);
+    return result;
+}
+
+void printResult(const ReplayOptions& options, ReplayResult& result) {
+    const auto frames = static_cast<double>(result.frames);
+    std::cout << std::fixed << std::setprecision(1) << "Replayed " << result.frames << " frames into "
+              << result.events << " events in " << std::setprecision(3) << result.wall_seconds << " s ("
+              << std::setprecision(1) << 100.0 * result.cpu_seconds / result.wall_seconds << " % CPU)" << std::endl;
+    std::cout << std::setw(14) << frames / result.wall_seconds << " frames/s" << std::endl;
+    std::cout << std::setw(14) << static_cast<double>(result.events) / result.wall_seconds << " events/s" << std::endl;
+    if (options.paced) {
+        std::cout << std::setw(14) << result.late_frames << " frames handed in more than "
+                  << LATE_THRESHOLD.count() << " ms late" << std::endl;
+    }
+    if (result.latencies.empty()) { return; }
+
+    // Nearest-rank percentiles, which are actual measurements rather than interpolations between them
+    std::sort(result.latencies.begin(), result.latencies.end());
+    const auto percentile = [&](const double fraction) {
+        const auto rank = static_cast<size_t>(fraction * static_cast<double>(result.latencies.size() - 1) + 0.5);
+        return result.latencies[rank];
+    };
+    uint64_t total = 0;
+    for (const uint32_t latency : result.latencies) { total += latency; }
+    std::cout << "Decode latency (ns): mean " << static_cast<double>(total) / frames << ", p50 " << percentile(0.5)
+              << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999)
+              << ", max " << result.latencies.back() << std::endl;
+}
+
+int main(int argc, const char* argv[]) {
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::warning);
+
+    ReplayOptions options;
+    try {
+        boost::program_options::options_description description;
+        description.add_options()
+            ("trace,t", boost::program_options::value<std::string>()->required(), "candump log or pcapng capture to replay")
+            ("motors,m", boost::program_options::value<std::vector<uint16_t>>()->multitoken()->composing(), "List of CAN IDs for motor controllers, defaults to every standard ID in the trace")
+            ("norm-factor,n", boost::program_options::value<uint16_t>()->default_value(1), "Interpolated normalisation factor the trace was recorded with")
+            ("paced,p", "Replay at the trace's original timing rather than as fast as possible")
+            ("passes,r", boost::program_options::value<unsigned>()->default_value(1), "Number of times to replay the trace")
+            ("events,e", boost::program_options::value<std::string>(), "File to write the events decoded by the first pass to")
+            ("help,h", "Show help");
+        boost::program_options::positional_options_description positional;
+        positional.add("trace", 1);
+
+        boost::program_options::variables_map vm;
+        store(boost::program_options::command_line_parser(argc, argv).options(description).positional(positional).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << description << std::endl;
+            return 0;
+        }
+
+        notify(vm);
+
+        options.trace = vm["trace"].as<std::string>();
+        if (vm.count("motors")) { options.motor_ids = vm["motors"].as<std::vector<uint16_t>>(); }
+        options.norm_factor = static_cast<uint8_t>(vm["norm-factor"].as<uint16_t>());
+        options.paced = vm.count("paced") != 0;
+        options.passes = std::max(vm["passes"].as<unsigned>(), 1u);
+        if (vm.count("events")) { options.events_path = vm["events"].as<std::string>(); }
+    } catch (const boost::program_options::error& e) {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
+    std::vector<CanFrame> frames;
+    try {
+        frames = readCanTrace(options.trace);
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+    if (options.motor_ids.empty()) { options.motor_ids = traceIds(frames); }
+    const double span = frames.empty() ? 0.0
+                                       : std::chrono::duration<double>(frames.back().timestamp.time_since_epoch()).count();
+    std::cout << "Read " << frames.size() << " frames spanning " << span << " s, decoding " << options.motor_ids.size()
+              << " motor IDs" << std::endl;
+
+    std::vector<RecordedEvent> events;
+    ReplayResult result = replay(options, frames, options.events_path.empty() ? nullptr : &events);
+    printResult(options, result);
+
+    if (!options.events_path.empty()) {
+        std::ofstream out(options.events_path);
+        for (const RecordedEvent& event : events) { printEvent(out, event); }
+        if (!out) {
+            std::cout << "Failed to write events to " << options.events_path << std::endl;
+            return -1;
+        }
+        std::cout << "Wrote " << events.size() << " events to " << options.events_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "realtime.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+    size_t pageSize() {
+        const long size = sysconf(_SC_PAGESIZE);
+        return size > 0 ? static_cast<size_t>(size) : 4096;
+    }
+} // namespace
+
+RealtimeStatus applyProcessRealtime(const RealtimeMemoryOptions& options) {
+    RealtimeStatus status;
+
+    if (options.lock_memory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            status.memory_lock = RealtimeResult::APPLIED;
+            // Keep freed memory in the process instead of returning it to the kernel, and serve large allocations
+            // from the heap instead of fresh mmaps, so that locked pages stay locked and get reused
+            mallopt(M_TRIM_THRESHOLD, -1);
+            mallopt(M_MMAP_MAX, 0);
+        } else {
+            status.memory_lock = RealtimeResult::FAILED;
+            status.error = errno;
+        }
+    }
+
+    if (options.prefault_heap > 0) {
+        auto* block = static_cast<volatile uint8_t*>(std::malloc(options.prefault_heap));
+        if (block != nullptr) {
+            for (size_t offset = 0; offset < options.prefault_heap; offset += pageSize()) { block[offset] = 0; }
+            std::free(const_cast<uint8_t*>(block));
+            status.prefault = RealtimeResult::APPLIED;
+        } else {
+            status.prefault = RealtimeResult::FAILED;
+            status.error = ENOMEM;
+        }
+    }
+    return status;
+}
+
+RealtimeStatus applyThreadRealtime(std::thread& thread, const RealtimeOptions& options) {
+    RealtimeStatus status;
+    const pthread_t handle = thread.native_handle();
+
+    if (options.priority > 0) {
+        sched_param requested{};
+        requested.sched_priority = options.priority;
+        int result = pthread_setschedparam(handle, SCHED_FIFO, &requested);
+        if (result == 0) {
+            // Read back rather than trusting the return value, in case something else adjusted the thread
+            int policy = 0;
+            sched_param actual{};
+            result = pthread_getschedparam(handle, &policy, &actual);
+            if (result == 0 && (policy != SCHED_FIFO || actual.sched_priority != options.priority)) { result = EINVAL; }
+        }
+        status.scheduling = result == 0 ? RealtimeResult::APPLIED : RealtimeResult::FAILED;
+        if (result != 0) { status.error = result; }
+    }
+
+    if (!options.cpus.empty()) {
+        cpu_set_t requested;
+        CPU_ZERO(&requested);
+        for (const int cpu : options.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) { CPU_SET(cpu, &requested); }
+        }
+        int result = pthread_setaffinity_np(handle, sizeof(requested), &requested);
+        if (result == 0) {
+            cpu_set_t actual;
+            CPU_ZERO(&actual);
+            result = pthread_getaffinity_np(handle, sizeof(actual), &actual);
+            if (result == 0 && !CPU_EQUAL(&requested, &actual)) { result = EINVAL; }
+        }
+        status.affinity = result == 0 ? RealtimeResult::APPLIED : RealtimeResult::FAILED;
+        if (result != 0) { status.error = result; }
+    }
+    return status;
+}
+
+void prefaultStack(const size_t bytes) {
+    if (bytes == 0) { return; }
+    // alloca rather than a fixed array, so the amount can be chosen at runtime; the frame is released on return
+    auto* stack = static_cast<volatile uint8_t*>(alloca(bytes));
+    for (size_t offset = 0; offset < bytes; offset += pageSize()) { stack[offset] = 0; }
+}
@@ -5,40 +5,68 @@
 #include "servo_controller.hpp"
 
 #include <boost/log/trivial.hpp>
-#include <ros2_socketcan/socket_can_sender.hpp>
 
-ServoController::ServoController(const std::string& can_interface, const uint16_t servo_id) : servo_id_{ servo_id } {
+#include "can_loopback.hpp"
+#include "can_socket.hpp"
+
+template <typename Transport>
+BasicServoController<Transport>::BasicServoController(
+        const std::string& can_interface, const uint16_t servo_id, const RealtimeMemoryOptions& memory
+)
+    : servo_id_{ servo_id }, memory_options_{ memory } {
     BOOST_LOG_TRIVIAL(trace) << "ServoController construction begun";
 
-    can_sender_ = std::make_unique<drivers::socketcan::SocketCanSender>(can_interface);
+    realtime_status_ = applyProcessRealtime(memory_options_);
+    if (realtime_status_.memory_lock == RealtimeResult::FAILED || realtime_status_.prefault == RealtimeResult::FAILED) {
+        BOOST_LOG_TRIVIAL(warning) << "ServoController failed to lock or prefault memory, errno="
+                                   << realtime_status_.error;
+    }
+
+    can_sender_ = std::make_unique<Transport>(can_interface);
 
     BOOST_LOG_TRIVIAL(debug) << "ServoController constructed";
 
     setup_completed_ = true;
 }
 
-ServoController::~ServoController() noexcept { BOOST_LOG_TRIVIAL(debug) << "ServoController destructed"; }
+template <typename Transport>
+BasicServoController<Transport>::~BasicServoController() noexcept {
+    BOOST_LOG_TRIVIAL(debug) << "ServoController destructed";
+}
 
-bool ServoController::send(const uint8_t position) {
+template <typename Transport>
+bool BasicServoController<Transport>::send(const uint8_t position) {
     if (!isSetup()) { return false; }
 
     BOOST_LOG_TRIVIAL(debug) << "ServoController: Send for servo 0x" << std::hex << servo_id_ << std::dec
                              << "with pos=" << position;
 
     // Message format is an 8 byte payload where the 1st byte is the commanded position of the servo
-    std::vector<uint8_t> payload{ position, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
-
-    try {
-        drivers::socketcan::CanId can_id(
-                servo_id_, 0, drivers::socketcan::FrameType::DATA, drivers::socketcan::ExtendedFrame
-        );
-        can_sender_->send(payload.data(), payload.size(), can_id);
-    } catch (drivers::socketcan::SocketCanTimeout& e) {
-        // Won't bother with e.what(), it is always "CAN Send timeout"
+    CanFrame frame;
+    frame.id = servo_id_;
+    frame.extended = true;
+    frame.length = 8;
+    frame.data = { position, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+    if (!can_sender_->send(frame, SEND_TIMEOUT)) {
         BOOST_LOG_TRIVIAL(warning) << "ServoController send timeout: servo_id=" << servo_id_ << ", pos=" << position;
         return false;
     }
+    flight_recorder_.record(
+            FrameDirection::TRANSMITTED, servo_id_, true, frame.data.data(), frame.length,
+            std::chrono::steady_clock::now()
+    );
     return true;
 }
 
-bool ServoController::isSetup() const { return setup_completed_; }
+template <typename Transport>
+bool BasicServoController<Transport>::isSetup() const { return setup_completed_; }
+
+template <typename Transport>
+FlightRecorder& BasicServoController<Transport>::flightRecorder() { return flight_recorder_; }
+
+template <typename Transport>
+RealtimeStatus BasicServoController<Transport>::getRealtimeStatus() const { return realtime_status_; }
+
+template class BasicServoController<CanSocket>;
+template class BasicServoController<CanLoopback>;